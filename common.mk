@@ -0,0 +1,10 @@
+# Settings every demo is built with, included by each demo's Makefile.
+#
+# The demos all compile the same ../libs and ../modules objects, so anything that changes what a shared header
+# declares has to be the same for every one of them: set it here (or on the make command line after a clean of every
+# demo), never in a single demo's Makefile.
+
+# The lowest LoggerLevel that is compiled in at all (0 debug, 1 notice, 2 error), see logger.h
+LOGGER_MIN_LEVEL=0
+
+COMMON_CFLAGS=-DLOGGER_MIN_LEVEL=$(LOGGER_MIN_LEVEL)
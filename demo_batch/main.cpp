@@ -0,0 +1,164 @@
+/**
+ * main.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Flies demo_sim's waypoint mission with thousands of slightly different simulated robots at once (see batchsim.h),
+ * for Monte Carlo runs of the controller. The robots are the ones demo_sim would fly for the same seed.
+ *
+ * Reports the throughput in robot-steps per second (one robot, one 1ms physics step) and how the robots did, then flies
+ * the first few robots again with the scalar Controller, SimulatedPlant and Mission and checks that each one ended up
+ * in the same place at the same time. Exits non-zero if any didn't.
+ *
+ * Usage: demo_batch [-v] [robots] [seed] [robots checked against the scalar controller]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include <vector>
+
+#include "motorlib.h"
+#include "logger.h"
+#include "plantsim.h"
+#include "controller.h"
+#include "mission.h"
+#include "batchsim.h"
+#include "latency.h"
+
+#define BATCH_TOLERANCE     0.01        // cm, a robot matches the scalar controller if it ends up this close
+
+int main(int argc, char *argv[])
+{
+	unsigned int nRobots = 4096, nChecked = 64, seed = 1, nWayPoints = 4;
+	bool         bVerbose = false;
+
+	Waypoint waypoints[] = {
+		{45.0, 0.0},
+		{90.0, 45.0},
+		{0.0, 45.0},
+		{1.0, 1.0}
+	};
+
+	if (argc > 1 && strcmp(argv[1], "-v") == 0)
+	{
+		bVerbose = true;
+		argc--;
+		argv++;
+	}
+
+	if (argc > 1)
+	{
+		nRobots = atoi(argv[1]) > 0 ? atoi(argv[1]) : 1;
+	}
+
+	if (argc > 2)
+	{
+		seed = atoi(argv[2]);
+	}
+
+	if (argc > 3)
+	{
+		nChecked = atoi(argv[3]) > 0 ? atoi(argv[3]) : 0;
+	}
+
+	nChecked = nChecked < nRobots ? nChecked : nRobots;
+
+	// Every notice when verbose, the simulation would otherwise log faster than the ring is written and drop most
+	Logger::setQuiet( ! bVerbose);
+	Logger::setSynchronous(bVerbose);
+
+	RobotProfile profile = ROBOT_PROFILE_OROBOTO;
+
+	if (profile.load() == -EINVAL)
+	{
+		fprintf(stderr, "%s is not a valid robot profile\n", RobotProfile::getDefaultFile());
+		return 1;
+	}
+
+	// The same robots demo_sim flies, one after the other
+	std::vector<SimulatedPlantParams> robots;
+
+	for (unsigned int r = 0; r < nRobots; r++)
+	{
+		robots.push_back(SimulatedPlant::getVariedParams(profile, &seed));
+	}
+
+	BatchSimulator batch(robots, profile);
+
+	unsigned long long tStart = LatencyHistogram::now();
+	unsigned int nSucceeded = batch.run(waypoints, nWayPoints);
+	double       elapsedNs  = LatencyHistogram::now() - tStart;
+
+	double             fErrorSum = 0, fErrorMax = 0;
+	unsigned long long virtualNs = 0;
+	int                nMissed = 0;
+
+	for (unsigned int r = 0; r < nRobots; r++)
+	{
+		Pose   truth  = batch.getTruePose(r);
+		double fError = hypot(truth.x - waypoints[nWayPoints-1].x, truth.y - waypoints[nWayPoints-1].y);
+
+		fErrorSum += fError;
+		fErrorMax  = fError > fErrorMax ? fError : fErrorMax;
+		virtualNs += batch.getTransitNs(r);
+
+		if (fError > 10.0)
+		{
+			nMissed++;
+		}
+	}
+
+	printf("%u robots in packs of %u in %.2f s: %llu robot-steps, %.2fM robot-steps/s (%.0f missions/minute)\n", nRobots, BATCH_LANES, elapsedNs / 1e9, batch.getStepCount(), batch.getStepCount() / (elapsedNs / 1e3), nRobots / (elapsedNs / 60e9));
+	printf("mission time:         mean %.2f s, %u robots reached every waypoint\n", virtualNs / 1e9 / nRobots, nSucceeded);
+	printf("final position error: mean %.2f cm max %.2f cm, %d missions ended more than 10 cm out\n", fErrorSum / nRobots, fErrorMax, nMissed);
+
+	if (nChecked == 0)
+	{
+		return 0;
+	}
+
+	// The same robots again, one at a time with the scalar controller
+	double             fPoseMax = 0, fEstimateMax = 0;
+	unsigned long long scalarSteps = 0;
+	unsigned int       nMismatched = 0;
+
+	tStart = LatencyHistogram::now();
+
+	for (unsigned int r = 0; r < nChecked; r++)
+	{
+		SimulatedPlant plant(robots[r]);
+		Controller     c(&plant, profile);
+		Mission        m(&c);
+
+		int nReached = m.run(waypoints, nWayPoints);
+
+		Pose truth    = plant.getTruePose();
+		Pose believed = c.getCurrentPose();
+		Pose batchTruth    = batch.getTruePose(r);
+		Pose batchBelieved = batch.getCurrentPose(r);
+
+		double fPose     = hypot(truth.x - batchTruth.x, truth.y - batchTruth.y);
+		double fEstimate = hypot(believed.x - batchBelieved.x, believed.y - batchBelieved.y);
+
+		fPoseMax     = fPose > fPoseMax ? fPose : fPoseMax;
+		fEstimateMax = fEstimate > fEstimateMax ? fEstimate : fEstimateMax;
+		scalarSteps += (plant.getTimeNs() - PLANTSIM_EPOCH_NS) / PLANTSIM_STEP_NS;
+
+		if (fPose > BATCH_TOLERANCE || fEstimate > BATCH_TOLERANCE || m.getTransitNs() != batch.getTransitNs(r) || nReached != static_cast<int>(batch.getReachedCount(r)))
+		{
+			printf("robot %u: scalar (%.4f, %.4f) in %.2f s, batch (%.4f, %.4f) in %.2f s\n", r, truth.x, truth.y, m.getTransitNs() / 1e9, batchTruth.x, batchTruth.y, batch.getTransitNs(r) / 1e9);
+			nMismatched++;
+		}
+	}
+
+	elapsedNs = LatencyHistogram::now() - tStart;
+
+	printf("scalar controller:    %u robots, %.2fM robot-steps/s\n", nChecked, scalarSteps / (elapsedNs / 1e3));
+	printf("against the scalar:   %u of %u robots match (true pose within %.2e cm, estimate within %.2e cm)\n", nChecked - nMismatched, nChecked, fPoseMax, fEstimateMax);
+
+	return nMismatched > 0 ? 1 : 0;
+}
@@ -0,0 +1,647 @@
+/**
+ * main.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Times the quadrature decoder, odometry and motor calibration lookups, and the motor, ADC and LED paths against a fake sysfs tree so they can be benchmarked on a plain Linux box.
+ *
+ * Usage: demo_bench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <vector>
+#include <atomic>
+
+#include "sysfslib.h"
+#include "sysfsfake.h"
+#include "motorlib.h"
+#include "pwmlib.h"
+#include "adclib.h"
+#include "led.h"
+#include "actuator.h"
+#include "latency.h"
+#include "looptimer.h"
+#include "odo.h"
+#include "poseestimator.h"
+#include "poseprovider.h"
+#include "poseintegrator.h"
+#include "gpiomock.h"
+#include "gpiolinegroup.h"
+#include "quadrature.h"
+#include "edgerecord.h"
+#include "motorcal.h"
+
+/**
+ * Append the edges for a wheel turning forward nTicks ticks to a mock edge source.
+ *
+ * @param GpioMockEdgeSource * mock
+ * @param unsigned int         gpioA
+ * @param unsigned int         gpioB
+ * @param int                  nTicks
+ * @param unsigned long long   periodNs	time between edges
+ */
+static void add_forward_edges(GpioMockEdgeSource *mock, unsigned int gpioA, unsigned int gpioB, int nTicks, unsigned long long periodNs)
+{
+	unsigned char a = 0, b = 0;
+
+	for (int i = 0; i < nTicks; i++)
+	{
+		// Gray code 00 -> 10 -> 11 -> 01 -> 00 counts up
+		if (a == b)
+		{
+			a = !a;
+			mock->addEvent((i + 1) * periodNs, gpioA, a);
+		}
+		else
+		{
+			b = !b;
+			mock->addEvent((i + 1) * periodNs, gpioB, b);
+		}
+	}
+}
+
+/**
+ * Build a random encoder trace of AB states: mostly single channel steps in either direction, with the odd glitch where
+ * both channels change at once.
+ *
+ * @param std::vector<unsigned char> & trace
+ * @param int                          nStates
+ */
+static void make_encoder_trace(std::vector<unsigned char> &trace, int nStates)
+{
+	static const unsigned char forward[4] = { 2, 0, 3, 1 };	// next state counting up, indexed by AB
+	static const unsigned char reverse[4] = { 1, 3, 0, 2 };	// next state counting down
+
+	unsigned int  seed = 1;
+	unsigned char ab   = 0;
+
+	trace.resize(nStates);
+
+	for (int i = 0; i < nStates; i++)
+	{
+		int r = rand_r(&seed) % 100;
+
+		if (r < 60)      ab = forward[ab];
+		else if (r < 95) ab = reverse[ab];
+		else if (r < 99) ab = ab ^ 3;			// both channels changed
+		// else no change
+
+		trace[i] = ab;
+	}
+}
+
+/**
+ * The decode the odometer used before the table, kept here to measure against.
+ *
+ * @param std::vector<unsigned char> & trace
+ * @param int *                        count
+ * @param unsigned int *               errors
+ */
+static void decode_branchy(const std::vector<unsigned char> &trace, int *count, unsigned int *errors)
+{
+	unsigned char a, b, aLast = 0, bLast = 0;
+
+	*count  = 0;
+	*errors = 0;
+
+	for (size_t i = 0; i < trace.size(); i++)
+	{
+		a = (trace[i] >> 1) & 1;
+		b = trace[i] & 1;
+
+		if (a ^ bLast)
+		{
+			(*count)++;
+		}
+		if (b ^ aLast)
+		{
+			(*count)--;
+		}
+
+		if (a != aLast && b != bLast)
+		{
+			(*errors)++;
+		}
+
+		aLast = a;
+		bLast = b;
+	}
+}
+
+/**
+ * A pose provider the bench can publish into from its own writer thread.
+ */
+class BenchPoseProvider : public PoseProvider
+{
+	public:
+		void publish(const Pose &pose)	{ publishPose(pose); }
+};
+
+#define POSE_READERS 3
+#define POSE_TOLERANCE 0.001		// cm (and radians) from the closed form a pose estimate may be
+#define ACTUATOR_FIFO "/bench-fifo"	// opening it holds the sysfs lock until the bench opens the other end
+
+struct PoseStress
+{
+	BenchPoseProvider	provider;
+	std::atomic<bool>	bRun;
+	std::atomic<int>	nextReader;
+	unsigned long		writes;
+	unsigned long		reads[POSE_READERS];
+	unsigned long		torn[POSE_READERS];
+	unsigned long		backwards[POSE_READERS];
+};
+
+/**
+ * Publishes poses whose fields all derive from one counter, as fast as it can.
+ */
+static void * pose_writer(void *arg)
+{
+	PoseStress *stress = static_cast<PoseStress *>(arg);
+	Pose        pose;
+
+	for (stress->writes = 1; stress->bRun.load(std::memory_order_relaxed); stress->writes++)
+	{
+		pose.x         = stress->writes;
+		pose.y         = -(double)stress->writes;
+		pose.heading   = stress->writes * 0.5;
+		pose.timestamp = stress->writes;
+
+		stress->provider.publish(pose);
+	}
+
+	return NULL;
+}
+
+/**
+ * Reads poses until the writer stops, counting any that mix fields from different writes or go back in time.
+ */
+static void * pose_reader(void *arg)
+{
+	PoseStress   *stress = static_cast<PoseStress *>(arg);
+	int           reader = stress->nextReader++;
+	unsigned long last = 0;
+
+	stress->reads[reader] = stress->torn[reader] = stress->backwards[reader] = 0;
+
+	while (stress->bRun.load(std::memory_order_relaxed))
+	{
+		Pose pose = stress->provider.getCurrentPose();
+
+		if (pose.y != -pose.x || pose.heading != pose.x * 0.5 || pose.timestamp != (unsigned long)pose.x)
+		{
+			stress->torn[reader]++;
+		}
+
+		if (pose.timestamp < last)
+		{
+			stress->backwards[reader]++;
+		}
+
+		last = pose.timestamp;
+		stress->reads[reader]++;
+	}
+
+	return NULL;
+}
+
+/**
+ * Holds the sysfs lock while blocked opening a FIFO for reading, so that the actuator's writer thread is stuck in the
+ * middle of a write until the bench opens the FIFO for writing (the read that follows fails, pipes can't pread()).
+ */
+static void * sysfs_blocker(void *arg)
+{
+	char c;
+
+	sysfs_read(static_cast<const char *>(arg), &c, 1);
+
+	return NULL;
+}
+
+/**
+ * @param char * name
+ * @param int    iterations
+ * @param double elapsedNs
+ */
+static void report(const char *name, int iterations, double elapsedNs)
+{
+	printf("%-24s %10d iterations %12.1f ns/op\n", name, iterations, elapsedNs / iterations);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int gpios[] = { 30, 31, 66, 67 };
+	char         root[SYSFS_MAX_PATH];
+	int          i, iterations = 100000;
+	double       tStart;
+
+	if (argc > 1)
+	{
+		iterations = atoi(argv[1]);
+	}
+
+	if (sysfs_fake_create(root, sizeof(root), gpios, sizeof(gpios) / sizeof(gpios[0])) < 0)
+	{
+		fprintf(stderr, "could not create fake sysfs tree\n");
+		return 1;
+	}
+
+	sysfs_set_root(root);
+	printf("fake sysfs root: %s\n", root);
+
+	// Quadrature decode, branchy vs table driven, over the same trace
+	std::vector<unsigned char> trace;
+	int                        countBranchy;
+	unsigned int               errorsBranchy;
+	QuadratureDecoder          decoder;
+	int                        nStates = iterations * 10;
+
+	make_encoder_trace(trace, nStates);
+
+	tStart = LatencyHistogram::now();
+	decode_branchy(trace, &countBranchy, &errorsBranchy);
+	report("quadrature (branchy)", nStates, LatencyHistogram::now() - tStart);
+
+	tStart = LatencyHistogram::now();
+	decoder.decode(trace.begin(), trace.end());
+	report("quadrature (table)", nStates, LatencyHistogram::now() - tStart);
+
+	printf("  count %d/%d errors %u/%u (branchy/table)\n", countBranchy, decoder.getCount(), errorsBranchy, decoder.getErrors());
+
+	if (countBranchy != decoder.getCount() || errorsBranchy != decoder.getErrors())
+	{
+		fprintf(stderr, "quadrature decoders disagree\n");
+		sysfs_fake_destroy(root);
+		return 1;
+	}
+
+	motor_init();
+	adc_init();
+
+	tStart = LatencyHistogram::now();
+	for (i = 0; i < iterations; i++)
+	{
+		motor_forward(MOTOR_LEFT, pwm_speed(i % 100));
+	}
+	report("motor_forward", iterations, LatencyHistogram::now() - tStart);
+
+	tStart = LatencyHistogram::now();
+	for (i = 0; i < iterations; i++)
+	{
+		adc_get_value(4);
+	}
+	report("adc_get_value", iterations, LatencyHistogram::now() - tStart);
+
+	Led led(1);
+
+	tStart = LatencyHistogram::now();
+	for (i = 0; i < iterations; i++)
+	{
+		led.strobe();
+	}
+	report("Led::strobe", iterations, LatencyHistogram::now() - tStart);
+
+	led.run();
+	usleep(10000);
+
+	tStart = LatencyHistogram::now();
+	led.stop();
+	report("Led::stop", 1, LatencyHistogram::now() - tStart);
+
+	// Encoder line setup, the first configure has to set the edges, after that there should be nothing to write
+	unsigned int written, skipped, levels;
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		GpioLineGroup group;
+
+		tStart = LatencyHistogram::now();
+		group.configure(gpios, sizeof(gpios) / sizeof(gpios[0]), INPUT_PIN, EDGE_BOTH);
+		report(pass == 0 ? "GpioLineGroup (first)" : "GpioLineGroup (again)", 1, LatencyHistogram::now() - tStart);
+
+		group.getWriteCounts(&written, &skipped);
+		printf("  %u sysfs writes, %u skipped\n", written, skipped);
+
+		tStart = LatencyHistogram::now();
+		for (i = 0; i < iterations; i++)
+		{
+			group.getLevels(&levels);
+		}
+		report("GpioLineGroup::getLevels", iterations, LatencyHistogram::now() - tStart);
+	}
+
+	// Replay encoder edges through the odometry thread
+	GpioMockEdgeSource mock;
+	Odometer           odo(gpios[0], gpios[1], gpios[2], gpios[3], 2, ROBOT_PROFILE_OROBOTO.ticksPerRevolution, &mock);
+	PoseEstimator      poseEstimator(2, 9, ROBOT_PROFILE_OROBOTO.ticksPerRevolution);
+	int                odoLeft = 0, odoRight = 0;
+
+	char               recordingFile[SYSFS_MAX_PATH + 16];
+
+	add_forward_edges(&mock, gpios[0], gpios[1], iterations, 1000);
+
+	// Record them as they go through, to replay below. The mock delivers edges far faster than any wheel, buffer them all
+	// so that none are dropped while the writer waits for a CPU
+	snprintf(recordingFile, sizeof(recordingFile), "%s/edges.bin", root);
+	odo.record(recordingFile, iterations);
+	odo.setPoseEstimator(&poseEstimator);
+
+	tStart = LatencyHistogram::now();
+	odo.run();
+	while (odoLeft < iterations)
+	{
+		odo.getOdometry(&odoLeft, &odoRight);
+	}
+	report("Odometer (mock edges)", iterations, LatencyHistogram::now() - tStart);
+
+	OdometrySnapshot snapshot = odo.getSnapshot();
+
+	tStart = LatencyHistogram::now();
+	for (i = 0; i < iterations; i++)
+	{
+		snapshot = odo.getSnapshot();
+	}
+	report("Odometer::getSnapshot", iterations, LatencyHistogram::now() - tStart);
+	printf("  left %d right %d errors %u/%u last edge %llu ns\n", snapshot.odoLeft, snapshot.odoRight, snapshot.errorsLeft, snapshot.errorsRight, snapshot.timestampNs);
+
+	double velocityLeft, velocityRight;
+
+	tStart = LatencyHistogram::now();
+	for (i = 0; i < iterations; i++)
+	{
+		odo.getVelocity(&velocityLeft, &velocityRight, snapshot.timestampNs);
+	}
+	report("Odometer::getVelocity", iterations, LatencyHistogram::now() - tStart);
+	printf("  left %.1f cm/s right %.1f cm/s at the last edge\n", velocityLeft, velocityRight);
+
+	// Only the left wheel turned, so the robot pivoted about the right wheel
+	Pose   pose = poseEstimator.getCurrentPose();
+	double pivot = -(2.0 * M_PI * 2 * iterations / ROBOT_PROFILE_OROBOTO.ticksPerRevolution) / 9;
+
+	tStart = LatencyHistogram::now();
+	for (i = 0; i < iterations; i++)
+	{
+		pose = poseEstimator.getCurrentPose();
+	}
+	report("PoseEstimator (read)", iterations, LatencyHistogram::now() - tStart);
+	Pose expected;
+
+	expected.x       = -4.5 * sin(pivot);
+	expected.y       = 4.5 * (cos(pivot) - 1.0);
+	expected.heading = atan2(sin(pivot), cos(pivot));
+
+	printf("  %lu steps, x %.2f y %.2f heading %.4f (expected x %.2f y %.2f heading %.4f)\n", poseEstimator.getSteps(), pose.x, pose.y, pose.heading, expected.x, expected.y, expected.heading);
+
+	if (fabs(pose.x - expected.x) > POSE_TOLERANCE || fabs(pose.y - expected.y) > POSE_TOLERANCE || fabs(atan2(sin(pose.heading - expected.heading), cos(pose.heading - expected.heading))) > POSE_TOLERANCE)
+	{
+		fprintf(stderr, "the pose estimator did not pivot about the right wheel\n");
+		sysfs_fake_destroy(root);
+		return 1;
+	}
+
+	// Each integration, one wheel a little faster than the other (tick sized steps, as the pose estimator makes)
+	static const char *integrationNames[] = { "euler", "rk2", "arc" };
+	char               name[32];
+
+	for (int integration = POSE_INTEGRATION_EULER; integration <= POSE_INTEGRATION_ARC; integration++)
+	{
+		Pose integrated;
+
+		memset(&integrated, 0, sizeof(integrated));
+
+		tStart = LatencyHistogram::now();
+		for (i = 0; i < iterations; i++)
+		{
+			pose_integrate(&integrated, 0.05, 0.06, 9, static_cast<PoseIntegration>(integration));
+		}
+		snprintf(name, sizeof(name), "pose_integrate (%s)", integrationNames[integration]);
+		report(name, iterations, LatencyHistogram::now() - tStart);
+		printf("  x %.2f y %.2f heading %.4f\n", integrated.x, integrated.y, integrated.heading);
+	}
+
+	// How far each drifts in 20 s of turning (2 and 8 cm/s, a 7.5 cm radius) integrated once per control loop
+	// iteration, against 1000 times smaller steps
+	static const unsigned int rates[] = { 5, 20, 100 };
+
+	for (unsigned int r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+	{
+		printf("  at %3u Hz: ", rates[r]);
+
+		for (int integration = POSE_INTEGRATION_EULER; integration <= POSE_INTEGRATION_ARC; integration++)
+		{
+			double error = pose_integration_error(static_cast<PoseIntegration>(integration), 2.0, 8.0, 9.0, 1.0 / rates[r], 20 * rates[r], 1000);
+
+			printf("%s %.4f cm%s", integrationNames[integration], error, integration < POSE_INTEGRATION_ARC ? ", " : "\n");
+		}
+	}
+
+	// The wheels are now still, stop() has to interrupt the thread's wait for edges
+	tStart = LatencyHistogram::now();
+	odo.stop();
+	report("Odometer::stop (idle)", 1, LatencyHistogram::now() - tStart);
+
+	odo.record(NULL);
+
+	// And it can be started again
+	odo.run();
+
+	tStart = LatencyHistogram::now();
+	odo.stop();
+	report("Odometer::stop (rerun)", 1, LatencyHistogram::now() - tStart);
+
+	// Replay the recording through another odometer, off the thread, it should end up in the same place
+	EdgeRecording      recording;
+	GpioMockEdgeSource replayMock;
+	Odometer           replayOdo(gpios[0], gpios[1], gpios[2], gpios[3], 2, ROBOT_PROFILE_OROBOTO.ticksPerRevolution, &replayMock);
+	long               nReplayed;
+
+	if (recording.load(recordingFile) < 0)
+	{
+		fprintf(stderr, "could not load %s\n", recordingFile);
+		sysfs_fake_destroy(root);
+		return 1;
+	}
+
+	tStart = LatencyHistogram::now();
+	nReplayed = replayOdo.replay(recording);
+	report("Odometer::replay", nReplayed, LatencyHistogram::now() - tStart);
+
+	OdometrySnapshot replayed = replayOdo.getSnapshot();
+
+	printf("  %lu edges recorded, replayed left %d right %d errors %u/%u\n", recording.getCount(), replayed.odoLeft, replayed.odoRight, replayed.errorsLeft, replayed.errorsRight);
+
+	if (replayed.odoLeft != snapshot.odoLeft || replayed.odoRight != snapshot.odoRight || replayed.errorsLeft != snapshot.errorsLeft || replayed.errorsRight != snapshot.errorsRight)
+	{
+		fprintf(stderr, "replayed odometry does not match the recorded run\n");
+		sysfs_fake_destroy(root);
+		return 1;
+	}
+
+	// Velocity to PWM lookup through a motor calibration table shaped like the old hand measured fits
+	char             calFile[SYSFS_MAX_PATH + 16];
+	FILE *           fp;
+	MotorCalibration cal;
+	int              duty = 0;
+
+	snprintf(calFile, sizeof(calFile), "%s/motorcal.txt", root);
+
+	if ((fp = fopen(calFile, "w")) != NULL)
+	{
+		for (int motor = 0; motor < 2; motor++)
+		{
+			for (int dc = 0; dc <= 100; dc += 5)
+			{
+				double v = motor == 0 ? (1.103 * dc / 10.0) - 0.2833 : (1.0263 * dc / 10.0) - 0.2395;
+
+				fprintf(fp, "%s forward %d %.3f\n", motor == 0 ? "left" : "right", dc, v > 0 ? v : 0);
+				fprintf(fp, "%s reverse %d %.3f\n", motor == 0 ? "left" : "right", dc, v > 0 ? v : 0);
+			}
+		}
+
+		fclose(fp);
+	}
+
+	if (cal.load(calFile) < 0)
+	{
+		fprintf(stderr, "could not load %s\n", calFile);
+		sysfs_fake_destroy(root);
+		return 1;
+	}
+
+	tStart = LatencyHistogram::now();
+	for (i = 0; i < iterations; i++)
+	{
+		duty += cal.getDuty(i & 1, i & 2, (i % 1000) / 100.0);
+	}
+	report("MotorCalibration::getDuty", iterations, LatencyHistogram::now() - tStart);
+	printf("  5 cm/s -> left %d%% right %d%% (sum %d)\n", cal.getDuty(MOTOR_LEFT, true, 5.0), cal.getDuty(MOTOR_RIGHT, true, 5.0), duty);
+
+	// Recording a wakeup latency sits on every RT thread's hot path
+	LatencyHistogram histogram;
+
+	tStart = LatencyHistogram::now();
+	for (i = 0; i < iterations; i++)
+	{
+		histogram.record((unsigned long long)i * 37);
+	}
+	report("LatencyHistogram::record", iterations, LatencyHistogram::now() - tStart);
+
+	// Readers hammer a pose provider while a writer publishes as fast as it can, no reader may see a mixed pose
+	PoseStress stress;
+	pthread_t  poseThreads[POSE_READERS + 1];
+	unsigned long reads = 0, torn = 0, backwards = 0;
+
+	stress.bRun       = true;
+	stress.nextReader = 0;
+	pthread_create(&poseThreads[0], NULL, pose_writer, &stress);
+	for (i = 0; i < POSE_READERS; i++)
+	{
+		pthread_create(&poseThreads[i + 1], NULL, pose_reader, &stress);
+	}
+
+	tStart = LatencyHistogram::now();
+	usleep(200000);
+	stress.bRun = false;
+
+	for (i = 0; i <= POSE_READERS; i++)
+	{
+		pthread_join(poseThreads[i], NULL);
+	}
+
+	for (i = 0; i < POSE_READERS; i++)
+	{
+		reads     += stress.reads[i];
+		torn      += stress.torn[i];
+		backwards += stress.backwards[i];
+	}
+	report("PoseProvider (contended)", reads, (LatencyHistogram::now() - tStart) * POSE_READERS);
+	printf("  %lu writes, %lu reads by %d readers, %lu torn, %lu out of order\n", stress.writes, reads, POSE_READERS, torn, backwards);
+
+	if (torn > 0 || backwards > 0)
+	{
+		fprintf(stderr, "a pose provider reader saw a torn or out of order pose\n");
+		sysfs_fake_destroy(root);
+		return 1;
+	}
+
+	// A 200 Hz loop doing a variable amount of work each iteration, paced by absolute deadlines
+	LoopTimer loop(200);
+	unsigned long long dtTotal = 0;
+
+	tStart = LatencyHistogram::now();
+	for (i = 0; i < 200; i++)
+	{
+		usleep((i % 10) * 300);
+		dtTotal += loop.wait();
+	}
+	report("LoopTimer (200 Hz)", 200, LatencyHistogram::now() - tStart);
+	printf("  mean dt %.3f ms overruns %lu jitter p99 %llu ns max %llu ns\n", dtTotal / 200 / 1000000.0, loop.getOverruns(), loop.getJitterHistogram().getPercentileNs(99), loop.getJitterHistogram().getMaxNs());
+
+	// The same control loop writes again, this time coalesced by the actuator queue
+	ActuatorStats stats;
+
+	actuator_start();
+
+	tStart = LatencyHistogram::now();
+	for (i = 0; i < iterations; i++)
+	{
+		motor_forward(MOTOR_LEFT, pwm_speed(50 + (i / 1000) % 2));
+	}
+	actuator_flush();
+	report("motor_forward (queued)", iterations, LatencyHistogram::now() - tStart);
+
+	actuator_get_stats(&stats);
+	printf("actuator: submitted %lu written %lu elided %lu superseded %lu failed %lu\n", stats.submitted, stats.written, stats.elided, stats.superseded, stats.failed);
+
+	const LatencyHistogram &wakeup = actuator_get_wakeup_latency();
+	printf("  writer wakeups %lu p50 %llu ns p99 %llu ns max %llu ns\n", wakeup.getCount(), wakeup.getPercentileNs(50), wakeup.getPercentileNs(99), wakeup.getMaxNs());
+
+	// A stop queued while the drive before it is still being written must reach the PWM
+	char      dutyFile[SYSFS_MAX_PATH];
+	char      dutyValue[ACTUATOR_MAX_VALUE];
+	char      fifo[SYSFS_MAX_PATH * 2];
+	pthread_t blocker;
+
+	snprintf(dutyFile, sizeof(dutyFile), "%s/%s", pwm_get_ctrl_file_prefix(0), DUTY_FILE);
+	snprintf(fifo, sizeof(fifo), "%s%s", root, ACTUATOR_FIFO);
+	mkfifo(fifo, 0600);
+
+	pwm_set_duty(0, 0);
+	actuator_flush();
+
+	pthread_create(&blocker, NULL, sysfs_blocker, const_cast<char *>(ACTUATOR_FIFO));
+	usleep(10000);
+	pwm_set_duty(0, PWM_DEFAULT_PERIOD / 2);
+	usleep(10000);
+	pwm_set_duty(0, 0);
+	close(open(fifo, O_WRONLY));
+	pthread_join(blocker, NULL);
+	actuator_flush();
+
+	int n = sysfs_read(dutyFile, dutyValue, sizeof(dutyValue) - 1);
+
+	dutyValue[n > 0 ? n : 0] = '\0';
+	printf("  duty after a stop queued behind a drive in flight: %s\n", dutyValue);
+
+	bot_stop();
+	actuator_stop();
+
+	if (strcmp(dutyValue, "0") != 0)
+	{
+		fprintf(stderr, "a stop queued while a drive was being written never reached the PWM\n");
+		sysfs_fake_destroy(root);
+		return 1;
+	}
+
+	sysfs_fake_destroy(root);
+
+	return 0;
+}
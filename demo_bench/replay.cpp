@@ -0,0 +1,72 @@
+/**
+ * replay.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Replays an encoder edge recording (see Odometer::record()) through the odometer's decoder as fast as it will go and
+ * reports the resulting odometry and the decode throughput.
+ *
+ * Usage: replay <recording> [repeat]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "edgerecord.h"
+#include "gpiomock.h"
+#include "odo.h"
+#include "latency.h"
+
+int main(int argc, char *argv[])
+{
+	EdgeRecording recording;
+	int           repeat = 1, ret;
+	double        tStart, elapsedNs;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <recording> [repeat]\n", argv[0]);
+		return 1;
+	}
+
+	if (argc > 2)
+	{
+		repeat = atoi(argv[2]);
+	}
+
+	if ((ret = recording.load(argv[1])) < 0)
+	{
+		fprintf(stderr, "could not load %s: %s\n", argv[1], strerror(-ret));
+		return 1;
+	}
+
+	if (recording.getLineCount() < ODO_LINES)
+	{
+		fprintf(stderr, "%s only has %u lines, the odometer needs %d\n", argv[1], recording.getLineCount(), ODO_LINES);
+		return 1;
+	}
+
+	const unsigned int *gpios = recording.getGpios();
+
+	printf("%s: %lu edges on GPIOs %u %u %u %u\n", argv[1], recording.getCount(), gpios[0], gpios[1], gpios[2], gpios[3]);
+
+	// The odometer still wants an edge source, it is never read from
+	GpioMockEdgeSource mock;
+	Odometer           odo(gpios[0], gpios[1], gpios[2], gpios[3], 2, ROBOT_PROFILE_OROBOTO.ticksPerRevolution, &mock);
+
+	tStart = LatencyHistogram::now();
+	for (int i = 0; i < repeat; i++)
+	{
+		odo.reset();
+		odo.replay(recording);
+	}
+	elapsedNs = LatencyHistogram::now() - tStart;
+
+	OdometrySnapshot snapshot = odo.getSnapshot();
+
+	printf("left %d right %d errors %u/%u last edge %llu ns\n", snapshot.odoLeft, snapshot.odoRight, snapshot.errorsLeft, snapshot.errorsRight, snapshot.timestampNs);
+	printf("%.1f ns/edge, %.2f M edges/s\n", elapsedNs / (recording.getCount() * (double)repeat), (recording.getCount() * (double)repeat) / (elapsedNs / 1e3));
+
+	return 0;
+}
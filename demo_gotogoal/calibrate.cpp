@@ -0,0 +1,67 @@
+/**
+ * calibrate.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Calibrate the motors by sweeping each wheel through the PWM duty cycles and measuring its velocity with the odometer,
+ * the resulting velocity to PWM table is what the controller loads at startup (see motorcal.h).
+ *
+ * Put the robot up on a stand first. Rerun after changing the batteries or a motor.
+ *
+ * Usage: calibrate [file] [duty step %]
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "motorlib.h"
+#include "adclib.h"
+#include "odo.h"
+#include "motorcal.h"
+#include "controller.h"
+
+int main(int argc, char *argv[])
+{
+	const char *      filename = argc > 1 ? argv[1] : MotorCalibration::getDefaultFile();
+	int               dutyStep = argc > 2 ? atoi(argv[2]) : MOTORCAL_DUTY_STEP;
+	MotorCalibration  cal;
+
+	// The robot as built, unless a profile file says otherwise (see robotprofile.h)
+	RobotProfile profile = ROBOT_PROFILE_OROBOTO;
+
+	if (profile.load() == -EINVAL)
+	{
+		fprintf(stderr, "%s is not a valid robot profile\n", RobotProfile::getDefaultFile());
+		return 1;
+	}
+
+	motor_init(profile);
+	adc_init();
+
+	Odometer odo(profile);
+
+	odo.run();
+
+	while ( ! odo.getRunning())
+	{
+		if (odo.getError())
+		{
+			fprintf(stderr, "the odometer failed to start\n");
+			return 1;
+		}
+
+		usleep(10000);
+	}
+
+	if (cal.sweep(&odo, dutyStep) < 0)
+	{
+		bot_stop();
+		return 1;
+	}
+
+	bot_stop();
+
+	return cal.save(filename) < 0 ? 1 : 0;
+}
@@ -4,6 +4,10 @@
  * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
  *
  * Simple demo to show basic go-to-goal strategy using a BeagleBone Black differential drive robot.
+ *
+ * Usage: demo_gotogoal [waypoint file, - for stdin]
+ *
+ * Without a file the robot drives the built-in waypoints (see mission.h for the file format).
  */
 
 #include <iostream>
@@ -13,42 +17,70 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 #include "motorlib.h"
 #include "adclib.h"
 #include "controller.h"
+#include "mission.h"
+#include "rtprofile.h"
 
 int main(int argc, char *argv[])
 {
-	int i, nWayPoints = 4;
+	int nWayPoints = 4, nReached;
 
-	float waypoints[][4] = {
+	Waypoint waypoints[] = {
 		{45.0, 0.0},
 		{90.0, 45.0},
 		{0.0, 45.0},
 		{1.0, 1.0}
 	};
 
-    motor_init();
+    // Opt-in real-time profile (OROBOTO_RT=1), before any threads are started
+    rt_init();
+
+    // The robot as built, unless a profile file says otherwise (see robotprofile.h)
+    RobotProfile profile = ROBOT_PROFILE_OROBOTO;
+
+    if (profile.load() == -EINVAL)
+    {
+    	fprintf(stderr, "%s is not a valid robot profile\n", RobotProfile::getDefaultFile());
+    	return 1;
+    }
+
+    motor_init(profile);
     adc_init();
 
-	Controller c;
+	// The control loop runs on this thread
+	rt_thread_enter(RT_THREAD_CONTROL);
 
-	for (i = 0; i < nWayPoints; i++)
+	Controller c(NULL, profile);
+	Mission    mission(&c);
+
+	rt_report();
+
+	if (argc > 1)
+	{
+		nReached = mission.run(argv[1]);
+	}
+	else
 	{
-		double fPosXStated = 0;
-		double fPosYStated = 0;
-
-		if (i != 0)
-		{
-			fPosXStated = waypoints[i-1][0];
-			fPosYStated = waypoints[i-1][1];
-		}
-
-		bot_stop();
-		sleep(1);
-		c.goToPosition(waypoints[i][0],waypoints[i][1], fPosXStated, fPosYStated);
+		nReached = mission.run(waypoints, nWayPoints);
 	}
 
+	if (nReached < 0)
+	{
+		return 1;
+	}
+
+	for (unsigned int i = 0; i < mission.getLegCount(); i++)
+	{
+		const MissionLeg &leg = mission.getLeg(i);
+
+		printf("leg %u: (%.2f, %.2f) %s in %.2f s\n", i + 1, leg.waypoint.x, leg.waypoint.y, leg.result == 0 ? "reached" : "abandoned", leg.transitNs / 1e9);
+	}
+
+	printf("%d of %u waypoints reached in %.2f s\n", nReached, mission.getLegCount(), mission.getTransitNs() / 1e9);
+
 	return 0;
 }
@@ -0,0 +1,294 @@
+/**
+ * tune.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Tunes the controller's gains (see gains.h) by flying the go-to-goal waypoints against simulated robots (see
+ * plantsim.h) rather than on the floor.
+ *
+ * Every candidate set of gains drives the same set of slightly different robots (variations of the robot profile, see
+ * robotprofile.h), each candidate is a job on a work stealing pool so all cores are kept busy. Candidates are scored on
+ * the time taken to reach the last waypoint, how much further than the straight line legs the robot drove and how far
+ * from the last waypoint it really stopped. A random search is followed by a search around the best candidates so far,
+ * and the best gains are written to the gains file the controller loads.
+ *
+ * Usage: tune [candidates] [robots] [gains file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "motorlib.h"
+#include "logger.h"
+#include "plantsim.h"
+#include "workpool.h"
+#include "controller.h"
+#include "gains.h"
+#include "mission.h"
+#include "latency.h"
+
+#define TUNE_WAYPOINTS      4
+#define TUNE_REFINE_BEST    8           // candidates searched around in the second round
+
+static const Waypoint gWaypoints[TUNE_WAYPOINTS] = {
+	{45.0, 0.0},
+	{90.0, 45.0},
+	{0.0, 45.0},
+	{1.0, 1.0}
+};
+
+// Score weights: seconds, cm driven beyond the straight line legs, cm from the last waypoint, missions that failed
+#define TUNE_WEIGHT_TIME        1.0
+#define TUNE_WEIGHT_PATH        0.2
+#define TUNE_WEIGHT_ERROR       2.0
+#define TUNE_WEIGHT_FAILURE     500.0
+
+#define TUNE_FAILURE_ERROR      10.0    // cm, further than this from the last waypoint is a failed mission
+
+struct Candidate
+{
+	ControllerGains	gains;
+
+	const std::vector<SimulatedPlantParams> * robots;
+	const RobotProfile *	profile;		// the robot the robots are variations of
+
+	double			time;				// mean seconds per mission
+	double			path;				// mean cm driven beyond the straight line legs
+	double			error;				// mean cm from the last waypoint
+	unsigned int	failures;
+	double			score;				// lower is better
+
+	bool			bDefault;			// the hand-tuned gains, for comparison
+};
+
+/**
+ * @param unsigned int * state
+ *
+ * @return double	uniform in [0, 1]
+ */
+static double uniform(unsigned int *state)
+{
+	return static_cast<double>(rand_r(state)) / RAND_MAX;
+}
+
+/**
+ * @return double	total length of the straight line legs from (0,0) through the waypoints
+ */
+static double get_ideal_path()
+{
+	double x = 0, y = 0, path = 0;
+
+	for (int i = 0; i < TUNE_WAYPOINTS; i++)
+	{
+		path += hypot(gWaypoints[i].x - x, gWaypoints[i].y - y);
+		x     = gWaypoints[i].x;
+		y     = gWaypoints[i].y;
+	}
+
+	return path;
+}
+
+/**
+ * Fly every robot through the waypoints with a candidate's gains (a job on the pool).
+ *
+ * @param void * arg	Candidate *
+ */
+static void evaluate(void *arg)
+{
+	Candidate *candidate = static_cast<Candidate *>(arg);
+	double     idealPath = get_ideal_path();
+	double     time = 0, path = 0, error = 0;
+
+	candidate->failures = 0;
+
+	for (size_t r = 0; r < candidate->robots->size(); r++)
+	{
+		SimulatedPlant plant((*candidate->robots)[r]);
+		Controller     c(&plant, *candidate->profile);
+		Mission        mission(&c);
+
+		c.setGains(candidate->gains);
+		mission.run(gWaypoints, TUNE_WAYPOINTS);
+
+		Pose   truth = plant.getTruePose();
+		double fError = hypot(truth.x - gWaypoints[TUNE_WAYPOINTS-1].x, truth.y - gWaypoints[TUNE_WAYPOINTS-1].y);
+
+		time  += mission.getTransitNs() / 1e9;
+		path  += plant.getTrueDistance() - idealPath;
+		error += fError;
+
+		if (fError > TUNE_FAILURE_ERROR)
+		{
+			candidate->failures++;
+		}
+	}
+
+	candidate->time  = time  / candidate->robots->size();
+	candidate->path  = path  / candidate->robots->size();
+	candidate->error = error / candidate->robots->size();
+	candidate->score = (TUNE_WEIGHT_TIME * candidate->time) + (TUNE_WEIGHT_PATH * candidate->path) + (TUNE_WEIGHT_ERROR * candidate->error) + (TUNE_WEIGHT_FAILURE * candidate->failures);
+}
+
+/**
+ * @param Candidate & a
+ * @param Candidate & b
+ *
+ * @return bool	a scored better than b
+ */
+static bool better(const Candidate &a, const Candidate &b)
+{
+	return a.score < b.score;
+}
+
+/**
+ * @param Candidate & candidate
+ *
+ * @return bool
+ */
+static bool is_default(const Candidate &candidate)
+{
+	return candidate.bDefault;
+}
+
+/**
+ * @param char *	  name
+ * @param Candidate & candidate
+ */
+static void print_candidate(const char *name, const Candidate &candidate)
+{
+	printf("%-8s P %.4f I %.6f D %.4f cruise %.2f approach %.2f -> score %.2f (%.1f s, %+.1f cm path, %.2f cm error, %u failed)\n", name, candidate.gains.proportional, candidate.gains.integral, candidate.gains.derivative, candidate.gains.cruiseVelocity, candidate.gains.approachVelocity, candidate.score, candidate.time, candidate.path, candidate.error, candidate.failures);
+}
+
+/**
+ * Score a round of candidates on the pool.
+ *
+ * @param WorkPool &				pool
+ * @param std::vector<Candidate> & candidates
+ */
+static void run_round(WorkPool &pool, std::vector<Candidate> &candidates)
+{
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		pool.submit(evaluate, &candidates[i]);
+	}
+
+	pool.wait();
+
+	std::sort(candidates.begin(), candidates.end(), better);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int nCandidates = 256, nRobots = 8, seed = 1;
+	const char * filename = NULL;
+
+	if (argc > 1)
+	{
+		nCandidates = atoi(argv[1]) > 1 ? atoi(argv[1]) : 2;
+	}
+
+	if (argc > 2)
+	{
+		nRobots = atoi(argv[2]) > 0 ? atoi(argv[2]) : 1;
+	}
+
+	if (argc > 3)
+	{
+		filename = argv[3];
+	}
+
+	// Thousands of missions, the controller's progress notices would swamp everything else
+	Logger::setQuiet(true);
+
+	// The robot as built, unless a profile file says otherwise (see robotprofile.h)
+	RobotProfile profile = ROBOT_PROFILE_OROBOTO;
+
+	if (profile.load() == -EINVAL)
+	{
+		fprintf(stderr, "%s is not a valid robot profile\n", RobotProfile::getDefaultFile());
+		return 1;
+	}
+
+	// The same robots for every candidate, so the scores compare gains and not luck
+	std::vector<SimulatedPlantParams> robots;
+
+	for (unsigned int r = 0; r < nRobots; r++)
+	{
+		robots.push_back(SimulatedPlant::getVariedParams(profile, &seed));
+	}
+
+	WorkPool pool;
+	double   tStart = LatencyHistogram::now();
+
+	// Round one: the hand-tuned defaults and random gains across a wide range
+	std::vector<Candidate> candidates(nCandidates);
+
+	for (unsigned int i = 0; i < nCandidates; i++)
+	{
+		candidates[i].robots   = &robots;
+		candidates[i].profile  = &profile;
+		candidates[i].bDefault = (i == 0);
+
+		if (candidates[i].bDefault)
+		{
+			// The profile's hand-tuned gains
+			candidates[i].gains = ControllerGains(profile);
+			continue;
+		}
+
+		candidates[i].gains.proportional     = 0.1 * pow(40.0, uniform(&seed));                 // 0.1 - 4
+		candidates[i].gains.integral         = uniform(&seed) < 0.25 ? 0.0 : 0.0001 * pow(100.0, uniform(&seed));
+		candidates[i].gains.derivative       = uniform(&seed) < 0.25 ? 0.0 : 0.2 * uniform(&seed);
+		candidates[i].gains.cruiseVelocity   = 5.0 + 5.0 * uniform(&seed);
+		candidates[i].gains.approachVelocity = 2.0 + 3.0 * uniform(&seed);
+	}
+
+	run_round(pool, candidates);
+
+	Candidate defaults = *std::find_if(candidates.begin(), candidates.end(), is_default);
+
+	// Round two: around the best so far
+	std::vector<Candidate> refined(nCandidates / 2);
+	unsigned int           nBest = TUNE_REFINE_BEST < nCandidates ? TUNE_REFINE_BEST : nCandidates;
+
+	for (size_t i = 0; i < refined.size(); i++)
+	{
+		const ControllerGains &best = candidates[i % nBest].gains;
+
+		refined[i].robots                   = &robots;
+		refined[i].profile                  = &profile;
+		refined[i].bDefault                 = false;
+		refined[i].gains.proportional       = best.proportional * (0.8 + 0.4 * uniform(&seed));
+		refined[i].gains.integral           = best.integral     * (0.8 + 0.4 * uniform(&seed));
+		refined[i].gains.derivative         = best.derivative   * (0.8 + 0.4 * uniform(&seed));
+		refined[i].gains.cruiseVelocity     = best.cruiseVelocity   * (0.9 + 0.2 * uniform(&seed));
+		refined[i].gains.approachVelocity   = best.approachVelocity * (0.9 + 0.2 * uniform(&seed));
+	}
+
+	run_round(pool, refined);
+
+	Candidate best = better(refined[0], candidates[0]) ? refined[0] : candidates[0];
+
+	double       elapsedNs = LatencyHistogram::now() - tStart;
+	unsigned int nMissions = (candidates.size() + refined.size()) * nRobots;
+
+	printf("%u missions (%zu candidates x %u robots) in %.1f s on %u threads, %.0f missions/minute, %lu jobs stolen\n", nMissions, candidates.size() + refined.size(), nRobots, elapsedNs / 1e9, pool.getThreadCount(), nMissions / (elapsedNs / 60e9), pool.getStolenCount());
+
+	print_candidate("default", defaults);
+	print_candidate("best", best);
+
+	if (best.gains.save(filename) < 0)
+	{
+		return 1;
+	}
+
+	printf("wrote %s\n", filename ? filename : ControllerGains::getDefaultFile());
+
+	return 0;
+}
@@ -0,0 +1,116 @@
+/**
+ * main.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Runs the go-to-goal demo's waypoint mission against a simulated robot (see plantsim.h), many times over and faster
+ * than real time. Each mission gets a slightly different robot (motor mismatch, deadband, lag and noise) so that the
+ * controller's gains can be judged across the robots it might actually be driving.
+ *
+ * The missions are flown as one continuous run through the waypoints (see mission.h), set OROBOTO_BLEND_RADIUS to
+ * change how early each waypoint hands over to the next. The controller's progress notices are only logged with -v.
+ *
+ * Usage: demo_sim [-v] [missions] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "motorlib.h"
+#include "logger.h"
+#include "plantsim.h"
+#include "controller.h"
+#include "mission.h"
+#include "latency.h"
+
+int main(int argc, char *argv[])
+{
+	int          mission, nWayPoints = 4, nMissions = 1000;
+	unsigned int seed = 1;
+	bool         bVerbose = false;
+
+	Waypoint waypoints[] = {
+		{45.0, 0.0},
+		{90.0, 45.0},
+		{0.0, 45.0},
+		{1.0, 1.0}
+	};
+
+	if (argc > 1 && strcmp(argv[1], "-v") == 0)
+	{
+		bVerbose = true;
+		argc--;
+		argv++;
+	}
+
+	if (argc > 1 && (nMissions = atoi(argv[1])) <= 0)
+	{
+		fprintf(stderr, "Usage: demo_sim [-v] [missions] [seed]\n");
+		return 1;
+	}
+
+	if (argc > 2)
+	{
+		seed = atoi(argv[2]);
+	}
+
+	// Every notice when verbose, the simulation would otherwise log faster than the ring is written and drop most
+	Logger::setQuiet( ! bVerbose);
+	Logger::setSynchronous(bVerbose);
+
+	// The robot as built, unless a profile file says otherwise (see robotprofile.h)
+	RobotProfile profile = ROBOT_PROFILE_OROBOTO;
+
+	if (profile.load() == -EINVAL)
+	{
+		fprintf(stderr, "%s is not a valid robot profile\n", RobotProfile::getDefaultFile());
+		return 1;
+	}
+
+	double             fErrorSum = 0, fErrorMax = 0, fDriftSum = 0, fDriftMax = 0;
+	unsigned long long virtualNs = 0;
+	int                nMissed = 0;
+	unsigned long long tStart = LatencyHistogram::now();
+
+	for (mission = 0; mission < nMissions; mission++)
+	{
+		// A different robot every time
+		SimulatedPlant plant(SimulatedPlant::getVariedParams(profile, &seed));
+		Controller     c(&plant, profile);
+		Mission        m(&c);
+
+		m.run(waypoints, nWayPoints);
+
+		// Where did it really end up, and how far out was its own idea of that?
+		Pose truth    = plant.getTruePose();
+		Pose believed = c.getCurrentPose();
+
+		double fError = hypot(truth.x - waypoints[nWayPoints-1].x, truth.y - waypoints[nWayPoints-1].y);
+		double fDrift = hypot(truth.x - believed.x, truth.y - believed.y);
+
+		fErrorSum += fError;
+		fDriftSum += fDrift;
+		fErrorMax  = fError > fErrorMax ? fError : fErrorMax;
+		fDriftMax  = fDrift > fDriftMax ? fDrift : fDriftMax;
+
+		// The controller stops within 5cm of where it thinks the waypoint is
+		if (fError > 10.0)
+		{
+			nMissed++;
+		}
+
+		virtualNs += m.getTransitNs();
+	}
+
+	double elapsedNs = LatencyHistogram::now() - tStart;
+
+	printf("%d missions in %.2f s (%.0f missions/minute), %.0f s simulated (%.0fx real time)\n", nMissions, elapsedNs / 1e9, nMissions / (elapsedNs / 60e9), virtualNs / 1e9, virtualNs / elapsedNs);
+	printf("mission time:         mean %.2f s\n", virtualNs / 1e9 / nMissions);
+	printf("final position error: mean %.2f cm max %.2f cm, %d missions ended more than 10 cm out\n", fErrorSum / nMissions, fErrorMax, nMissed);
+	printf("odometry drift:       mean %.2f cm max %.2f cm\n", fDriftSum / nMissions, fDriftMax);
+
+	return 0;
+}
@@ -14,48 +14,58 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 #include "motorlib.h"
 #include "adclib.h"
 #include "controller.h"
+#include "mission.h"
+#include "rtprofile.h"
 #include "sonar.h"
+#include "logger.h"
 
 int main(int argc, char *argv[])
 {
-	int i, nWayPoints = 4;
+	int nWayPoints = 4;
 
-	float waypoints[][4] = {
+	Waypoint waypoints[] = {
 		{45.0, 0.0},
 		{90.0, 45.0},
 		{0.0, 45.0},
 		{1.0, 1.0}
 	};
 
-    motor_init();
+    // Opt-in real-time profile (OROBOTO_RT=1), before any threads are started
+    rt_init();
+
+    // The robot as built, unless a profile file says otherwise (see robotprofile.h)
+    RobotProfile profile = ROBOT_PROFILE_OROBOTO;
+
+    if (profile.load() == -EINVAL)
+    {
+    	fprintf(stderr, "%s is not a valid robot profile\n", RobotProfile::getDefaultFile());
+    	return 1;
+    }
+
+    motor_init(profile);
     adc_init();
 
-	Controller controller;
+	// The control loop runs on this thread
+	rt_thread_enter(RT_THREAD_CONTROL);
+
+	Controller controller(NULL, profile);
+	Mission    mission(&controller);
 	Sonar *sonar = new Sonar(SONAR_ADC_CHANNEL, SONAR_SAMPLES_PER_MEASUREMENT, &controller);
 
 	sonar->run();
 	sonar->startMeasuring();
 
-	for (i = 0; i < nWayPoints; i++)
-	{
-		double fPosXStated = 0;
-		double fPosYStated = 0;
-
-		if (i != 0)
-		{
-			fPosXStated = waypoints[i-1][0];
-			fPosYStated = waypoints[i-1][1];
-		}
+	rt_report();
 
-		bot_stop();
-		sleep(1);
+	// Measurements are taken all the way round, the robot only stops at the end
+	mission.run(waypoints, nWayPoints);
 
-		controller.goToPosition(waypoints[i][0],waypoints[i][1], fPosXStated, fPosYStated);
-	}
+	sonar->getWakeupLatency().log(Logger::getInstance(), "sonar wakeup latency");
 
 	return 0;
 }
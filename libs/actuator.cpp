@@ -0,0 +1,441 @@
+/**
+ * actuator.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "actuator.h"
+#include "sysfslib.h"
+#include "logger.h"
+#include "latency.h"
+#include "rtprofile.h"
+
+/**
+ * One slot per attribute. Slots are claimed on first use and never released, so a slot's path can be read without
+ * holding the lock once it has been set.
+ */
+struct ActuatorSlot
+{
+    char    path[SYSFS_MAX_PATH];
+    char    pending[ACTUATOR_MAX_VALUE];     // value waiting to be written (valid if dirty)
+    char    inflight[ACTUATOR_MAX_VALUE];    // value the writer thread is writing to sysfs right now (valid if busy)
+    char    written[ACTUATOR_MAX_VALUE];     // value last written to sysfs (valid if hasWritten)
+    bool    dirty;
+    bool    busy;
+    bool    hasWritten;
+    int     next;                           // next dirty slot in the queue, -1 if this is the tail
+};
+
+static ActuatorSlot     gActuatorSlots[ACTUATOR_MAX_SLOTS];
+static unsigned int     gActuatorSlotCount = 0;
+
+static int              gActuatorHead = -1;         // FIFO of dirty slots
+static int              gActuatorTail = -1;
+static bool             gActuatorBusy = false;      // is the writer thread in the middle of a sysfs write?
+static int              gActuatorBatch = 0;         // open actuator_begin() calls, the writer waits until they commit
+
+static bool             gActuatorRunning  = false;
+static bool             gActuatorStopping = false;
+static bool             gActuatorAtExit   = false;
+static pthread_t        gActuatorThread;
+
+static ActuatorStats    gActuatorStats;
+
+static bool             gActuatorWaiting  = false;  // is the writer thread waiting for work?
+static unsigned long long gActuatorWokenNs = 0;     // when it was signalled, 0 if it hasn't been
+static LatencyHistogram gActuatorWakeupLatency;     // how long from being signalled until the writer runs
+
+static pthread_mutex_t  gActuatorLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   gActuatorWork = PTHREAD_COND_INITIALIZER;     // signalled when a slot becomes dirty or on stop
+static pthread_cond_t   gActuatorIdle = PTHREAD_COND_INITIALIZER;     // signalled when the queue drains
+
+/**
+ * Find (or claim) the slot for an attribute.
+ *
+ * Must be called with gActuatorLock held.
+ *
+ * @param char * filename
+ *
+ * @return ActuatorSlot *   NULL if there are no free slots or the path is too long
+ */
+static ActuatorSlot * actuator_slot_get(const char *filename)
+{
+    unsigned int hash = 2166136261u;
+
+    for (const char *p = filename; *p; p++)
+    {
+        hash = (hash ^ static_cast<unsigned char>(*p)) * 16777619u;
+    }
+
+    for (unsigned int slot = hash & (ACTUATOR_MAX_SLOTS - 1); ; slot = (slot + 1) & (ACTUATOR_MAX_SLOTS - 1))
+    {
+        ActuatorSlot *s = &gActuatorSlots[slot];
+
+        if (s->path[0] == '\0')
+        {
+            if (gActuatorSlotCount >= ACTUATOR_MAX_SLOTS - 1 || strlen(filename) >= sizeof(s->path))
+            {
+                return NULL;
+            }
+
+            snprintf(s->path, sizeof(s->path), "%s", filename);
+            s->dirty      = false;
+            s->busy       = false;
+            s->hasWritten = false;
+            s->next       = -1;
+
+            gActuatorSlotCount++;
+            return s;
+        }
+
+        if (strcmp(s->path, filename) == 0)
+        {
+            return s;
+        }
+    }
+}
+
+/**
+ * Signal the writer thread that there is work (or that it should stop), gActuatorLock must be held.
+ */
+static void actuator_wake_writer()
+{
+    if (gActuatorWaiting && gActuatorWokenNs == 0)
+    {
+        gActuatorWokenNs = LatencyHistogram::now();
+    }
+
+    pthread_cond_signal(&gActuatorWork);
+}
+
+/**
+ * The writer thread: pops dirty slots in FIFO order and writes their pending value to sysfs.
+ */
+extern "C" void * gActuatorWriterThread(void *arg)
+{
+    rt_thread_enter(RT_THREAD_ACTUATOR);
+
+    pthread_mutex_lock(&gActuatorLock);
+
+    while (true)
+    {
+        while ((gActuatorHead < 0 || gActuatorBatch > 0) && ! gActuatorStopping)
+        {
+            gActuatorWaiting = true;
+            pthread_cond_wait(&gActuatorWork, &gActuatorLock);
+        }
+
+        gActuatorWaiting = false;
+
+        if (gActuatorWokenNs != 0)
+        {
+            gActuatorWakeupLatency.record(LatencyHistogram::now() - gActuatorWokenNs);
+            gActuatorWokenNs = 0;
+        }
+
+        if (gActuatorHead < 0)
+        {
+            break;  // stopping and drained
+        }
+
+        ActuatorSlot *s = &gActuatorSlots[gActuatorHead];
+
+        gActuatorHead = s->next;
+        if (gActuatorHead < 0)
+        {
+            gActuatorTail = -1;
+        }
+
+        s->dirty = false;
+        s->next  = -1;
+
+        // The value may have been set back to what is already there while it was queued
+        if (s->hasWritten && strcmp(s->pending, s->written) == 0)
+        {
+            gActuatorStats.elided++;
+        }
+        else
+        {
+            // Until the write returns this is what a new value has to differ from to be worth writing
+            memcpy(s->inflight, s->pending, sizeof(s->inflight));
+            s->busy = true;
+
+            gActuatorBusy = true;
+            pthread_mutex_unlock(&gActuatorLock);
+
+            int ret = sysfs_write(s->path, s->inflight);
+
+            pthread_mutex_lock(&gActuatorLock);
+            gActuatorBusy = false;
+            s->busy       = false;
+
+            if (ret == 0)
+            {
+                memcpy(s->written, s->inflight, sizeof(s->written));
+                s->hasWritten = true;
+                gActuatorStats.written++;
+            }
+            else
+            {
+                s->hasWritten = false;
+                gActuatorStats.failed++;
+            }
+        }
+
+        if (gActuatorHead < 0)
+        {
+            pthread_cond_broadcast(&gActuatorIdle);
+        }
+    }
+
+    pthread_cond_broadcast(&gActuatorIdle);
+    pthread_mutex_unlock(&gActuatorLock);
+
+    return NULL;
+}
+
+/**
+ * Start the writer thread. From now on actuator_write() returns without waiting for sysfs.
+ *
+ * The queue is drained and the thread stopped automatically at exit.
+ *
+ * @return int
+ */
+int actuator_start()
+{
+    pthread_mutex_lock(&gActuatorLock);
+
+    if (gActuatorRunning)
+    {
+        pthread_mutex_unlock(&gActuatorLock);
+        return 0;
+    }
+
+    // Anything could have been written synchronously since we last ran, forget what we think is there
+    for (unsigned int i = 0; i < ACTUATOR_MAX_SLOTS; i++)
+    {
+        gActuatorSlots[i].hasWritten = false;
+    }
+
+    gActuatorStopping = false;
+
+    pthread_attr_t attr;
+    rt_thread_attr_init(&attr);
+
+    int ret = pthread_create(&gActuatorThread, &attr, gActuatorWriterThread, NULL);
+
+    pthread_attr_destroy(&attr);
+
+    if (ret != 0)
+    {
+        pthread_mutex_unlock(&gActuatorLock);
+
+    	Logger::getInstance()->error("actuator::actuator_start: failed to create writer thread");
+        return -1;
+    }
+
+    gActuatorRunning = true;
+
+    if ( ! gActuatorAtExit)
+    {
+        atexit(actuator_stop);
+        gActuatorAtExit = true;
+    }
+
+    pthread_mutex_unlock(&gActuatorLock);
+
+    return 0;
+}
+
+/**
+ * Drain the queue and stop the writer thread, subsequent writes are synchronous.
+ */
+void actuator_stop()
+{
+    pthread_mutex_lock(&gActuatorLock);
+
+    if ( ! gActuatorRunning || gActuatorStopping)
+    {
+        pthread_mutex_unlock(&gActuatorLock);
+        return;
+    }
+
+    gActuatorStopping = true;
+    actuator_wake_writer();
+    pthread_mutex_unlock(&gActuatorLock);
+
+    pthread_join(gActuatorThread, NULL);
+
+    pthread_mutex_lock(&gActuatorLock);
+    gActuatorRunning  = false;
+    gActuatorStopping = false;
+    pthread_mutex_unlock(&gActuatorLock);
+}
+
+/**
+ * Block until everything queued so far has been written.
+ */
+void actuator_flush()
+{
+    pthread_mutex_lock(&gActuatorLock);
+
+    while (gActuatorRunning && (gActuatorHead >= 0 || gActuatorBusy))
+    {
+        pthread_cond_wait(&gActuatorIdle, &gActuatorLock);
+    }
+
+    pthread_mutex_unlock(&gActuatorLock);
+}
+
+/**
+ * Is the writer thread running?
+ *
+ * @return bool
+ */
+bool actuator_running()
+{
+    return gActuatorRunning;
+}
+
+/**
+ * Start a batch of writes that should reach the hardware together, ie. without the writer thread picking up the
+ * intermediate states. Batches nest, every actuator_begin() must be matched by actuator_commit().
+ */
+void actuator_begin()
+{
+    pthread_mutex_lock(&gActuatorLock);
+    gActuatorBatch++;
+    pthread_mutex_unlock(&gActuatorLock);
+}
+
+/**
+ * Finish a batch started with actuator_begin().
+ */
+void actuator_commit()
+{
+    pthread_mutex_lock(&gActuatorLock);
+
+    if (gActuatorBatch > 0 && --gActuatorBatch == 0)
+    {
+        actuator_wake_writer();
+    }
+
+    pthread_mutex_unlock(&gActuatorLock);
+}
+
+/**
+ * Queue a write to an actuator attribute.
+ *
+ * @param char * filename   the sysfs attribute
+ * @param char * value      the NULL terminated value to write
+ *
+ * @return int              0 if queued (or elided), otherwise the result of the synchronous write
+ */
+int actuator_write(const char *filename, const char *value)
+{
+    ActuatorSlot *s;
+
+    pthread_mutex_lock(&gActuatorLock);
+
+    if ( ! gActuatorRunning || gActuatorStopping || strlen(value) >= ACTUATOR_MAX_VALUE || (s = actuator_slot_get(filename)) == NULL)
+    {
+        pthread_mutex_unlock(&gActuatorLock);
+
+        return sysfs_write(filename, value);
+    }
+
+    gActuatorStats.submitted++;
+
+    if (s->dirty)
+    {
+        // Last writer wins
+        if (strcmp(s->pending, value) == 0)
+        {
+            gActuatorStats.elided++;
+        }
+        else
+        {
+            snprintf(s->pending, sizeof(s->pending), "%s", value);
+            gActuatorStats.superseded++;
+        }
+    }
+    else if (s->busy ? strcmp(s->inflight, value) == 0 : s->hasWritten && strcmp(s->written, value) == 0)
+    {
+        gActuatorStats.elided++;
+    }
+    else
+    {
+        int slot = s - gActuatorSlots;
+
+        snprintf(s->pending, sizeof(s->pending), "%s", value);
+        s->dirty = true;
+        s->next  = -1;
+
+        if (gActuatorTail < 0)
+        {
+            gActuatorHead = slot;
+        }
+        else
+        {
+            gActuatorSlots[gActuatorTail].next = slot;
+        }
+
+        gActuatorTail = slot;
+
+        actuator_wake_writer();
+    }
+
+    pthread_mutex_unlock(&gActuatorLock);
+
+    return 0;
+}
+
+/**
+ * Forget what was last written to any attribute whose path starts with prefix, ie. because the device was re-exported
+ * and its attributes are back at their defaults. The next write to them will not be elided.
+ *
+ * @param char * prefix
+ */
+void actuator_invalidate(const char *prefix)
+{
+    size_t prefixLen = strlen(prefix);
+
+    pthread_mutex_lock(&gActuatorLock);
+
+    for (unsigned int i = 0; i < ACTUATOR_MAX_SLOTS; i++)
+    {
+        if (strncmp(gActuatorSlots[i].path, prefix, prefixLen) == 0)
+        {
+            gActuatorSlots[i].hasWritten = false;
+        }
+    }
+
+    pthread_mutex_unlock(&gActuatorLock);
+}
+
+/**
+ * Get the queue's counters.
+ *
+ * @param ActuatorStats * stats
+ */
+void actuator_get_stats(ActuatorStats *stats)
+{
+    pthread_mutex_lock(&gActuatorLock);
+    *stats = gActuatorStats;
+    pthread_mutex_unlock(&gActuatorLock);
+}
+
+/**
+ * How long the writer thread takes to run once it has been signalled.
+ *
+ * @return LatencyHistogram &
+ */
+const LatencyHistogram & actuator_get_wakeup_latency()
+{
+    return gActuatorWakeupLatency;
+}
@@ -0,0 +1,52 @@
+/**
+ * actuator.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Write-coalescing asynchronous actuator queue.
+ *
+ * Once actuator_start() has been called, writes to actuator attributes (PWM duty cycles, GPIO values, LED brightness)
+ * made through actuator_write() are handed to a dedicated writer thread rather than hitting sysfs on the caller's
+ * thread. The queue remembers the last value written to each attribute and:
+ *
+ * - drops writes that would not change the attribute's value
+ * - collapses writes to an attribute that is already queued (last writer wins)
+ *
+ * so that, for instance, the motor_stop() that motor_forward() does before setting the real duty cycle never reaches
+ * the hardware. Attributes are written in the order they were first queued.
+ *
+ * Before actuator_start() (or after actuator_stop()) actuator_write() is simply sysfs_write().
+ */
+
+#ifndef _ACTUATOR_H_INCLUDED
+#define _ACTUATOR_H_INCLUDED
+
+#define ACTUATOR_MAX_SLOTS  64          // number of distinct attributes that can be queued, must be a power of two
+#define ACTUATOR_MAX_VALUE  16          // longest value (including NULL) that can be queued
+
+struct ActuatorStats
+{
+	unsigned long submitted;            // calls to actuator_write() while the queue was running
+	unsigned long written;              // writes that actually reached sysfs
+	unsigned long elided;               // writes dropped because they would not have changed the attribute
+	unsigned long superseded;           // queued writes replaced by a later write to the same attribute
+	unsigned long failed;               // writes that reached sysfs but failed
+};
+
+int  actuator_start();
+void actuator_stop();
+void actuator_flush();
+bool actuator_running();
+
+void actuator_begin();
+void actuator_commit();
+int  actuator_write(const char *filename, const char *value);
+void actuator_invalidate(const char *prefix);
+
+void actuator_get_stats(ActuatorStats *stats);
+
+class LatencyHistogram;
+
+const LatencyHistogram & actuator_get_wakeup_latency();
+
+#endif // _ACTUATOR_H_INCLUDED
@@ -9,10 +9,19 @@
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <pthread.h>
 
 #include "adclib.h"
 #include "logger.h"
 #include "sysfslib.h"
+#include "sysfsattr.h"
+
+/**
+ * One attribute per AINx file, opened the first time the channel is read.
+ */
+static const char *     gAdcFiles[ADC_CHANNELS] = { ADC_0_DIR, ADC_1_DIR, ADC_2_DIR, ADC_3_DIR, ADC_4_DIR, ADC_5_DIR, ADC_6_DIR, ADC_7_DIR };
+static SysfsIntAttr     gAdcAttrs[ADC_CHANNELS];
+static pthread_mutex_t  gAdcLock = PTHREAD_MUTEX_INITIALIZER;
 
 /**
  * Initialise the ADC subsystem.
@@ -21,7 +30,56 @@
  */
 int adc_init()
 {
-    return sysfs_write(SLOTS_FILE, ADC_DRIVER);
+    int ret = sysfs_write(SLOTS_FILE, ADC_DRIVER);
+
+    // Loading the cape (re)creates the AINx files
+    sysfs_invalidate(ADC_DIR_PREFIX);
+
+    pthread_mutex_lock(&gAdcLock);
+
+    for (int i = 0; i < ADC_CHANNELS; i++)
+    {
+        gAdcAttrs[i].close();
+    }
+
+    pthread_mutex_unlock(&gAdcLock);
+
+    return ret;
+}
+
+/**
+ * Get the (open) attribute for an ADC channel.
+ *
+ * @param int adc      the ADC channel
+ *
+ * @return SysfsIntAttr *   NULL if the channel is unknown or can't be opened
+ */
+static SysfsIntAttr * adc_get_attr(int adc)
+{
+    SysfsIntAttr *attr;
+    char          ctrlFile[1024];
+
+    if (adc < 0 || adc >= ADC_CHANNELS)
+    {
+        return NULL;
+    }
+
+    attr = &gAdcAttrs[adc];
+
+    if ( ! attr->isOpen())
+    {
+        pthread_mutex_lock(&gAdcLock);
+
+        if ( ! attr->isOpen())
+        {
+            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, gAdcFiles[adc]);
+            attr->open(ctrlFile, O_RDONLY);
+        }
+
+        pthread_mutex_unlock(&gAdcLock);
+    }
+
+    return attr->isOpen() ? attr : NULL;
 }
 
 /**
@@ -37,165 +95,72 @@ int adc_init()
  */
 int adc_get_value(int adc)
 {
-    char    ctrlFile[1024];
-    char    adcVal[16];
-    int 	bytesRead;
+    SysfsIntAttr *attr;
+    int           value;
 
-    switch (adc)
+    if ((attr = adc_get_attr(adc)) == NULL)
     {
-        case 0:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_0_DIR);
-            break;
-        case 1:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_1_DIR);
-            break;
-        case 2:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_2_DIR);
-            break;
-        case 3:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_3_DIR);
-            break;
-        case 4:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_4_DIR);
-            break;
-        case 5:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_5_DIR);
-            break;
-        case 6:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_6_DIR);
-            break;
-        case 7:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_7_DIR);
-            break;
-
-        default:
-        	Logger::getInstance()->error("adc::adc_get_value: unknown ADC");
-            return -1;
-    }
-
-    memset(adcVal, 0, sizeof(adcVal));
-
-    bytesRead = sysfs_read(ctrlFile, adcVal, sizeof(adcVal));
-
-    if (bytesRead < 0)
-    {
-    	Logger::getInstance()->error("adc::adc_get_value: failed to read ADC sysfs file");
+    	Logger::getInstance()->error("adc::adc_get_value: unknown ADC or failed to open ADC sysfs file");
         return -1;
     }
 
-    if (bytesRead >= sizeof(adcVal))
+    if (attr->read(&value) < 0)
     {
-    	Logger::getInstance()->error("adc::adc_get_value: overflow");
+    	Logger::getInstance()->error("adc::adc_get_value: failed to read ADC sysfs file");
         return -1;
     }
-    else
-    {
-    	adcVal[bytesRead+1] = '\0';
-    }
 
-    return atoi(adcVal);
+    return value;
 }
 
 /**
  * Read the value from an ADC by taking several samples and using a median filter to choose the sample to return.
  *
  * @param int adc               the ADC channel to read
- * @param int samples_requested the number of samples to take
+ * @param int samples_requested the number of samples to take (at most ADC_MAX_SAMPLES)
  *
  * @return int
  */
 int adc_sample(int adc, int samplesRequested)
 {
-    char ctrlFile[1024];
-    char adcVal[16];
-
-    int          fd, i, samplesStored;
-    int *        sampleBuf;
-    unsigned int bytesRead;
-
-    switch (adc)
-    {
-        case 0:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_0_DIR);
-            break;
-        case 1:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_1_DIR);
-            break;
-        case 2:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_2_DIR);
-            break;
-        case 3:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_3_DIR);
-            break;
-        case 4:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_4_DIR);
-            break;
-        case 5:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_5_DIR);
-            break;
-        case 6:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_6_DIR);
-            break;
-        case 7:
-            snprintf(ctrlFile, sizeof(ctrlFile), "%s%s", ADC_DIR_PREFIX, ADC_7_DIR);
-            break;
-
-        default:
-        	Logger::getInstance()->error("adc::adc_sample: unknown ADC");
-            return -1;
-    }
+    SysfsIntAttr *attr;
+    int           sampleBuf[ADC_MAX_SAMPLES];
+    int           i, samplesStored;
 
-    if ((fd = sysfs_open_read(ctrlFile, O_RDONLY)) < 0)
+    if ((attr = adc_get_attr(adc)) == NULL)
     {
-    	Logger::getInstance()->error("adc::adc_sample: failed to open ADC sysfs control file");
+    	Logger::getInstance()->error("adc::adc_sample: unknown ADC or failed to open ADC sysfs control file");
         return -1;
     }
 
-    // Allocate the sample buffer
-    sampleBuf = (int*)malloc(samplesRequested * sizeof(int));
-    if (sampleBuf == NULL)
+    if (samplesRequested > ADC_MAX_SAMPLES)
     {
-    	Logger::getInstance()->error("adc::adc_sample: failed to allocate sample buffer, out of memory?");
-        sysfs_close(fd);
-        return -1;
+        samplesRequested = ADC_MAX_SAMPLES;
     }
 
-    memset(sampleBuf, 0, samplesRequested * sizeof(int));
-
     for (i = 0, samplesStored = 0; samplesStored < samplesRequested && (i < samplesRequested * 2); i++)
     {
         usleep(1000);  // 1ms
-        memset(adcVal, 0, sizeof(adcVal));
-
-        lseek(fd, 0, SEEK_SET);
-
-        if ((bytesRead = read(fd, adcVal, sizeof(adcVal))) <= 0)
-        {
-        	Logger::getInstance()->debug("adc::adc_sample: failed to take sample, trying again");
-            continue;
-        }
 
-        if (bytesRead >= sizeof(adcVal))
+        if (attr->read(&sampleBuf[samplesStored]) < 0)
         {
-        	Logger::getInstance()->notice("adc::adc_sample: overflow, trying again");
+        	LOGGER_DEBUG(Logger::getInstance(), "adc::adc_sample: failed to take sample, trying again");
             continue;
         }
 
-        adcVal[bytesRead+1] = '\0';
-        sampleBuf[samplesStored] = atoi(adcVal);
-
         samplesStored++;
     }
 
+    if (samplesStored == 0)
+    {
+    	Logger::getInstance()->error("adc::adc_sample: failed to take any samples");
+        return -1;
+    }
+
     // sort to find outliers and select median
     qsort(sampleBuf, samplesStored, sizeof(int), adc_compare);
 
-    i = sampleBuf[samplesStored / 2];
-
-    free(sampleBuf);
-    sysfs_close(fd);
-
-    return i;
+    return sampleBuf[samplesStored / 2];
 }
 
 /**
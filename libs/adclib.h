@@ -25,6 +25,9 @@
 #define ADC_6_DIR           "AIN6"
 #define ADC_7_DIR           "AIN7"
 
+#define ADC_CHANNELS        8
+#define ADC_MAX_SAMPLES     64                                    // most samples adc_sample() will take per call
+
 int adc_init();
 int adc_get_value(int adc);
 int adc_sample(int adc, int samplesRequested);
@@ -0,0 +1,485 @@
+/**
+ * edgerecord.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/stat.h>
+
+#include "edgerecord.h"
+#include "rtprofile.h"
+
+/**
+ * Write all of a buffer, retrying short writes.
+ *
+ * @return int	0 or -errno
+ */
+static int write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = static_cast<const char *>(buf);
+	ssize_t     n;
+
+	while (len > 0)
+	{
+		if ((n = write(fd, p, len)) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			return -errno;
+		}
+
+		p   += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * ctor
+ */
+EdgeRecorder::EdgeRecorder() : _nFailed(0)
+{
+	_fd         = -1;
+	_bufferSize = 0;
+	_fill       = 0;
+	_nFull      = 0;
+	_nLines     = 0;
+	_nRecorded  = 0;
+	_writeError = 0;
+	_bWriting   = false;
+	_bStopping  = false;
+
+	for (unsigned int i = 0; i < EDGE_RECORD_BUFFERS; i++)
+	{
+		_buffers[i]   = NULL;
+		_nBuffered[i] = 0;
+	}
+
+	pthread_mutex_init(&_lock, NULL);
+	pthread_cond_init(&_work, NULL);
+	pthread_cond_init(&_written, NULL);
+}
+
+/**
+ * dtor
+ */
+EdgeRecorder::~EdgeRecorder()
+{
+	close();
+
+	pthread_cond_destroy(&_written);
+	pthread_cond_destroy(&_work);
+	pthread_mutex_destroy(&_lock);
+}
+
+/**
+ * EdgeRecorder::open - start a new recording, replacing any existing file
+ *
+ * @param char *		  filename
+ * @param unsigned int *  gpios			GPIO #s whose edges will be recorded
+ * @param unsigned char * levels		their levels now
+ * @param unsigned int	  nGpios
+ * @param unsigned int	  bufferSize	records to buffer between writes
+ *
+ * @return int	0 or -errno
+ */
+int EdgeRecorder::open(const char *filename, const unsigned int *gpios, const unsigned char *levels, unsigned int nGpios, unsigned int bufferSize)
+{
+	EdgeRecordHeader header;
+	pthread_attr_t   attr;
+	int              ret;
+
+	if (nGpios > GPIO_EDGE_MAX_LINES || bufferSize == 0)
+	{
+		return -EINVAL;
+	}
+
+	close();
+
+	memset(&header, 0, sizeof(header));
+	header.magic   = EDGE_RECORD_MAGIC;
+	header.version = EDGE_RECORD_VERSION;
+	header.nLines  = nGpios;
+
+	for (unsigned int i = 0; i < nGpios; i++)
+	{
+		header.gpios[i]  = _gpios[i] = gpios[i];
+		header.levels[i] = levels[i];
+	}
+
+	if ((_fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+	{
+		return -errno;
+	}
+
+	if ((ret = write_all(_fd, &header, sizeof(header))) < 0)
+	{
+		::close(_fd);
+		_fd = -1;
+
+		return ret;
+	}
+
+	for (unsigned int i = 0; i < EDGE_RECORD_BUFFERS; i++)
+	{
+		_buffers[i]   = new EdgeRecord[bufferSize];
+		_nBuffered[i] = 0;
+	}
+
+	_bufferSize = bufferSize;
+	_fill       = 0;
+	_nFull      = 0;
+	_nLines     = nGpios;
+	_nRecorded  = 0;
+	_nFailed    = 0;
+	_writeError = 0;
+	_bStopping  = false;
+
+	// The writer never runs at (or inherits) the recording thread's priority
+	struct sched_param param;
+	memset(&param, 0, sizeof(param));
+
+	rt_thread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	pthread_attr_setschedparam(&attr, &param);
+
+	ret = pthread_create(&_thread, &attr, writerThread, this);
+
+	pthread_attr_destroy(&attr);
+
+	if (ret != 0)
+	{
+		close();
+		return -ret;
+	}
+
+	_bWriting = true;
+
+	return 0;
+}
+
+/**
+ * EdgeRecorder::add - record a batch of edges, edges on GPIOs that aren't being recorded are ignored
+ *
+ * @param GpioEdgeEvent * events
+ * @param int             nEvents
+ *
+ * @return void
+ */
+void EdgeRecorder::add(const GpioEdgeEvent *events, int nEvents)
+{
+	unsigned int line;
+
+	if (_fd < 0)
+	{
+		return;
+	}
+
+	for (int i = 0; i < nEvents; i++)
+	{
+		for (line = 0; line < _nLines && _gpios[line] != events[i].gpio; line++)
+			;
+
+		if (line == _nLines)
+		{
+			continue;
+		}
+
+		_nRecorded++;
+
+		if (_nBuffered[_fill] == _bufferSize && ! handOff())
+		{
+			_nFailed++;
+			continue;
+		}
+
+		EdgeRecord *record = &_buffers[_fill][_nBuffered[_fill]++];
+
+		record->timestampNs = events[i].timestampNs;
+		record->line        = line;
+		record->level       = events[i].level;
+	}
+}
+
+/**
+ * EdgeRecorder::handOff - give the buffer being filled to the writer thread and start filling the next one
+ *
+ * @return bool		false if every other buffer is still waiting to be written
+ */
+bool EdgeRecorder::handOff()
+{
+	bool bHandedOff = false;
+
+	pthread_mutex_lock(&_lock);
+
+	if (_nFull < EDGE_RECORD_BUFFERS - 1)
+	{
+		_nFull++;
+		_fill = (_fill + 1) % EDGE_RECORD_BUFFERS;
+
+		pthread_cond_signal(&_work);
+		bHandedOff = true;
+	}
+
+	pthread_mutex_unlock(&_lock);
+
+	return bHandedOff;
+}
+
+/**
+ * EdgeRecorder::writerThread
+ *
+ * @param void * recorder
+ *
+ * @return void *
+ */
+void * EdgeRecorder::writerThread(void *recorder)
+{
+	static_cast<EdgeRecorder *>(recorder)->writer();
+
+	return NULL;
+}
+
+/**
+ * EdgeRecorder::writer - write the full buffers in the order they filled until the recording is closed
+ *
+ * @return void
+ */
+void EdgeRecorder::writer()
+{
+	rt_thread_enter(RT_THREAD_RECORDER);
+
+	pthread_mutex_lock(&_lock);
+
+	while (true)
+	{
+		while (_nFull == 0 && ! _bStopping)
+		{
+			pthread_cond_wait(&_work, &_lock);
+		}
+
+		if (_nFull == 0)
+		{
+			break;
+		}
+
+		unsigned int buffer = (_fill + EDGE_RECORD_BUFFERS - _nFull) % EDGE_RECORD_BUFFERS;
+
+		pthread_mutex_unlock(&_lock);
+
+		int ret = write_all(_fd, _buffers[buffer], _nBuffered[buffer] * sizeof(EdgeRecord));
+
+		pthread_mutex_lock(&_lock);
+
+		if (ret < 0)
+		{
+			_nFailed   += _nBuffered[buffer];
+			_writeError = ret;
+		}
+
+		_nBuffered[buffer] = 0;
+		_nFull--;
+
+		pthread_cond_broadcast(&_written);
+	}
+
+	pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * EdgeRecorder::flush - write out whatever is buffered, from the thread that records (or once it has stopped)
+ *
+ * @return int	0 or -errno of the last failed write since the last flush (its records are dropped)
+ */
+int EdgeRecorder::flush()
+{
+	int ret;
+
+	if (_fd < 0 || ! _bWriting)
+	{
+		return 0;
+	}
+
+	if (_nBuffered[_fill] > 0)
+	{
+		// Wait for a buffer to hand over if the writer is behind
+		pthread_mutex_lock(&_lock);
+
+		while (_nFull == EDGE_RECORD_BUFFERS - 1)
+		{
+			pthread_cond_wait(&_written, &_lock);
+		}
+
+		pthread_mutex_unlock(&_lock);
+
+		handOff();
+	}
+
+	pthread_mutex_lock(&_lock);
+
+	while (_nFull > 0)
+	{
+		pthread_cond_wait(&_written, &_lock);
+	}
+
+	ret         = _writeError;
+	_writeError = 0;
+
+	pthread_mutex_unlock(&_lock);
+
+	return ret;
+}
+
+/**
+ * EdgeRecorder::close - flush and finish the recording
+ *
+ * @return void
+ */
+void EdgeRecorder::close()
+{
+	if (_bWriting)
+	{
+		flush();
+
+		pthread_mutex_lock(&_lock);
+		_bStopping = true;
+		pthread_cond_signal(&_work);
+		pthread_mutex_unlock(&_lock);
+
+		pthread_join(_thread, NULL);
+		_bWriting = false;
+	}
+
+	if (_fd >= 0)
+	{
+		::close(_fd);
+		_fd = -1;
+	}
+
+	for (unsigned int i = 0; i < EDGE_RECORD_BUFFERS; i++)
+	{
+		delete [] _buffers[i];
+
+		_buffers[i]   = NULL;
+		_nBuffered[i] = 0;
+	}
+
+	_bufferSize = 0;
+	_fill       = 0;
+	_nFull      = 0;
+}
+
+/**
+ * ctor
+ */
+EdgeRecording::EdgeRecording()
+{
+	memset(&_header, 0, sizeof(_header));
+}
+
+/**
+ * EdgeRecording::load - read a whole recording into memory
+ *
+ * @param char * filename
+ *
+ * @return int	0 or -errno (-EINVAL if it isn't a recording we understand)
+ */
+int EdgeRecording::load(const char *filename)
+{
+	int fd, ret;
+
+	_events.clear();
+
+	if ((fd = ::open(filename, O_RDONLY)) < 0)
+	{
+		return -errno;
+	}
+
+	if ((ret = load(fd)) < 0)
+	{
+		_events.clear();
+	}
+
+	::close(fd);
+
+	return ret;
+}
+
+/**
+ * EdgeRecording::load - read a whole recording into memory from an open file
+ *
+ * @param int fd
+ *
+ * @return int	0 or -errno (-EIO if the file ends before the size fstat() gave)
+ */
+int EdgeRecording::load(int fd)
+{
+	struct stat st;
+	size_t      nRecords, i, nBytes, nRead = 0;
+	ssize_t     n;
+
+	if (fstat(fd, &st) < 0)
+	{
+		return -errno;
+	}
+
+	if (read(fd, &_header, sizeof(_header)) != sizeof(_header) || _header.magic != EDGE_RECORD_MAGIC || _header.version != EDGE_RECORD_VERSION || _header.nLines > GPIO_EDGE_MAX_LINES)
+	{
+		return -EINVAL;
+	}
+
+	// A truncated last record (ie. the robot died mid write) is ignored
+	nRecords = (st.st_size - sizeof(_header)) / sizeof(EdgeRecord);
+
+	std::vector<EdgeRecord> records(nRecords);
+
+	nBytes = nRecords * sizeof(EdgeRecord);
+
+	while (nRead < nBytes)
+	{
+		if ((n = read(fd, reinterpret_cast<char *>(&records[0]) + nRead, nBytes - nRead)) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			return -errno;
+		}
+
+		if (n == 0)
+		{
+			// The file shrank since fstat()
+			return -EIO;
+		}
+
+		nRead += n;
+	}
+
+	_events.resize(nRecords);
+
+	for (i = 0; i < nRecords; i++)
+	{
+		if (records[i].line >= _header.nLines)
+		{
+			return -EINVAL;
+		}
+
+		_events[i].timestampNs = records[i].timestampNs;
+		_events[i].gpio        = _header.gpios[records[i].line];
+		_events[i].level       = records[i].level;
+	}
+
+	return 0;
+}
@@ -0,0 +1,116 @@
+/**
+ * edgerecord.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Binary recordings of GPIO edges, so that what the encoders actually did on a run can be replayed (and the decoder
+ * debugged or benchmarked) off the robot.
+ *
+ * A recording is an EdgeRecordHeader (the GPIO #s recorded and their levels when recording started) followed by one
+ * packed EdgeRecord per edge, all in host byte order.
+ *
+ * EdgeRecorder collects edges into buffers allocated when it is opened. A full buffer is handed to a writer thread the
+ * recorder starts and the next one filled meanwhile, so the thread recording never allocates or touches the file
+ * (edges that arrive while every buffer is waiting to be written are dropped and counted as failed). EdgeRecording
+ * loads a whole recording back into memory as GpioEdgeEvents.
+ */
+
+#ifndef _EDGERECORD_H_INCLUDED
+#define _EDGERECORD_H_INCLUDED
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include <atomic>
+#include <vector>
+
+#include "gpioedge.h"
+
+#define EDGE_RECORD_MAGIC   0x45524f4f      // "OORE"
+#define EDGE_RECORD_VERSION 1
+#define EDGE_RECORD_BUFFER  4096            // default records buffered before a write
+#define EDGE_RECORD_BUFFERS 2               // buffers, one filling while the others are written
+
+struct EdgeRecordHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	nLines;
+	uint32_t	gpios[GPIO_EDGE_MAX_LINES];
+	uint8_t		levels[GPIO_EDGE_MAX_LINES];
+};
+
+struct EdgeRecord
+{
+	uint64_t	timestampNs;
+	uint8_t		line;			// index into EdgeRecordHeader.gpios
+	uint8_t		level;
+} __attribute__((packed));
+
+class EdgeRecorder
+{
+	private:
+		int				_fd;
+
+		EdgeRecord *	_buffers[EDGE_RECORD_BUFFERS];
+		unsigned int	_nBuffered[EDGE_RECORD_BUFFERS];
+		unsigned int	_bufferSize;
+		unsigned int	_fill;			// buffer being filled by add()
+		unsigned int	_nFull;			// buffers before it waiting to be written
+
+		unsigned int	_gpios[GPIO_EDGE_MAX_LINES];
+		unsigned int	_nLines;
+
+		unsigned long	_nRecorded;
+		std::atomic<unsigned long> _nFailed;	// records lost to failed writes or with nowhere to go
+		int				_writeError;	// 0 or -errno of the last failed write
+
+		pthread_t		_thread;
+		pthread_mutex_t	_lock;
+		pthread_cond_t	_work;
+		pthread_cond_t	_written;
+		bool			_bWriting;		// the writer thread is running
+		bool			_bStopping;
+
+		bool			handOff();
+		void			writer();
+
+		static void *	writerThread(void *recorder);
+
+	public:
+		EdgeRecorder();
+		~EdgeRecorder();
+
+		int		open(const char *filename, const unsigned int *gpios, const unsigned char *levels, unsigned int nGpios, unsigned int bufferSize = EDGE_RECORD_BUFFER);
+		int		flush();
+		void	close();
+
+		void	add(const GpioEdgeEvent *events, int nEvents);
+
+		bool			isOpen() const			{ return _fd >= 0; }
+		unsigned long	getRecorded() const		{ return _nRecorded; }
+		unsigned long	getFailed() const		{ return _nFailed.load(); }
+};
+
+class EdgeRecording
+{
+	private:
+		EdgeRecordHeader			_header;
+		std::vector<GpioEdgeEvent>	_events;
+
+		int		load(int fd);
+
+	public:
+		EdgeRecording();
+
+		int		load(const char *filename);
+
+		const GpioEdgeEvent *	getEvents() const		{ return _events.empty() ? NULL : &_events[0]; }
+		unsigned long			getCount() const		{ return _events.size(); }
+
+		unsigned int			getLineCount() const	{ return _header.nLines; }
+		const unsigned int *	getGpios() const		{ return _header.gpios; }
+		const unsigned char *	getLevels() const		{ return _header.levels; }
+};
+
+#endif // _EDGERECORD_H_INCLUDED
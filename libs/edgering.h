@@ -0,0 +1,130 @@
+/**
+ * edgering.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * A fixed size ring of timestamped encoder edges, written by one thread (the odometry thread) and read by any number of
+ * others without a lock.
+ *
+ * The writer never waits: once the ring is full the oldest edges are overwritten. Readers copy out the newest edges and
+ * retry if the writer lapped them while they were copying. As in seqlock.h, the writer claims a slot (and fences) before
+ * it stores into it, so a reader that saw any of the new edge's fields also sees the claim and knows to retry.
+ */
+
+#ifndef _EDGERING_H_INCLUDED
+#define _EDGERING_H_INCLUDED
+
+#include <atomic>
+
+struct EdgeSample
+{
+	unsigned long long	timestampNs;	// when the edge happened
+	int					count;			// wheel count after the edge
+	int					delta;			// +1 or -1
+};
+
+template <unsigned int SIZE>
+class EdgeRing
+{
+	static_assert(SIZE >= 2 && (SIZE & (SIZE - 1)) == 0, "EdgeRing size must be a power of 2");
+
+	private:
+		std::atomic<unsigned long long>	_timestampNs[SIZE];
+		std::atomic<int>				_count[SIZE];
+		std::atomic<int>				_delta[SIZE];
+
+		std::atomic<unsigned int>		_head;		// number of edges ever pushed
+		std::atomic<unsigned int>		_claimed;	// number of slots ever claimed, _head + 1 while an edge is being stored
+
+	public:
+		EdgeRing()
+		{
+			clear();
+		}
+
+		/**
+		 * Forget every edge. Not safe while the writer is running.
+		 */
+		void clear()
+		{
+			for (unsigned int i = 0; i < SIZE; i++)
+			{
+				_timestampNs[i].store(0, std::memory_order_relaxed);
+				_count[i].store(0, std::memory_order_relaxed);
+				_delta[i].store(0, std::memory_order_relaxed);
+			}
+
+			_claimed.store(0, std::memory_order_relaxed);
+			_head.store(0, std::memory_order_release);
+		}
+
+		/**
+		 * Add an edge (writer thread only).
+		 */
+		void push(unsigned long long timestampNs, int count, int delta)
+		{
+			unsigned int head = _head.load(std::memory_order_relaxed);
+			unsigned int slot = head & (SIZE - 1);
+
+			_claimed.store(head + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			_timestampNs[slot].store(timestampNs, std::memory_order_relaxed);
+			_count[slot].store(count, std::memory_order_relaxed);
+			_delta[slot].store(delta, std::memory_order_relaxed);
+
+			_head.store(head + 1, std::memory_order_release);
+		}
+
+		/**
+		 * Copy out the newest edges, oldest first.
+		 *
+		 * At most SIZE - 1 edges can be copied, the slot after them may be being written.
+		 *
+		 * @param EdgeSample *	 edges
+		 * @param unsigned int	 max
+		 *
+		 * @return unsigned int	 number of edges copied
+		 */
+		unsigned int getLatest(EdgeSample *edges, unsigned int max) const
+		{
+			unsigned int head, headAfter, first, n, i, slot;
+
+			if (max > SIZE - 1)
+			{
+				max = SIZE - 1;
+			}
+
+			do
+			{
+				head  = _head.load(std::memory_order_acquire);
+				n     = head < max ? head : max;
+				first = head - n;
+
+				for (i = 0; i < n; i++)
+				{
+					slot = (first + i) & (SIZE - 1);
+
+					edges[i].timestampNs = _timestampNs[slot].load(std::memory_order_relaxed);
+					edges[i].count       = _count[slot].load(std::memory_order_relaxed);
+					edges[i].delta       = _delta[slot].load(std::memory_order_relaxed);
+				}
+
+				std::atomic_thread_fence(std::memory_order_acquire);
+				headAfter = _claimed.load(std::memory_order_relaxed);
+			}
+			while (headAfter - first >= SIZE);	// the writer got back around to (or is storing into) the oldest slot we copied
+
+			return n;
+		}
+
+		/**
+		 * @return unsigned int	 number of edges ever pushed
+		 */
+		unsigned int getPushed() const
+		{
+			return _head.load(std::memory_order_acquire);
+		}
+};
+
+#endif // _EDGERING_H_INCLUDED
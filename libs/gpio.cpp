@@ -11,9 +11,18 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
 
 #include "gpio.h"
 #include "sysfslib.h"
+#include "actuator.h"
+#include "sysfsattr.h"
+
+/**
+ * Value attributes for gpio_get_value(), opened on first read.
+ */
+static SysfsIntAttr     gGpioValueAttrs[GPIO_MAX];
+static pthread_mutex_t  gGpioValueLock = PTHREAD_MUTEX_INITIALIZER;
 
 /****************************************************************
  * gpio_export
@@ -25,6 +34,8 @@ int gpio_export(unsigned int gpio)
 
     snprintf(exportPath, sizeof(exportPath), "%d", gpio);
 
+    gpio_invalidate(gpio);
+
     return sysfs_write(GPIO_DIR_PREFIX "/export", exportPath);
 }
 
@@ -38,9 +49,35 @@ int gpio_unexport(unsigned int gpio)
 
     snprintf(exportPath, sizeof(exportPath), "%d", gpio);
 
+    gpio_invalidate(gpio);
+
     return sysfs_write(GPIO_DIR_PREFIX "/unexport", exportPath);
 }
 
+/****************************************************************
+ * gpio_invalidate
+ *
+ * Drop any cached descriptors for the GPIO's attributes, the
+ * gpioN directory is recreated on export.
+ ****************************************************************/
+
+void gpio_invalidate(unsigned int gpio)
+{
+    char gpioDir[64];
+
+    snprintf(gpioDir, sizeof(gpioDir), GPIO_DIR_PREFIX "/gpio%d/", gpio);
+
+    sysfs_invalidate(gpioDir);
+    actuator_invalidate(gpioDir);
+
+    if (gpio < GPIO_MAX)
+    {
+        pthread_mutex_lock(&gGpioValueLock);
+        gGpioValueAttrs[gpio].close();
+        pthread_mutex_unlock(&gGpioValueLock);
+    }
+}
+
 /****************************************************************
  * gpio_set_dir
  ****************************************************************/
@@ -73,11 +110,11 @@ int gpio_set_value(unsigned int gpio, PIN_VALUE value)
 
 	if (value == LOW)
 	{
-	    return sysfs_write(gpioFile, "0");
+	    return actuator_write(gpioFile, "0");
 	}
 	else
 	{
-	    return sysfs_write(gpioFile, "1");
+	    return actuator_write(gpioFile, "1");
 	}
 }
 
@@ -87,26 +124,36 @@ int gpio_set_value(unsigned int gpio, PIN_VALUE value)
 
 int gpio_get_value(unsigned int gpio, unsigned int *value)
 {
-	char ch;
-	char gpioFile[1024];
+	int  level, ret;
 
-	snprintf(gpioFile, sizeof(gpioFile), GPIO_DIR_PREFIX "/gpio%d/value", gpio);
-
-	if ( ! sysfs_read(gpioFile, &ch, 1))
+	if (gpio >= GPIO_MAX)
 	{
-		perror("gpio::get_value");
 		return -1;
 	}
 
-	if (ch != '0')
+	SysfsIntAttr *attr = &gGpioValueAttrs[gpio];
+
+	if ( ! attr->isOpen())
 	{
-		*value = 1;
+		pthread_mutex_lock(&gGpioValueLock);
+
+		ret = attr->isOpen() ? 0 : gpio_value_attr_open(gpio, attr);
+
+		pthread_mutex_unlock(&gGpioValueLock);
+
+		if (ret < 0)
+		{
+			return ret;
+		}
 	}
-	else
+
+	if ((ret = attr->read(&level)) < 0)
 	{
-		*value = 0;
+		return ret;
 	}
 
+	*value = (level != 0);
+
 	return 0;
 }
 
@@ -132,6 +179,9 @@ int gpio_set_edge(unsigned int gpio, INTERRUPT_EDGE edge)
         case EDGE_BOTH:
 			return sysfs_write(gpioFile, "both");
 
+        case EDGE_NONE:
+			return sysfs_write(gpioFile, "none");
+
         default:
             perror("gpio::set_edge");
     }
@@ -152,6 +202,22 @@ int gpio_fd_open(unsigned int gpio, int flags = O_RDONLY | O_NONBLOCK)
 	return sysfs_open_read(gpioFile, flags);
 }
 
+/****************************************************************
+ * gpio_value_attr_open
+ *
+ * Open a GPIO's value file as an integer attribute, the
+ * attribute's descriptor can be polled for edges.
+ ****************************************************************/
+
+int gpio_value_attr_open(unsigned int gpio, SysfsIntAttr *attr)
+{
+    char gpioFile[1024];
+
+    snprintf(gpioFile, sizeof(gpioFile), GPIO_DIR_PREFIX "/gpio%d/value", gpio);
+
+    return attr->open(gpioFile, O_RDONLY);
+}
+
 /****************************************************************
  * gpio_fd_close
  ****************************************************************/
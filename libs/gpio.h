@@ -10,6 +10,9 @@
 #define _GPIO_H_INCLUDED
 
 #define GPIO_DIR_PREFIX     "/sys/class/gpio"
+#define GPIO_MAX            128                 // 4 banks of 32 on the BBB
+
+class SysfsIntAttr;
 
 enum PIN_DIRECTION
 {
@@ -27,16 +30,19 @@ enum INTERRUPT_EDGE
 {
 	EDGE_RISING  = 0,
 	EDGE_FALLING = 1,
-	EDGE_BOTH    = 2
+	EDGE_BOTH    = 2,
+	EDGE_NONE    = 3
 };
 
 int 	gpio_export(unsigned int gpio);
 int 	gpio_unexport(unsigned int gpio);
+void 	gpio_invalidate(unsigned int gpio);
 int 	gpio_set_direction(unsigned int gpio, PIN_DIRECTION outFlag);
 int 	gpio_set_value(unsigned int gpio, PIN_VALUE value);
 int 	gpio_get_value(unsigned int gpio, unsigned int *value);
 int 	gpio_set_edge(unsigned int gpio, INTERRUPT_EDGE edge);
 int 	gpio_fd_open(unsigned int gpio, int flags);
 void 	gpio_fd_close(int fd);
+int 	gpio_value_attr_open(unsigned int gpio, SysfsIntAttr *attr);
 
 #endif // _GPIO_H_INCLUDED
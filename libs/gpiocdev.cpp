@@ -0,0 +1,273 @@
+/**
+ * gpiocdev.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+#include "gpiocdev.h"
+#include "logger.h"
+
+/**
+ * ctor
+ */
+GpioCdevEdgeSource::GpioCdevEdgeSource()
+{
+	_nRequests = 0;
+	_nLines    = 0;
+}
+
+/**
+ * dtor
+ */
+GpioCdevEdgeSource::~GpioCdevEdgeSource()
+{
+	close();
+}
+
+/**
+ * GpioCdevEdgeSource::open - request the lines (as inputs with both edges detected), one request per chip
+ *
+ * @param unsigned int * gpios
+ * @param unsigned int   nGpios
+ *
+ * @return int
+ */
+int GpioCdevEdgeSource::open(const unsigned int *gpios, unsigned int nGpios)
+{
+	unsigned int i, r;
+
+	close();
+
+	if (nGpios > GPIO_EDGE_MAX_LINES)
+	{
+		Logger::getInstance()->error("gpio::GpioCdevEdgeSource::open: too many lines (%u)", nGpios);
+		return -1;
+	}
+
+	// Group the lines by chip
+	for (i = 0; i < nGpios; i++)
+	{
+		unsigned int chip = gpios[i] / GPIO_CDEV_LINES_PER_CHIP;
+
+		for (r = 0; r < _nRequests && _requests[r].chip != chip; r++)
+			;
+
+		if (r == _nRequests)
+		{
+			_requests[r].chip   = chip;
+			_requests[r].fd     = -1;
+			_requests[r].nLines = 0;
+			_nRequests++;
+		}
+
+		_requests[r].offsets[_requests[r].nLines] = gpios[i] % GPIO_CDEV_LINES_PER_CHIP;
+		_requests[r].index[_requests[r].nLines]   = i;
+		_requests[r].nLines++;
+	}
+
+	_nLines = nGpios;
+
+	for (r = 0; r < _nRequests; r++)
+	{
+		struct gpio_v2_line_request req;
+		char                        chipPath[64];
+		int                         chipFd;
+
+		snprintf(chipPath, sizeof(chipPath), "%s%u", GPIO_CDEV_PREFIX, _requests[r].chip);
+
+		if ((chipFd = ::open(chipPath, O_RDWR | O_CLOEXEC)) < 0)
+		{
+			Logger::getInstance()->error("gpio::GpioCdevEdgeSource::open: failed to open %s: %s", chipPath, strerror(errno));
+			close();
+			return -1;
+		}
+
+		memset(&req, 0, sizeof(req));
+
+		for (i = 0; i < _requests[r].nLines; i++)
+		{
+			req.offsets[i] = _requests[r].offsets[i];
+		}
+
+		snprintf(req.consumer, sizeof(req.consumer), "%s", GPIO_CDEV_CONSUMER);
+		req.num_lines         = _requests[r].nLines;
+		req.event_buffer_size = GPIO_CDEV_EVENT_BUFFER;
+		req.config.flags      = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+
+		if (ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &req) < 0)
+		{
+			Logger::getInstance()->error("gpio::GpioCdevEdgeSource::open: line request on %s failed: %s", chipPath, strerror(errno));
+			::close(chipFd);
+			close();
+			return -1;
+		}
+
+		// The line request outlives the chip descriptor
+		::close(chipFd);
+
+		_requests[r].fd = req.fd;
+	}
+
+	return 0;
+}
+
+/**
+ * GpioCdevEdgeSource::close - release the line requests
+ */
+void GpioCdevEdgeSource::close()
+{
+	for (unsigned int r = 0; r < _nRequests; r++)
+	{
+		if (_requests[r].fd >= 0)
+		{
+			::close(_requests[r].fd);
+		}
+	}
+
+	_nRequests = 0;
+	_nLines    = 0;
+}
+
+/**
+ * GpioCdevEdgeSource::getLevels - one ioctl per chip
+ *
+ * @param unsigned char * levels
+ *
+ * @return int
+ */
+int GpioCdevEdgeSource::getLevels(unsigned char *levels)
+{
+	for (unsigned int r = 0; r < _nRequests; r++)
+	{
+		struct gpio_v2_line_values values;
+
+		values.bits = 0;
+		values.mask = (1ULL << _requests[r].nLines) - 1;
+
+		if (ioctl(_requests[r].fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0)
+		{
+			return -errno;
+		}
+
+		for (unsigned int i = 0; i < _requests[r].nLines; i++)
+		{
+			levels[_requests[r].index[i]] = (values.bits >> i) & 1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * GpioCdevEdgeSource::readRequest - drain one line request's queued events
+ *
+ * @param LineRequest *   request
+ * @param GpioEdgeEvent * events
+ * @param unsigned int    maxEvents
+ *
+ * @return int
+ */
+int GpioCdevEdgeSource::readRequest(LineRequest *request, GpioEdgeEvent *events, unsigned int maxEvents)
+{
+	struct gpio_v2_line_event	kernelEvents[GPIO_CDEV_EVENT_BUFFER];
+	unsigned int				toRead = maxEvents < GPIO_CDEV_EVENT_BUFFER ? maxEvents : GPIO_CDEV_EVENT_BUFFER;
+	ssize_t						nRead;
+
+	if ((nRead = ::read(request->fd, kernelEvents, toRead * sizeof(kernelEvents[0]))) < 0)
+	{
+		return errno == EAGAIN ? 0 : -errno;
+	}
+
+	int nEvents = nRead / sizeof(kernelEvents[0]);
+
+	for (int i = 0; i < nEvents; i++)
+	{
+		events[i].timestampNs = kernelEvents[i].timestamp_ns;
+		events[i].gpio        = (request->chip * GPIO_CDEV_LINES_PER_CHIP) + kernelEvents[i].offset;
+		events[i].level       = (kernelEvents[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE);
+	}
+
+	return nEvents;
+}
+
+/**
+ * GpioCdevEdgeSource::read
+ *
+ * Each chip's events are already in time order, when lines span several chips the batches are merged by timestamp.
+ *
+ * @param GpioEdgeEvent * events
+ * @param unsigned int    maxEvents
+ * @param int             timeoutMs
+ *
+ * @return int
+ */
+int GpioCdevEdgeSource::read(GpioEdgeEvent *events, unsigned int maxEvents, int timeoutMs)
+{
+	struct pollfd	fdset[GPIO_EDGE_MAX_LINES + 1];
+	unsigned int	r, nEvents = 0;
+	int				ret;
+
+	for (r = 0; r < _nRequests; r++)
+	{
+		fdset[r].fd      = _requests[r].fd;
+		fdset[r].events  = POLLIN;
+		fdset[r].revents = 0;
+	}
+
+	fdset[_nRequests].fd      = _wakeup.getFd();
+	fdset[_nRequests].events  = POLLIN;
+	fdset[_nRequests].revents = 0;
+
+	if ((ret = poll(fdset, _nRequests + 1, timeoutMs)) <= 0)
+	{
+		return (ret < 0 && errno != EINTR) ? -errno : 0;
+	}
+
+	if (fdset[_nRequests].revents & POLLIN)
+	{
+		_wakeup.clear();
+		return 0;
+	}
+
+	for (r = 0; r < _nRequests && nEvents < maxEvents; r++)
+	{
+		if ( ! (fdset[r].revents & POLLIN))
+		{
+			continue;
+		}
+
+		if ((ret = readRequest(&_requests[r], events + nEvents, maxEvents - nEvents)) < 0)
+		{
+			return ret;
+		}
+
+		// Insertion merge, batches are short and already mostly ordered
+		for (unsigned int i = nEvents; i < nEvents + ret; i++)
+		{
+			GpioEdgeEvent event = events[i];
+			unsigned int  j     = i;
+
+			while (j > 0 && events[j - 1].timestampNs > event.timestampNs)
+			{
+				events[j] = events[j - 1];
+				j--;
+			}
+
+			events[j] = event;
+		}
+
+		nEvents += ret;
+	}
+
+	return nEvents;
+}
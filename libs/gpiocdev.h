@@ -0,0 +1,55 @@
+/**
+ * gpiocdev.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * GPIO character device (v2 uAPI) edge source.
+ *
+ * Lines are requested from /dev/gpiochipN with edge detection on both edges, one line request per chip. The kernel
+ * timestamps each edge and queues it, so a single read() returns a batch of gpio_v2_line_event records carrying the
+ * exact time and line of every edge since the last read.
+ *
+ * BeagleBone GPIO numbers map onto chips as 32 lines per bank, ie. GPIO 66 is line 2 of gpiochip2.
+ */
+
+#ifndef _GPIOCDEV_H_INCLUDED
+#define _GPIOCDEV_H_INCLUDED
+
+#include "gpioedge.h"
+
+#define GPIO_CDEV_PREFIX            "/dev/gpiochip"
+#define GPIO_CDEV_LINES_PER_CHIP    32
+#define GPIO_CDEV_CONSUMER          "oroboto"
+#define GPIO_CDEV_EVENT_BUFFER      64                  // edges the kernel will queue per chip before dropping them
+
+struct gpio_v2_line_event;
+
+class GpioCdevEdgeSource : public GpioEdgeSource
+{
+	private:
+		struct LineRequest
+		{
+			unsigned int	chip;
+			int				fd;						// line request descriptor
+			unsigned int	nLines;
+			unsigned int	offsets[GPIO_EDGE_MAX_LINES];
+			unsigned int	index[GPIO_EDGE_MAX_LINES];	// position of each line in the order passed to open()
+		};
+
+		LineRequest		_requests[GPIO_EDGE_MAX_LINES];
+		unsigned int	_nRequests;
+		unsigned int	_nLines;
+
+		int		readRequest(LineRequest *request, GpioEdgeEvent *events, unsigned int maxEvents);
+
+	public:
+		GpioCdevEdgeSource();
+		~GpioCdevEdgeSource();
+
+		int		open(const unsigned int *gpios, unsigned int nGpios);
+		void	close();
+		int		getLevels(unsigned char *levels);
+		int		read(GpioEdgeEvent *events, unsigned int maxEvents, int timeoutMs);
+};
+
+#endif // _GPIOCDEV_H_INCLUDED
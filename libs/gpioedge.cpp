@@ -0,0 +1,200 @@
+/**
+ * gpioedge.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+
+#include "gpioedge.h"
+#include "gpiocdev.h"
+#include "gpiomock.h"
+#include "gpio.h"
+#include "logger.h"
+
+/**
+ * Create an edge source for a backend.
+ *
+ * @param GPIO_BACKEND backend
+ *
+ * @return GpioEdgeSource *
+ */
+GpioEdgeSource * GpioEdgeSource::create(GPIO_BACKEND backend)
+{
+	switch (backend)
+	{
+		case GPIO_BACKEND_CDEV:
+			return new GpioCdevEdgeSource();
+
+		case GPIO_BACKEND_MOCK:
+			return new GpioMockEdgeSource();
+
+		case GPIO_BACKEND_SYSFS:
+		default:
+			return new GpioSysfsEdgeSource();
+	}
+}
+
+/**
+ * Get the backend named by GPIO_BACKEND_ENV.
+ *
+ * @return GPIO_BACKEND
+ */
+GPIO_BACKEND GpioEdgeSource::getDefaultBackend()
+{
+	const char *backend = getenv(GPIO_BACKEND_ENV);
+
+	if (backend && strcmp(backend, "cdev") == 0)
+	{
+		return GPIO_BACKEND_CDEV;
+	}
+	else if (backend && strcmp(backend, "mock") == 0)
+	{
+		return GPIO_BACKEND_MOCK;
+	}
+
+	return GPIO_BACKEND_SYSFS;
+}
+
+/**
+ * ctor
+ */
+GpioSysfsEdgeSource::GpioSysfsEdgeSource()
+{
+	_levels = 0;
+}
+
+/**
+ * dtor
+ */
+GpioSysfsEdgeSource::~GpioSysfsEdgeSource()
+{
+	close();
+}
+
+/**
+ * GpioSysfsEdgeSource::open - make the lines inputs that interrupt on both edges and open their values
+ *
+ * @param unsigned int * gpios
+ * @param unsigned int   nGpios
+ *
+ * @return int
+ */
+int GpioSysfsEdgeSource::open(const unsigned int *gpios, unsigned int nGpios)
+{
+	if (nGpios > GPIO_EDGE_MAX_LINES || _lines.configure(gpios, nGpios, INPUT_PIN, EDGE_BOTH) < 0)
+	{
+		Logger::getInstance()->error("gpio::GpioSysfsEdgeSource::open: failed to configure %u lines", nGpios);
+		return -1;
+	}
+
+	// This also clears the initial POLLPRI that sysfs reports until a value file has been read
+	return _lines.getLevels(&_levels);
+}
+
+/**
+ * GpioSysfsEdgeSource::close
+ */
+void GpioSysfsEdgeSource::close()
+{
+	_lines.release();
+}
+
+/**
+ * GpioSysfsEdgeSource::getLevels
+ *
+ * @param unsigned char * levels
+ *
+ * @return int
+ */
+int GpioSysfsEdgeSource::getLevels(unsigned char *levels)
+{
+	unsigned int mask;
+	int          ret;
+
+	if ((ret = _lines.getLevels(&mask)) < 0)
+	{
+		return ret;
+	}
+
+	for (unsigned int i = 0; i < _lines.getCount(); i++)
+	{
+		levels[i] = (mask >> i) & 1;
+	}
+
+	return 0;
+}
+
+/**
+ * GpioSysfsEdgeSource::read
+ *
+ * Every line is re-read whenever any of them interrupts, each line whose level differs from what we last saw produces
+ * an event. All events from one wakeup carry the same timestamp.
+ *
+ * @param GpioEdgeEvent * events
+ * @param unsigned int    maxEvents
+ * @param int             timeoutMs
+ *
+ * @return int
+ */
+int GpioSysfsEdgeSource::read(GpioEdgeEvent *events, unsigned int maxEvents, int timeoutMs)
+{
+	struct pollfd		fdset[GPIO_EDGE_MAX_LINES + 1];
+	struct timespec		ts;
+	unsigned int		levels, changed;
+	unsigned int		i, nLines = _lines.getCount(), nEvents = 0;
+	int					ret;
+
+	for (i = 0; i < nLines; i++)
+	{
+		fdset[i].fd      = _lines.getFd(i);
+		fdset[i].events  = POLLPRI;
+		fdset[i].revents = 0;
+	}
+
+	fdset[nLines].fd      = _wakeup.getFd();
+	fdset[nLines].events  = POLLIN;
+	fdset[nLines].revents = 0;
+
+	if ((ret = poll(fdset, nLines + 1, timeoutMs)) <= 0)
+	{
+		return (ret < 0 && errno != EINTR) ? -errno : 0;
+	}
+
+	if (fdset[nLines].revents & POLLIN)
+	{
+		_wakeup.clear();
+		return 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	if ((ret = _lines.getLevels(&levels)) < 0)
+	{
+		return ret;
+	}
+
+	changed = levels ^ _levels;
+
+	for (i = 0; i < nLines && nEvents < maxEvents; i++)
+	{
+		if (changed & (1u << i))
+		{
+			events[nEvents].timestampNs = (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+			events[nEvents].gpio        = _lines.getGpio(i);
+			events[nEvents].level       = (levels >> i) & 1;
+
+			_levels ^= (1u << i);
+			nEvents++;
+		}
+	}
+
+	return nEvents;
+}
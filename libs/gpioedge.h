@@ -0,0 +1,104 @@
+/**
+ * gpioedge.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * A source of timestamped edge events for a set of GPIO input lines (ie. wheel encoder outputs).
+ *
+ * Three backends are available, selected at runtime (see GpioEdgeSource::create()):
+ *
+ * - GPIO_BACKEND_SYSFS  the deprecated /sys/class/gpio interface: polls the value files for POLLPRI and re-reads
+ *                       them to work out which lines changed, timestamps are taken when poll() returns
+ * - GPIO_BACKEND_CDEV   the GPIO character device (v2 uAPI): the kernel timestamps every edge and one read() can
+ *                       deliver a batch of them, see gpiocdev.h
+ * - GPIO_BACKEND_MOCK   replays events handed to it, for running without a board, see gpiomock.h
+ */
+
+#ifndef _GPIOEDGE_H_INCLUDED
+#define _GPIOEDGE_H_INCLUDED
+
+#include "gpiolinegroup.h"
+#include "wakeup.h"
+
+#define GPIO_EDGE_MAX_LINES     8                       // most lines one edge source can watch
+#define GPIO_BACKEND_ENV        "OROBOTO_GPIO_BACKEND"  // "sysfs", "cdev" or "mock", defaults to sysfs
+
+enum GPIO_BACKEND
+{
+	GPIO_BACKEND_SYSFS = 0,
+	GPIO_BACKEND_CDEV  = 1,
+	GPIO_BACKEND_MOCK  = 2
+};
+
+struct GpioEdgeEvent
+{
+	unsigned long long	timestampNs;	// CLOCK_MONOTONIC time of the edge
+	unsigned int		gpio;			// global GPIO number
+	unsigned char		level;			// level of the line after the edge
+};
+
+class GpioEdgeSource
+{
+	protected:
+		Wakeup			_wakeup;		// polled alongside the lines so that wake() can interrupt a read()
+
+	public:
+		virtual ~GpioEdgeSource() {}
+
+		/**
+		 * Configure the lines as inputs that report both rising and falling edges and start watching them.
+		 *
+		 * @return int	0 or < 0 on error
+		 */
+		virtual int		open(const unsigned int *gpios, unsigned int nGpios) = 0;
+		virtual void	close() = 0;
+
+		/**
+		 * Get the current level of each line, in the order they were passed to open().
+		 *
+		 * @return int	0 or < 0 on error
+		 */
+		virtual int		getLevels(unsigned char *levels) = 0;
+
+		/**
+		 * Wait for edges and return as many as are available (oldest first).
+		 *
+		 * Edges that happened at the same instant (ie. the backend could not tell them apart) carry the same timestamp.
+		 *
+		 * @param GpioEdgeEvent * events	buffer for the events
+		 * @param unsigned int    maxEvents	size of events
+		 * @param int             timeoutMs	how long to wait, -1 to wait forever
+		 *
+		 * @return int	number of events returned, 0 on timeout or wake(), < 0 on error
+		 */
+		virtual int		read(GpioEdgeEvent *events, unsigned int maxEvents, int timeoutMs) = 0;
+
+		/**
+		 * Make a read() that is waiting (or the next one) return 0 straight away, from any thread.
+		 */
+		virtual void	wake()		{ _wakeup.signal(); }
+
+		static GpioEdgeSource *	create(GPIO_BACKEND backend);
+		static GPIO_BACKEND		getDefaultBackend();
+};
+
+/**
+ * The /sys/class/gpio backend.
+ */
+class GpioSysfsEdgeSource : public GpioEdgeSource
+{
+	private:
+		GpioLineGroup	_lines;
+		unsigned int	_levels;		// bitmask of the levels as of the last read()
+
+	public:
+		GpioSysfsEdgeSource();
+		~GpioSysfsEdgeSource();
+
+		int		open(const unsigned int *gpios, unsigned int nGpios);
+		void	close();
+		int		getLevels(unsigned char *levels);
+		int		read(GpioEdgeEvent *events, unsigned int maxEvents, int timeoutMs);
+};
+
+#endif // _GPIOEDGE_H_INCLUDED
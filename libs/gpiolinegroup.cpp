@@ -0,0 +1,199 @@
+/**
+ * gpiolinegroup.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "gpiolinegroup.h"
+#include "sysfslib.h"
+#include "logger.h"
+
+/**
+ * ctor
+ */
+GpioLineGroup::GpioLineGroup()
+{
+	_nLines   = 0;
+	_nSkipped = 0;
+	_nWritten = 0;
+}
+
+/**
+ * dtor - leaves the lines exported and configured
+ */
+GpioLineGroup::~GpioLineGroup()
+{
+	release();
+}
+
+/**
+ * GpioLineGroup::configure - export and configure every line, skipping anything that is already set up
+ *
+ * @param unsigned int * gpios
+ * @param unsigned int   nGpios
+ * @param PIN_DIRECTION  direction
+ * @param INTERRUPT_EDGE edge		EDGE_NONE to turn edge detection off (ie. left on by a previous run)
+ *
+ * @return int
+ */
+int GpioLineGroup::configure(const unsigned int *gpios, unsigned int nGpios, PIN_DIRECTION direction, INTERRUPT_EDGE edge)
+{
+	release();
+
+	if (nGpios > GPIO_GROUP_MAX_LINES)
+	{
+		Logger::getInstance()->error("gpio::GpioLineGroup::configure: too many lines (%u)", nGpios);
+		return -1;
+	}
+
+	for (unsigned int i = 0; i < nGpios; i++)
+	{
+		if (configureLine(gpios[i], direction, edge) < 0 || gpio_value_attr_open(gpios[i], &_values[i]) < 0)
+		{
+			Logger::getInstance()->error("gpio::GpioLineGroup::configure: failed to configure GPIO %u", gpios[i]);
+			release();
+			return -1;
+		}
+
+		_gpios[i] = gpios[i];
+		_nLines++;
+	}
+
+	return 0;
+}
+
+/**
+ * GpioLineGroup::configureLine
+ *
+ * @param unsigned int   gpio
+ * @param PIN_DIRECTION  direction
+ * @param INTERRUPT_EDGE edge
+ *
+ * @return int
+ */
+int GpioLineGroup::configureLine(unsigned int gpio, PIN_DIRECTION direction, INTERRUPT_EDGE edge)
+{
+	char        gpioDir[SYSFS_MAX_PATH], path[SYSFS_MAX_PATH * 2];
+	struct stat st;
+	const char *edges[] = { "rising", "falling", "both", "none" };
+
+	snprintf(gpioDir, sizeof(gpioDir), GPIO_DIR_PREFIX "/gpio%d", gpio);
+
+	// Only export if the gpioN directory isn't there already
+	if (sysfs_path(path, sizeof(path), gpioDir) && stat(path, &st) == 0)
+	{
+		_nSkipped++;
+	}
+	else
+	{
+		gpio_export(gpio);
+		_nWritten++;
+	}
+
+	if (setAttribute(gpio, "direction", direction == OUTPUT_PIN ? "out" : "in") < 0)
+	{
+		return -1;
+	}
+
+	if (setAttribute(gpio, "edge", edges[edge]) < 0)
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * GpioLineGroup::setAttribute - write a gpioN attribute if it doesn't already hold value
+ *
+ * @param unsigned int gpio
+ * @param char *       attribute	ie. "direction"
+ * @param char *       value
+ *
+ * @return int
+ */
+int GpioLineGroup::setAttribute(unsigned int gpio, const char *attribute, const char *value)
+{
+	char   filename[SYSFS_MAX_PATH];
+	char   current[16];
+	int    nRead;
+	size_t len = strlen(value);
+
+	snprintf(filename, sizeof(filename), GPIO_DIR_PREFIX "/gpio%d/%s", gpio, attribute);
+
+	if ((nRead = sysfs_read(filename, current, sizeof(current) - 1)) >= static_cast<int>(len) && strncmp(current, value, len) == 0 && (nRead == static_cast<int>(len) || current[len] == '\n'))
+	{
+		_nSkipped++;
+		return 0;
+	}
+
+	_nWritten++;
+
+	return sysfs_write(filename, value);
+}
+
+/**
+ * GpioLineGroup::release - close the group's value files
+ *
+ * @param bool unexport		also unexport the lines
+ */
+void GpioLineGroup::release(bool unexport)
+{
+	for (unsigned int i = 0; i < _nLines; i++)
+	{
+		_values[i].close();
+
+		if (unexport)
+		{
+			gpio_unexport(_gpios[i]);
+		}
+	}
+
+	_nLines = 0;
+}
+
+/**
+ * GpioLineGroup::getLevels - snapshot of every line's level
+ *
+ * @param unsigned int * levels		bit i is set if line i (in configure() order) is high
+ *
+ * @return int						0 or -errno
+ */
+int GpioLineGroup::getLevels(unsigned int *levels)
+{
+	unsigned int mask = 0;
+	int          value, ret;
+
+	for (unsigned int i = 0; i < _nLines; i++)
+	{
+		if ((ret = _values[i].read(&value)) < 0)
+		{
+			return ret;
+		}
+
+		mask |= static_cast<unsigned int>(value != 0) << i;
+	}
+
+	*levels = mask;
+
+	return 0;
+}
+
+/**
+ * GpioLineGroup::getWriteCounts - how many sysfs writes configure() has made and skipped
+ *
+ * @param unsigned int * written
+ * @param unsigned int * skipped
+ */
+void GpioLineGroup::getWriteCounts(unsigned int *written, unsigned int *skipped) const
+{
+	*written = _nWritten;
+	*skipped = _nSkipped;
+}
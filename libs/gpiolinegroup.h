@@ -0,0 +1,52 @@
+/**
+ * gpiolinegroup.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * A set of sysfs GPIO lines that are configured together and read together.
+ *
+ * configure() looks at what is already exported and how each line's direction and edge are already set, and only
+ * writes what differs, so re-running the setup (ie. every time an Odometer is constructed) costs a handful of reads
+ * rather than an export/direction/edge write per line. getLevels() returns the level of every line in the group as a
+ * single bitmask snapshot.
+ */
+
+#ifndef _GPIOLINEGROUP_H_INCLUDED
+#define _GPIOLINEGROUP_H_INCLUDED
+
+#include "gpio.h"
+#include "sysfsattr.h"
+
+#define GPIO_GROUP_MAX_LINES 32                 // levels are returned as a 32 bit mask
+
+class GpioLineGroup
+{
+	private:
+		unsigned int	_gpios[GPIO_GROUP_MAX_LINES];
+		SysfsIntAttr	_values[GPIO_GROUP_MAX_LINES];
+		unsigned int	_nLines;
+
+		// How many sysfs writes configure() skipped / made, for the curious
+		unsigned int	_nSkipped;
+		unsigned int	_nWritten;
+
+		int		configureLine(unsigned int gpio, PIN_DIRECTION direction, INTERRUPT_EDGE edge);
+		int		setAttribute(unsigned int gpio, const char *attribute, const char *value);
+
+	public:
+		GpioLineGroup();
+		~GpioLineGroup();
+
+		int				configure(const unsigned int *gpios, unsigned int nGpios, PIN_DIRECTION direction, INTERRUPT_EDGE edge);
+		void			release(bool unexport = false);
+
+		int				getLevels(unsigned int *levels);
+
+		unsigned int	getCount() const					{ return _nLines; }
+		unsigned int	getGpio(unsigned int line) const	{ return _gpios[line]; }
+		int				getFd(unsigned int line) const		{ return _values[line].getFd(); }
+
+		void			getWriteCounts(unsigned int *written, unsigned int *skipped) const;
+};
+
+#endif // _GPIOLINEGROUP_H_INCLUDED
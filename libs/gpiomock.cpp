@@ -0,0 +1,257 @@
+/**
+ * gpiomock.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "gpiomock.h"
+
+/**
+ * ctor
+ */
+GpioMockEdgeSource::GpioMockEdgeSource()
+{
+	_nLines    = 0;
+	_nextEvent = 0;
+	_bOpen     = false;
+	_bWake     = false;
+
+	pthread_mutex_init(&_lock, NULL);
+	pthread_cond_init(&_changed, NULL);
+}
+
+/**
+ * dtor
+ */
+GpioMockEdgeSource::~GpioMockEdgeSource()
+{
+	close();
+
+	pthread_cond_destroy(&_changed);
+	pthread_mutex_destroy(&_lock);
+}
+
+/**
+ * GpioMockEdgeSource::open - all lines start low unless setLevels() is called
+ *
+ * @param unsigned int * gpios
+ * @param unsigned int   nGpios
+ *
+ * @return int
+ */
+int GpioMockEdgeSource::open(const unsigned int *gpios, unsigned int nGpios)
+{
+	if (nGpios > GPIO_EDGE_MAX_LINES)
+	{
+		return -1;
+	}
+
+	pthread_mutex_lock(&_lock);
+
+	for (unsigned int i = 0; i < nGpios; i++)
+	{
+		_gpios[i]  = gpios[i];
+		_levels[i] = 0;
+	}
+
+	_nLines = nGpios;
+	_bOpen  = true;
+
+	pthread_mutex_unlock(&_lock);
+
+	return 0;
+}
+
+/**
+ * GpioMockEdgeSource::close - discards any undelivered events, a read() that is waiting returns an error
+ */
+void GpioMockEdgeSource::close()
+{
+	pthread_mutex_lock(&_lock);
+
+	_events.clear();
+	_nextEvent = 0;
+	_nLines    = 0;
+	_bOpen     = false;
+
+	pthread_cond_broadcast(&_changed);
+	pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * GpioMockEdgeSource::getLevels - the levels as of the last delivered event
+ *
+ * @param unsigned char * levels
+ *
+ * @return int
+ */
+int GpioMockEdgeSource::getLevels(unsigned char *levels)
+{
+	pthread_mutex_lock(&_lock);
+	memcpy(levels, _levels, _nLines);
+	pthread_mutex_unlock(&_lock);
+
+	return 0;
+}
+
+/**
+ * GpioMockEdgeSource::setLevels - set the current level of every line (in open() order)
+ *
+ * @param unsigned char * levels
+ */
+void GpioMockEdgeSource::setLevels(const unsigned char *levels)
+{
+	pthread_mutex_lock(&_lock);
+	memcpy(_levels, levels, _nLines);
+	pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * GpioMockEdgeSource::wake - the mock waits on a condition rather than file descriptors
+ */
+void GpioMockEdgeSource::wake()
+{
+	pthread_mutex_lock(&_lock);
+
+	_bWake = true;
+
+	pthread_cond_broadcast(&_changed);
+	pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * GpioMockEdgeSource::read
+ *
+ * @param GpioEdgeEvent * events
+ * @param unsigned int    maxEvents
+ * @param int             timeoutMs
+ *
+ * @return int
+ */
+int GpioMockEdgeSource::read(GpioEdgeEvent *events, unsigned int maxEvents, int timeoutMs)
+{
+	struct timespec deadline;
+	unsigned int    nEvents = 0;
+
+	if (timeoutMs > 0)
+	{
+		clock_gettime(CLOCK_REALTIME, &deadline);
+
+		deadline.tv_sec  += timeoutMs / 1000;
+		deadline.tv_nsec += (timeoutMs % 1000) * 1000000L;
+
+		if (deadline.tv_nsec >= 1000000000L)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+	}
+
+	pthread_mutex_lock(&_lock);
+
+	while (_bOpen && ! _bWake && _nextEvent == _events.size() && timeoutMs != 0)
+	{
+		if (timeoutMs < 0)
+		{
+			pthread_cond_wait(&_changed, &_lock);
+		}
+		else if (pthread_cond_timedwait(&_changed, &_lock, &deadline) == ETIMEDOUT)
+		{
+			break;
+		}
+	}
+
+	if ( ! _bOpen)
+	{
+		pthread_mutex_unlock(&_lock);
+		return -EBADF;
+	}
+
+	if (_bWake)
+	{
+		_bWake = false;
+
+		pthread_mutex_unlock(&_lock);
+		return 0;
+	}
+
+	while (nEvents < maxEvents && _nextEvent < _events.size())
+	{
+		const GpioEdgeEvent &event = _events[_nextEvent++];
+
+		for (unsigned int i = 0; i < _nLines; i++)
+		{
+			if (_gpios[i] == event.gpio)
+			{
+				_levels[i] = event.level;
+			}
+		}
+
+		events[nEvents++] = event;
+	}
+
+	if (_nextEvent == _events.size())
+	{
+		_events.clear();
+		_nextEvent = 0;
+	}
+
+	pthread_cond_broadcast(&_changed);
+	pthread_mutex_unlock(&_lock);
+
+	return nEvents;
+}
+
+/**
+ * GpioMockEdgeSource::addEvents - queue events for replay
+ *
+ * @param GpioEdgeEvent * events
+ * @param unsigned int    nEvents
+ */
+void GpioMockEdgeSource::addEvents(const GpioEdgeEvent *events, unsigned int nEvents)
+{
+	pthread_mutex_lock(&_lock);
+
+	_events.insert(_events.end(), events, events + nEvents);
+
+	pthread_cond_broadcast(&_changed);
+	pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * GpioMockEdgeSource::addEvent - queue a single event for replay
+ *
+ * @param unsigned long long timestampNs
+ * @param unsigned int       gpio
+ * @param unsigned char      level
+ */
+void GpioMockEdgeSource::addEvent(unsigned long long timestampNs, unsigned int gpio, unsigned char level)
+{
+	GpioEdgeEvent event;
+
+	event.timestampNs = timestampNs;
+	event.gpio        = gpio;
+	event.level       = level;
+
+	addEvents(&event, 1);
+}
+
+/**
+ * GpioMockEdgeSource::waitDrained - block until every queued event has been read
+ */
+void GpioMockEdgeSource::waitDrained()
+{
+	pthread_mutex_lock(&_lock);
+
+	while (_nextEvent < _events.size())
+	{
+		pthread_cond_wait(&_changed, &_lock);
+	}
+
+	pthread_mutex_unlock(&_lock);
+}
@@ -0,0 +1,51 @@
+/**
+ * gpiomock.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Mock edge source that replays edge events handed to it with addEvents(), so that the odometer and anything else
+ * built on a GpioEdgeSource can be exercised without a board. Events are delivered as fast as they are read, their
+ * timestamps are passed through untouched. Closing the source makes a blocked read() return an error, which is how
+ * a reader (ie. the odometry thread) is made to exit.
+ */
+
+#ifndef _GPIOMOCK_H_INCLUDED
+#define _GPIOMOCK_H_INCLUDED
+
+#include <pthread.h>
+#include <vector>
+
+#include "gpioedge.h"
+
+class GpioMockEdgeSource : public GpioEdgeSource
+{
+	private:
+		unsigned int				_gpios[GPIO_EDGE_MAX_LINES];
+		unsigned char				_levels[GPIO_EDGE_MAX_LINES];
+		unsigned int				_nLines;
+		bool						_bOpen;
+		bool						_bWake;			// wake() was called
+
+		std::vector<GpioEdgeEvent>	_events;		// events waiting to be read
+		size_t						_nextEvent;		// index of the next event to deliver
+
+		pthread_mutex_t				_lock;
+		pthread_cond_t				_changed;		// signalled when events are added or consumed
+
+	public:
+		GpioMockEdgeSource();
+		~GpioMockEdgeSource();
+
+		int		open(const unsigned int *gpios, unsigned int nGpios);
+		void	close();
+		int		getLevels(unsigned char *levels);
+		int		read(GpioEdgeEvent *events, unsigned int maxEvents, int timeoutMs);
+		void	wake();
+
+		void	setLevels(const unsigned char *levels);
+		void	addEvents(const GpioEdgeEvent *events, unsigned int nEvents);
+		void	addEvent(unsigned long long timestampNs, unsigned int gpio, unsigned char level);
+		void	waitDrained();
+};
+
+#endif // _GPIOMOCK_H_INCLUDED
@@ -0,0 +1,126 @@
+/**
+ * latency.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "latency.h"
+#include "logger.h"
+
+/**
+ * ctor
+ */
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+/**
+ * LatencyHistogram::reset - not safe against a concurrent record()
+ *
+ * @return void
+ */
+void LatencyHistogram::reset()
+{
+	for (unsigned int i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		_buckets[i].store(0, std::memory_order_relaxed);
+	}
+
+	_count.store(0, std::memory_order_relaxed);
+	_sumNs.store(0, std::memory_order_relaxed);
+	_minNs.store(~0ULL, std::memory_order_relaxed);
+	_maxNs.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * LatencyHistogram::getBucketLimitNs - the (exclusive) upper limit of a bucket
+ *
+ * @param unsigned int bucket
+ *
+ * @return unsigned long long	ns, ~0 for the last bucket
+ */
+unsigned long long LatencyHistogram::getBucketLimitNs(unsigned int bucket)
+{
+	if (bucket >= LATENCY_BUCKETS - 1)
+	{
+		return ~0ULL;
+	}
+
+	return (1ULL << bucket) * 1000;
+}
+
+/**
+ * LatencyHistogram::getPercentileNs - upper limit of the bucket the percentile falls in
+ *
+ * @param double percentile		0 - 100
+ *
+ * @return unsigned long long	ns, never more than the maximum seen (which is also the answer in the last bucket)
+ */
+unsigned long long LatencyHistogram::getPercentileNs(double percentile) const
+{
+	unsigned long count = getCount(), seen = 0;
+	double        target = count * (percentile / 100.0);
+
+	for (unsigned int i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		seen += getBucket(i);
+
+		if (seen > 0 && seen >= target)
+		{
+			unsigned long long maxNs = getMaxNs();
+
+			return i == LATENCY_BUCKETS - 1 || getBucketLimitNs(i) > maxNs ? maxNs : getBucketLimitNs(i);
+		}
+	}
+
+	return getMaxNs();
+}
+
+/**
+ * LatencyHistogram::log - one line summary followed by the non-empty buckets
+ *
+ * @param Logger * logger
+ * @param char *   name
+ *
+ * @return void
+ */
+void LatencyHistogram::log(Logger *logger, const char *name) const
+{
+	char line[1024];
+	int  len = 0;
+
+	if (getCount() == 0)
+	{
+		logger->notice("%s: no samples", name);
+		return;
+	}
+
+	logger->notice("%s: n %lu min %.1fus mean %.1fus max %.1fus p50 <=%.0fus p99 <=%.0fus", name, getCount(), getMinNs() / 1000.0, getMeanNs() / 1000.0, getMaxNs() / 1000.0, getPercentileNs(50) / 1000.0, getPercentileNs(99) / 1000.0);
+
+	line[0] = '\0';
+
+	for (unsigned int i = 0; i < LATENCY_BUCKETS && len < static_cast<int>(sizeof(line)) - 32; i++)
+	{
+		unsigned long n = getBucket(i);
+
+		if (n == 0)
+		{
+			continue;
+		}
+
+		if (i == LATENCY_BUCKETS - 1)
+		{
+			len += snprintf(line + len, sizeof(line) - len, " >=%lluus:%lu", getBucketLimitNs(i - 1) / 1000, n);
+		}
+		else
+		{
+			len += snprintf(line + len, sizeof(line) - len, " <%lluus:%lu", getBucketLimitNs(i) / 1000, n);
+		}
+	}
+
+	logger->notice("%s:%s", name, line);
+}
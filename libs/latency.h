@@ -0,0 +1,90 @@
+/**
+ * latency.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * A log2 histogram of latencies (ie. how late a thread woke up), cheap enough to record into on every wakeup.
+ *
+ * Bucket 0 counts latencies under 1us, bucket i counts [2^(i-1), 2^i) us and the last bucket everything above. Only
+ * one thread may record() into a histogram, any thread can read it (the counts are atomics, a reader may see a
+ * record() half done, which is fine for reporting).
+ */
+
+#ifndef _LATENCY_H_INCLUDED
+#define _LATENCY_H_INCLUDED
+
+#include <atomic>
+#include <time.h>
+
+#define LATENCY_BUCKETS 32
+
+class Logger;
+
+class LatencyHistogram
+{
+	private:
+		std::atomic<unsigned long>		_buckets[LATENCY_BUCKETS];
+		std::atomic<unsigned long>		_count;
+		std::atomic<unsigned long long>	_sumNs;
+		std::atomic<unsigned long long>	_minNs;
+		std::atomic<unsigned long long>	_maxNs;
+
+	public:
+		LatencyHistogram();
+
+		void	reset();
+
+		/**
+		 * Record a latency (single writer).
+		 *
+		 * @param unsigned long long ns
+		 */
+		inline void record(unsigned long long ns)
+		{
+			unsigned long long us     = ns / 1000;
+			unsigned int       bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+
+			if (bucket >= LATENCY_BUCKETS)
+			{
+				bucket = LATENCY_BUCKETS - 1;
+			}
+
+			_buckets[bucket].store(_buckets[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			_count.store(_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			_sumNs.store(_sumNs.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+
+			if (ns < _minNs.load(std::memory_order_relaxed))
+			{
+				_minNs.store(ns, std::memory_order_relaxed);
+			}
+			if (ns > _maxNs.load(std::memory_order_relaxed))
+			{
+				_maxNs.store(ns, std::memory_order_relaxed);
+			}
+		}
+
+		unsigned long		getCount() const		{ return _count.load(std::memory_order_relaxed); }
+		unsigned long		getBucket(unsigned int bucket) const	{ return bucket < LATENCY_BUCKETS ? _buckets[bucket].load(std::memory_order_relaxed) : 0; }
+		unsigned long long	getMinNs() const		{ return getCount() ? _minNs.load(std::memory_order_relaxed) : 0; }
+		unsigned long long	getMaxNs() const		{ return _maxNs.load(std::memory_order_relaxed); }
+		unsigned long long	getMeanNs() const		{ return getCount() ? _sumNs.load(std::memory_order_relaxed) / getCount() : 0; }
+		unsigned long long	getPercentileNs(double percentile) const;
+
+		void	log(Logger *logger, const char *name) const;
+
+		static unsigned long long getBucketLimitNs(unsigned int bucket);
+
+		/**
+		 * @return unsigned long long	CLOCK_MONOTONIC in nanoseconds
+		 */
+		static inline unsigned long long now()
+		{
+			struct timespec ts;
+
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+
+			return (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+		}
+};
+
+#endif // _LATENCY_H_INCLUDED
@@ -16,7 +16,9 @@
 
 #include "led.h"
 #include "logger.h"
+#include "rtprofile.h"
 #include "sysfslib.h"
+#include "actuator.h"
 
 extern "C" void * gLedPulseThread(void *arg)
 {
@@ -43,7 +45,8 @@ Led::Led(unsigned int nLed)
 		hijack();
 	}
 
-	_bRun = false;
+	_bRun           = false;
+	_bThreadStarted = false;
 }
 
 /**
@@ -51,6 +54,7 @@ Led::Led(unsigned int nLed)
  */
 Led::~Led()
 {
+	stop();
 }
 
 /**
@@ -58,10 +62,34 @@ Led::~Led()
  */
 void Led::run()
 {
-	pthread_t tLed;
+	if (_bRun)
+	{
+		return;
+	}
+
+	// It may have been stopped (but not joined) before
+	stop();
+
+	_bRun = true;
+
+	LOGGER_DEBUG(_logger, "run: creating LED thread ...");
 
-	_logger->debug("run: creating LED thread ...");
-	pthread_create(&tLed, NULL, gLedPulseThread, this);
+	pthread_attr_t attr;
+	rt_thread_attr_init(&attr);
+
+	int ret = pthread_create(&_thread, &attr, gLedPulseThread, this);
+
+	pthread_attr_destroy(&attr);
+
+	if (ret != 0)
+	{
+		_logger->error("run: could not create LED thread");
+
+		_bRun = false;
+		return;
+	}
+
+	_bThreadStarted = true;
 }
 
 /**
@@ -69,9 +97,9 @@ void Led::run()
  */
 void * Led::pulseThread()
 {
-	_bOn = false;
+	rt_thread_enter(RT_THREAD_LED);
 
-	_bRun = true;
+	_bOn = false;
 
 	while (_bRun)
 	{
@@ -86,7 +114,15 @@ void * Led::pulseThread()
 
 		_bOn = !_bOn;
 
-		sleep(1);
+		// Sleep for a second, or until stop() wakes us
+		unsigned long long tSleep = LatencyHistogram::now();
+
+		if (_wakeup.wait(LED_PULSE_PERIOD_USEC) == 0)
+		{
+			unsigned long long late = LatencyHistogram::now() - tSleep;
+
+			_wakeupLatency.record(late > LED_PULSE_PERIOD_USEC * 1000ULL ? late - LED_PULSE_PERIOD_USEC * 1000ULL : 0);
+		}
 	}
 
 	_bRun = false;
@@ -94,11 +130,19 @@ void * Led::pulseThread()
 }
 
 /**
- * Led::stop - stop the pulse thread
+ * Led::stop - stop the pulse thread, returns once it has exited
  */
 void Led::stop()
 {
 	_bRun = false;
+
+	if (_bThreadStarted)
+	{
+		_wakeup.signal();
+		pthread_join(_thread, NULL);
+
+		_bThreadStarted = false;
+	}
 }
 
 /**
@@ -117,7 +161,7 @@ void Led::on()
     char ledFile[256];
 
     snprintf(ledFile, sizeof(ledFile), "%s%d/brightness", LED_FILE_PREFIX, _nLed);
-	sysfs_write(ledFile, "1");
+	actuator_write(ledFile, "1");
 
 	_bOn = true;
 }
@@ -130,7 +174,7 @@ void Led::off()
     char ledFile[256];
 
     snprintf(ledFile, sizeof(ledFile), "%s%d/brightness", LED_FILE_PREFIX, _nLed);
-	sysfs_write(ledFile, "0");
+	actuator_write(ledFile, "0");
 
 	_bOn = false;
 }
@@ -10,6 +10,13 @@
 #define _LED_H_INCLUDED
 
 #define LED_FILE_PREFIX "/sys/class/leds/beaglebone:green:usr"
+#define LED_PULSE_PERIOD_USEC 1000000     // time between pulse thread toggles
+
+#include <atomic>
+#include <pthread.h>
+
+#include "wakeup.h"
+#include "latency.h"
 
 class Logger;
 
@@ -18,9 +25,14 @@ class Led
 	private:
 		unsigned int	_nLed;
 
-		bool			_bRun;      // Should the LED thread exit?
+		std::atomic<bool>	_bRun;      // Should the LED thread exit?
 		bool			_bOn;       // Is the LED currently on?
 
+		pthread_t		_thread;
+		bool			_bThreadStarted;
+		LatencyHistogram	_wakeupLatency;	// how late the thread woke from its sleep
+		Wakeup			_wakeup;    // interrupts the sleep between pulses
+
 		Logger *		_logger;
 
 		void	hijack();
@@ -38,6 +50,8 @@ class Led
 		void    strobe();
 
 		bool    isRunning();
+
+		const LatencyHistogram & getWakeupLatency() const	{ return _wakeupLatency; }
 };
 
 #endif // _LED_H_INCLUDED
@@ -5,18 +5,793 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <exception>
 
 #include "logger.h"
+#include "wakeup.h"
+#include "rtprofile.h"
+
+#define LOGGER_WAIT_US      100000      // the writer thread looks at the ring at least this often
+#define LOGGER_POLL_US      10000       // or this often if it can't wait on its wakeup
+
+enum LoggerLength
+{
+	LOGGER_LENGTH_NONE,
+	LOGGER_LENGTH_HH,
+	LOGGER_LENGTH_H,
+	LOGGER_LENGTH_L,
+	LOGGER_LENGTH_LL,
+	LOGGER_LENGTH_J,
+	LOGGER_LENGTH_Z,
+	LOGGER_LENGTH_T,
+	LOGGER_LENGTH_LONG_DOUBLE
+};
+
+static const char * gLoggerLengths[] = { "", "hh", "h", "l", "ll", "j", "z", "t", "L" };
+
+/**
+ * One printf conversion specification
+ */
+struct LoggerSpec
+{
+	char			flags[8];
+	int				width;				// -1 if not given
+	int				precision;			// -1 if not given
+	bool			bWidthArgument;		// '*', the width is an argument
+	bool			bPrecisionArgument;
+	LoggerLength	length;
+	char			conversion;
+};
+
+union LoggerArgument
+{
+	long long			i;
+	unsigned long long	u;
+	double				d;
+	const void *		p;
+	unsigned int		text;			// offset of a copied string in the record's text
+};
+
+/**
+ * A message waiting to be written. The sequence says whose turn the record is (see Logger::log()).
+ */
+struct LoggerRecord
+{
+	std::atomic<unsigned long>	sequence;
+
+	const char *		format;			// NULL if the caller formatted the message into the text
+	unsigned int		nArguments;
+	unsigned int		message;		// offset of the caller's formatted message in the text
+	unsigned int		used;			// bytes of the text used
+
+	LoggerArgument		arguments[LOGGER_MAX_ARGUMENTS];
+	char				text[LOGGER_TEXT_BYTES];		// the prefix first, then any strings
+};
+
+/**
+ * A prefix with a level of its own
+ */
+struct LoggerOverride
+{
+	char				logPrefix[256];
+	LoggerLevel			level;
+	bool				bEnv;			// set by LOGGER_LEVEL_ENV, which setLevel() doesn't change
+};
+
+static pthread_once_t				gLoggerLevelOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t				gLoggerLevelLock = PTHREAD_MUTEX_INITIALIZER;
+static LoggerLevel					gLoggerLevel = LOGGER_LEVEL_NOTICE;		// for every prefix without an override
+static bool							gLoggerLevelEnv = false;				// gLoggerLevel was set by LOGGER_LEVEL_ENV
+static LoggerOverride				gLoggerOverrides[LOGGER_MAX_OVERRIDES];
+static unsigned int					gLoggerOverrideCount = 0;
+
+// Bumped whenever a level changes, a logger whose resolved level is from an older generation resolves it again
+std::atomic<unsigned int>			Logger::_generation(1);
+
+static const char * gLoggerLevels[] = { "debug", "notice", "error" };
+
+static pthread_once_t				gLoggerOnce = PTHREAD_ONCE_INIT;
+static LoggerRecord *				gLoggerRing = NULL;
+static Wakeup *						gLoggerWakeup = NULL;
+static std::atomic<bool>			gLoggerAsync(false);		// the writer thread is running (not yet started, or stopped)
+static std::atomic<bool>			gLoggerStopping(false);		// the writer thread is to finish
+static pthread_t					gLoggerThread;
+static std::atomic<bool>			gLoggerSynchronous(false);	// write every message as it is logged (see setSynchronous())
+
+static std::atomic<unsigned long>	gLoggerHead(0);				// next record a message claims
+static std::atomic<unsigned long>	gLoggerDropped(0);			// messages there was no room for
+static std::atomic<bool>			gLoggerSleeping(false);		// the writer thread is (about to be) waiting
+
+// Whoever holds the write lock (the writer thread or a flush) writes the records in order
+static pthread_mutex_t				gLoggerWriteLock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long				gLoggerTail = 0;
+static unsigned long				gLoggerDroppedReported = 0;
+
+static std::terminate_handler		gLoggerTerminate = NULL;
+
+/**
+ * @param char *	   p		just after the '%'
+ * @param LoggerSpec * spec
+ *
+ * @return const char *		just after the conversion
+ */
+static const char * logger_parse(const char *p, LoggerSpec *spec)
+{
+	unsigned int nFlags = 0;
+
+	memset(spec, 0, sizeof(LoggerSpec));
+	spec->width     = -1;
+	spec->precision = -1;
+
+	while (*p && strchr("-+ #0'", *p))
+	{
+		if (nFlags < sizeof(spec->flags) - 1)
+		{
+			spec->flags[nFlags++] = *p;
+		}
+
+		p++;
+	}
+
+	if (*p == '*')
+	{
+		spec->bWidthArgument = true;
+		p++;
+	}
+
+	for (; *p >= '0' && *p <= '9'; p++)
+	{
+		spec->width = (spec->width < 0 ? 0 : spec->width * 10) + (*p - '0');
+	}
+
+	if (*p == '.')
+	{
+		spec->precision = 0;
+
+		if (*++p == '*')
+		{
+			spec->bPrecisionArgument = true;
+			p++;
+		}
+
+		for (; *p >= '0' && *p <= '9'; p++)
+		{
+			spec->precision = spec->precision * 10 + (*p - '0');
+		}
+	}
+
+	switch (*p)
+	{
+		case 'h': spec->length = p[1] == 'h' ? LOGGER_LENGTH_HH : LOGGER_LENGTH_H; p += p[1] == 'h' ? 2 : 1; break;
+		case 'l': spec->length = p[1] == 'l' ? LOGGER_LENGTH_LL : LOGGER_LENGTH_L; p += p[1] == 'l' ? 2 : 1; break;
+		case 'j': spec->length = LOGGER_LENGTH_J; p++; break;
+		case 'z': spec->length = LOGGER_LENGTH_Z; p++; break;
+		case 't': spec->length = LOGGER_LENGTH_T; p++; break;
+		case 'L': spec->length = LOGGER_LENGTH_LONG_DOUBLE; p++; break;
+	}
+
+	spec->conversion = *p;
+
+	return *p ? p + 1 : p;
+}
+
+/**
+ * Copy a string into a record's text, truncated if there isn't room
+ *
+ * @param LoggerRecord * record
+ * @param char *		 s
+ *
+ * @return unsigned int	its offset in the text
+ */
+static unsigned int logger_copy(LoggerRecord *record, const char *s)
+{
+	unsigned int offset = record->used;
+	size_t       length = strlen(s ? s : "(null)");
+
+	if (offset >= LOGGER_TEXT_BYTES - 1)
+	{
+		// The last byte is always an empty string
+		return LOGGER_TEXT_BYTES - 1;
+	}
+
+	length = length < LOGGER_TEXT_BYTES - 1 - offset ? length : LOGGER_TEXT_BYTES - 1 - offset;
+
+	memcpy(record->text + offset, s ? s : "(null)", length);
+	record->text[offset + length] = '\0';
+	record->used += length + 1;
+
+	return offset;
+}
+
+/**
+ * Keep a message's arguments to be formatted later
+ *
+ * @param LoggerRecord * record
+ * @param char *		 format
+ * @param va_list		 args
+ *
+ * @return bool		false if the caller has to format the message (a conversion that isn't kept, or too many)
+ */
+static bool logger_capture(LoggerRecord *record, const char *format, va_list args)
+{
+	unsigned int n = 0;
+
+	for (const char *p = format; *p; )
+	{
+		LoggerSpec spec;
+
+		if (*p++ != '%')
+		{
+			continue;
+		}
+
+		p = logger_parse(p, &spec);
+
+		if (spec.conversion == '%')
+		{
+			continue;
+		}
+
+		if (spec.conversion == '\0' || ! strchr("diouxXcsfFeEgGaAp", spec.conversion) || spec.length == LOGGER_LENGTH_LONG_DOUBLE ||
+			(strchr("csp", spec.conversion) && spec.length != LOGGER_LENGTH_NONE) ||
+			n + 1 + spec.bWidthArgument + spec.bPrecisionArgument > LOGGER_MAX_ARGUMENTS)
+		{
+			return false;
+		}
+
+		if (spec.bWidthArgument)
+		{
+			record->arguments[n++].i = va_arg(args, int);
+		}
+
+		if (spec.bPrecisionArgument)
+		{
+			record->arguments[n++].i = va_arg(args, int);
+		}
+
+		LoggerArgument &argument = record->arguments[n++];
+
+		switch (spec.conversion)
+		{
+			case 'd':
+			case 'i':
+				switch (spec.length)
+				{
+					case LOGGER_LENGTH_L:  argument.i = va_arg(args, long); break;
+					case LOGGER_LENGTH_LL: argument.i = va_arg(args, long long); break;
+					case LOGGER_LENGTH_J:  argument.i = va_arg(args, intmax_t); break;
+					case LOGGER_LENGTH_Z:  argument.i = va_arg(args, ssize_t); break;
+					case LOGGER_LENGTH_T:  argument.i = va_arg(args, ptrdiff_t); break;
+					default:               argument.i = va_arg(args, int); break;
+				}
+				break;
+
+			case 'o':
+			case 'u':
+			case 'x':
+			case 'X':
+				switch (spec.length)
+				{
+					case LOGGER_LENGTH_L:  argument.u = va_arg(args, unsigned long); break;
+					case LOGGER_LENGTH_LL: argument.u = va_arg(args, unsigned long long); break;
+					case LOGGER_LENGTH_J:  argument.u = va_arg(args, uintmax_t); break;
+					case LOGGER_LENGTH_Z:  argument.u = va_arg(args, size_t); break;
+					case LOGGER_LENGTH_T:  argument.u = va_arg(args, ptrdiff_t); break;
+					default:               argument.u = va_arg(args, unsigned int); break;
+				}
+				break;
+
+			case 'c':
+				argument.i = va_arg(args, int);
+				break;
+
+			case 's':
+				argument.text = logger_copy(record, va_arg(args, const char *));
+				break;
+
+			case 'p':
+				argument.p = va_arg(args, const void *);
+				break;
+
+			default:
+				argument.d = va_arg(args, double);
+				break;
+		}
+	}
+
+	record->nArguments = n;
+
+	return true;
+}
+
+/**
+ * Format a record into a line
+ *
+ * @param LoggerRecord * record
+ * @param char *		 line
+ * @param size_t		 size	at least 2
+ *
+ * @return size_t	length of the line, ending in a newline
+ */
+static size_t logger_render(const LoggerRecord *record, char *line, size_t size)
+{
+	size_t       length = 0;
+	unsigned int n = 0;
+	int          ret;
+
+	// The prefix is always shorter than a line
+	if (record->text[0] != '\0')
+	{
+		ret    = snprintf(line, size, "%s::", record->text);
+		length = ret > 0 ? ret : 0;
+	}
+
+	if (record->format == NULL)
+	{
+		ret     = snprintf(line + length, size - length, "%s", record->text + record->message);
+		length += ret > 0 ? ret : 0;
+	}
+
+	for (const char *p = record->format, *start; p && *p && length < size - 1; )
+	{
+		LoggerSpec spec;
+		char       conversion[32];
+
+		// Everything up to the next conversion as it is
+		for (start = p; *p && *p != '%'; p++)
+		{
+		}
+
+		ret     = snprintf(line + length, size - length, "%.*s", static_cast<int>(p - start), start);
+		length += ret > 0 ? ret : 0;
+
+		if (*p == '\0' || length >= size - 1)
+		{
+			break;
+		}
+
+		p = logger_parse(p + 1, &spec);
+
+		if (spec.conversion == '%')
+		{
+			ret     = snprintf(line + length, size - length, "%%");
+			length += ret > 0 ? ret : 0;
+			continue;
+		}
+
+		// The same conversion with any '*' filled in
+		int width     = spec.bWidthArgument ? static_cast<int>(record->arguments[n++].i) : spec.width;
+		int precision = spec.bPrecisionArgument ? static_cast<int>(record->arguments[n++].i) : spec.precision;
+		int k         = snprintf(conversion, sizeof(conversion), "%%%s", spec.flags);
+
+		if (width >= 0 || spec.bWidthArgument)
+		{
+			k += snprintf(conversion + k, sizeof(conversion) - k, "%d", width);
+		}
+
+		if (precision >= 0)
+		{
+			k += snprintf(conversion + k, sizeof(conversion) - k, ".%d", precision);
+		}
+
+		snprintf(conversion + k, sizeof(conversion) - k, "%s%c", gLoggerLengths[spec.length], spec.conversion);
+
+		const LoggerArgument &argument = record->arguments[n++];
+
+		switch (spec.conversion)
+		{
+			case 'd':
+			case 'i':
+				switch (spec.length)
+				{
+					case LOGGER_LENGTH_L:  ret = snprintf(line + length, size - length, conversion, static_cast<long>(argument.i)); break;
+					case LOGGER_LENGTH_LL: ret = snprintf(line + length, size - length, conversion, static_cast<long long>(argument.i)); break;
+					case LOGGER_LENGTH_J:  ret = snprintf(line + length, size - length, conversion, static_cast<intmax_t>(argument.i)); break;
+					case LOGGER_LENGTH_Z:  ret = snprintf(line + length, size - length, conversion, static_cast<ssize_t>(argument.i)); break;
+					case LOGGER_LENGTH_T:  ret = snprintf(line + length, size - length, conversion, static_cast<ptrdiff_t>(argument.i)); break;
+					default:               ret = snprintf(line + length, size - length, conversion, static_cast<int>(argument.i)); break;
+				}
+				break;
+
+			case 'o':
+			case 'u':
+			case 'x':
+			case 'X':
+				switch (spec.length)
+				{
+					case LOGGER_LENGTH_L:  ret = snprintf(line + length, size - length, conversion, static_cast<unsigned long>(argument.u)); break;
+					case LOGGER_LENGTH_LL: ret = snprintf(line + length, size - length, conversion, static_cast<unsigned long long>(argument.u)); break;
+					case LOGGER_LENGTH_J:  ret = snprintf(line + length, size - length, conversion, static_cast<uintmax_t>(argument.u)); break;
+					case LOGGER_LENGTH_Z:  ret = snprintf(line + length, size - length, conversion, static_cast<size_t>(argument.u)); break;
+					case LOGGER_LENGTH_T:  ret = snprintf(line + length, size - length, conversion, static_cast<ptrdiff_t>(argument.u)); break;
+					default:               ret = snprintf(line + length, size - length, conversion, static_cast<unsigned int>(argument.u)); break;
+				}
+				break;
+
+			case 'c':
+				ret = snprintf(line + length, size - length, conversion, static_cast<int>(argument.i));
+				break;
+
+			case 's':
+				ret = snprintf(line + length, size - length, conversion, record->text + argument.text);
+				break;
+
+			case 'p':
+				ret = snprintf(line + length, size - length, conversion, argument.p);
+				break;
+
+			default:
+				ret = snprintf(line + length, size - length, conversion, argument.d);
+				break;
+		}
+
+		length += ret > 0 ? ret : 0;
+	}
+
+	length = length < size - 1 ? length : size - 2;
+	line[length++] = '\n';
+
+	return length;
+}
+
+/**
+ * Write every record that is ready, in order, and how many messages have been dropped since last time, with the write
+ * lock held
+ *
+ * @return unsigned int	the number of records written
+ */
+static unsigned int logger_drain_locked()
+{
+	char         line[LOGGER_LINE_BYTES];
+	unsigned int n = 0;
+
+	while (true)
+	{
+		LoggerRecord *record = &gLoggerRing[gLoggerTail % LOGGER_RING_RECORDS];
+
+		if (record->sequence.load(std::memory_order_acquire) != gLoggerTail + 1)
+		{
+			// Empty, or the next message is still being captured
+			break;
+		}
+
+		fwrite(line, 1, logger_render(record, line, sizeof(line)), stderr);
+
+		// Free for the message that claims it next time round the ring
+		record->sequence.store(gLoggerTail + LOGGER_RING_RECORDS, std::memory_order_release);
+
+		gLoggerTail++;
+		n++;
+	}
+
+	unsigned long dropped = gLoggerDropped.load();
+
+	if (dropped != gLoggerDroppedReported)
+	{
+		fprintf(stderr, "Logger::%lu messages dropped, the ring was full\n", dropped - gLoggerDroppedReported);
+		gLoggerDroppedReported = dropped;
+	}
+
+	return n;
+}
+
+/**
+ * @see logger_drain_locked()
+ *
+ * @return unsigned int	the number of records written
+ */
+static unsigned int logger_drain()
+{
+	pthread_mutex_lock(&gLoggerWriteLock);
+
+	unsigned int n = logger_drain_locked();
+
+	pthread_mutex_unlock(&gLoggerWriteLock);
+
+	return n;
+}
+
+/**
+ * Write a message straight to stderr, after everything on the ring that is ready to be written
+ *
+ * @param char *  prefix
+ * @param char *  format
+ * @param va_list args
+ *
+ * @return void
+ */
+static void logger_write(const char *prefix, const char *format, va_list args)
+{
+	char line[LOGGER_LINE_BYTES];
+	int  length = 0;
+
+	if (*prefix)
+	{
+		length = snprintf(line, sizeof(line) - 1, "%s::", prefix);
+		length = length < static_cast<int>(sizeof(line)) - 1 ? length : sizeof(line) - 2;
+	}
+
+	int ret = vsnprintf(line + length, sizeof(line) - 1 - length, format, args);
+
+	length += ret > 0 ? ret : 0;
+	length  = length < static_cast<int>(sizeof(line)) - 1 ? length : sizeof(line) - 2;
+	line[length++] = '\n';
+
+	pthread_mutex_lock(&gLoggerWriteLock);
+
+	logger_drain_locked();
+	fwrite(line, 1, length, stderr);
+	fflush(stderr);
+
+	pthread_mutex_unlock(&gLoggerWriteLock);
+}
+
+/**
+ * @return bool		the next record is ready to be written
+ */
+static bool logger_ready()
+{
+	pthread_mutex_lock(&gLoggerWriteLock);
+
+	bool bReady = gLoggerRing[gLoggerTail % LOGGER_RING_RECORDS].sequence.load(std::memory_order_acquire) == gLoggerTail + 1;
+
+	pthread_mutex_unlock(&gLoggerWriteLock);
+
+	return bReady;
+}
+
+/**
+ * The writer thread, sleeps until there is something to write
+ *
+ * @param void * arg
+ *
+ * @return void *
+ */
+static void * logger_thread(void *arg)
+{
+	rt_thread_enter(RT_THREAD_LOGGER);
+
+	while ( ! gLoggerStopping.load())
+	{
+		if (logger_drain() > 0)
+		{
+			continue;
+		}
+
+		// A message is either seen here or its writer sees that we are sleeping and wakes us
+		gLoggerSleeping.store(true);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if ( ! logger_ready() && gLoggerWakeup->wait(LOGGER_WAIT_US) < 0)
+		{
+			usleep(LOGGER_POLL_US);
+		}
+
+		gLoggerSleeping.store(false);
+	}
+
+	return NULL;
+}
+
+/**
+ * Stop the writer thread (and wait for it to finish writing), every message after this is written as it is logged
+ */
+static void logger_stop()
+{
+	if ( ! gLoggerAsync.exchange(false))
+	{
+		return;
+	}
+
+	gLoggerStopping.store(true);
+	gLoggerWakeup->signal();
+
+	if ( ! pthread_equal(pthread_self(), gLoggerThread))
+	{
+		pthread_join(gLoggerThread, NULL);
+	}
+}
+
+/**
+ * Write everything that is left when the program exits
+ */
+static void logger_exit()
+{
+	logger_stop();
+	Logger::flush();
+}
+
+/**
+ * Write everything that is left before the program terminates on an exception, once the writer thread isn't holding
+ * the write lock
+ */
+static void logger_terminate()
+{
+	logger_stop();
+	Logger::flush();
+
+	if (gLoggerTerminate)
+	{
+		gLoggerTerminate();
+	}
+
+	abort();
+}
+
+/**
+ * Set up the ring and start the writer thread, once, on the first message
+ */
+static void logger_start()
+{
+	pthread_attr_t     attr;
+	struct sched_param param;
+
+	gLoggerRing   = new LoggerRecord[LOGGER_RING_RECORDS];
+	gLoggerWakeup = new Wakeup();
+
+	for (unsigned long i = 0; i < LOGGER_RING_RECORDS; i++)
+	{
+		gLoggerRing[i].sequence.store(i);
+	}
+
+	gLoggerTerminate = std::set_terminate(logger_terminate);
+	atexit(logger_exit);
+
+	// Whichever thread logs first, the writer never runs at (or inherits) a real-time priority
+	memset(&param, 0, sizeof(param));
+
+	rt_thread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	pthread_attr_setschedparam(&attr, &param);
+
+	if (pthread_create(&gLoggerThread, &attr, logger_thread, NULL) == 0)
+	{
+		gLoggerAsync.store(true);
+	}
+	else
+	{
+		fprintf(stderr, "Logger::start: could not create writer thread, writing every message as it is logged\n");
+	}
+
+	pthread_attr_destroy(&attr);
+}
+
+/**
+ * @param char *		name
+ * @param LoggerLevel * level
+ *
+ * @return int	0 on success, -EINVAL if name isn't a level
+ */
+static int logger_level_parse(const char *name, LoggerLevel *level)
+{
+	for (unsigned int i = 0; i < sizeof(gLoggerLevels) / sizeof(gLoggerLevels[0]); i++)
+	{
+		if (strcasecmp(name, gLoggerLevels[i]) == 0)
+		{
+			*level = static_cast<LoggerLevel>(i);
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+/**
+ * Set a prefix's level, with gLoggerLevelLock held
+ *
+ * @param char *	  logPrefix
+ * @param LoggerLevel level
+ * @param bool		  bEnv		set by LOGGER_LEVEL_ENV
+ *
+ * @return int	0 on success, -ENOSPC if there are already LOGGER_MAX_OVERRIDES prefixes with their own level
+ */
+static int logger_level_override(const char *logPrefix, LoggerLevel level, bool bEnv)
+{
+	LoggerOverride *entry = NULL;
+
+	for (unsigned int i = 0; i < gLoggerOverrideCount && ! entry; i++)
+	{
+		if (strcmp(gLoggerOverrides[i].logPrefix, logPrefix) == 0)
+		{
+			entry = &gLoggerOverrides[i];
+		}
+	}
+
+	if (entry && entry->bEnv && ! bEnv)
+	{
+		return 0;
+	}
+
+	if ( ! entry)
+	{
+		if (gLoggerOverrideCount >= LOGGER_MAX_OVERRIDES)
+		{
+			return -ENOSPC;
+		}
+
+		entry = &gLoggerOverrides[gLoggerOverrideCount++];
+		snprintf(entry->logPrefix, sizeof(entry->logPrefix), "%s", logPrefix);
+	}
+
+	entry->level = level;
+	entry->bEnv  = bEnv;
+
+	Logger::_generation++;
+
+	return 0;
+}
+
+/**
+ * Apply LOGGER_LEVEL_ENV, once, before any level is looked at or set: a comma separated list of a level for every
+ * prefix and/or prefix=level
+ */
+static void logger_level_env()
+{
+	const char *env = getenv(LOGGER_LEVEL_ENV);
+	char        list[1024];
+	char *      save = NULL;
+
+	if ( ! env)
+	{
+		return;
+	}
+
+	snprintf(list, sizeof(list), "%s", env);
+
+	pthread_mutex_lock(&gLoggerLevelLock);
+
+	for (char *item = strtok_r(list, ",", &save); item; item = strtok_r(NULL, ",", &save))
+	{
+		char *      equals = strrchr(item, '=');
+		LoggerLevel level;
+		int         ret;
+
+		if ((ret = logger_level_parse(equals ? equals + 1 : item, &level)) == 0)
+		{
+			if (equals)
+			{
+				*equals = '\0';
+				ret     = logger_level_override(item, level, true);
+			}
+			else
+			{
+				gLoggerLevel    = level;
+				gLoggerLevelEnv = true;
+				Logger::_generation++;
+			}
+		}
+
+		if (ret < 0)
+		{
+			fprintf(stderr, "Logger::level: ignoring [%s] in %s (%s)\n", item, LOGGER_LEVEL_ENV, strerror(-ret));
+		}
+	}
+
+	pthread_mutex_unlock(&gLoggerLevelLock);
+}
 
 /**
  * @param char * logPrefix
  */
-Logger::Logger(const char *logPrefix)
+Logger::Logger(const char *logPrefix) : _level(0)
 {
 	if (strlen(logPrefix) > 255)
 	{
+		flush();
 		fprintf(stderr, "Logger::ctor: logPrefix [%s] is too long!", logPrefix);
 		throw;
 	}
@@ -41,6 +816,210 @@ Logger * Logger::getInstance()
 	return _singleton;
 }
 
+/**
+ * Logger::setQuiet - log only errors (ie. while running many simulations), or go back to the default level
+ *
+ * @param bool bQuiet	true to drop debug and notice messages from every logger without a level of its own
+ *
+ * @return void
+ */
+void Logger::setQuiet(bool bQuiet)
+{
+	setLevel(bQuiet ? LOGGER_LEVEL_ERROR : LOGGER_LEVEL_NOTICE);
+}
+
+/**
+ * Logger::setLevel - the level of every logger without a level of its own, unless LOGGER_LEVEL_ENV sets it
+ *
+ * @param LoggerLevel level
+ *
+ * @return void
+ */
+void Logger::setLevel(LoggerLevel level)
+{
+	pthread_once(&gLoggerLevelOnce, logger_level_env);
+	pthread_mutex_lock(&gLoggerLevelLock);
+
+	if ( ! gLoggerLevelEnv)
+	{
+		gLoggerLevel = level;
+		Logger::_generation++;
+	}
+
+	pthread_mutex_unlock(&gLoggerLevelLock);
+}
+
+/**
+ * Logger::setLevel - the level of every logger with this prefix, unless LOGGER_LEVEL_ENV sets it
+ *
+ * @param char *	  logPrefix
+ * @param LoggerLevel level
+ *
+ * @return int	0 on success, -ENOSPC if there are already LOGGER_MAX_OVERRIDES prefixes with their own level
+ */
+int Logger::setLevel(const char *logPrefix, LoggerLevel level)
+{
+	int ret;
+
+	pthread_once(&gLoggerLevelOnce, logger_level_env);
+	pthread_mutex_lock(&gLoggerLevelLock);
+
+	ret = logger_level_override(logPrefix, level, false);
+
+	pthread_mutex_unlock(&gLoggerLevelLock);
+
+	return ret;
+}
+
+/**
+ * Logger::resolveLevel - look this logger's level up again, after a level has been changed (see getLevel())
+ *
+ * @return LoggerLevel
+ */
+LoggerLevel Logger::resolveLevel()
+{
+	pthread_once(&gLoggerLevelOnce, logger_level_env);
+	pthread_mutex_lock(&gLoggerLevelLock);
+
+	LoggerLevel level = gLoggerLevel;
+
+	for (unsigned int i = 0; i < gLoggerOverrideCount; i++)
+	{
+		if (strcmp(gLoggerOverrides[i].logPrefix, _logPrefix) == 0)
+		{
+			level = gLoggerOverrides[i].level;
+			break;
+		}
+	}
+
+	_level.store(((_generation.load() & (~0U >> 2)) << 2) | level, std::memory_order_relaxed);
+
+	pthread_mutex_unlock(&gLoggerLevelLock);
+
+	return level;
+}
+
+/**
+ * Logger::setSynchronous - set before any threads that log are started
+ *
+ * @param bool bSynchronous	true to write every message before returning from logging it, nothing is dropped (ie.
+ *							for simulations, where the controller logs much faster than a terminal can keep up)
+ *
+ * @return void
+ */
+void Logger::setSynchronous(bool bSynchronous)
+{
+	gLoggerSynchronous = bSynchronous;
+}
+
+/**
+ * Logger::flush - write every message logged so far (that has been completely captured) before returning
+ *
+ * @return void
+ */
+void Logger::flush()
+{
+	if (gLoggerRing == NULL)
+	{
+		return;
+	}
+
+	logger_drain();
+	fflush(stderr);
+}
+
+/**
+ * Logger::getDroppedCount
+ *
+ * @return unsigned long	messages dropped so far because the ring was full
+ */
+unsigned long Logger::getDroppedCount()
+{
+	return gLoggerDropped.load();
+}
+
+/**
+ * Logger::log - claim the next record on the ring and capture a message into it, without waiting on anything
+ *
+ * The ring is a bounded multi-producer queue: each record's sequence is its position on the ring when it is free to be
+ * claimed, position + 1 once its message is ready to be written.
+ *
+ * @param char *  format
+ * @param va_list args
+ *
+ * @return void
+ */
+void Logger::log(const char *format, va_list args)
+{
+	pthread_once(&gLoggerOnce, logger_start);
+
+	unsigned long head = gLoggerHead.load(std::memory_order_relaxed);
+	LoggerRecord *record;
+
+	while (true)
+	{
+		record = &gLoggerRing[head % LOGGER_RING_RECORDS];
+
+		long diff = static_cast<long>(record->sequence.load(std::memory_order_acquire) - head);
+
+		if (diff == 0)
+		{
+			if (gLoggerHead.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (diff < 0)
+		{
+			// Still holding a message from last time round, the ring is full
+			gLoggerDropped++;
+			return;
+		}
+		else
+		{
+			head = gLoggerHead.load(std::memory_order_relaxed);
+		}
+	}
+
+	va_list captured;
+
+	record->format     = format;
+	record->nArguments = 0;
+	record->used       = 0;
+	record->message    = 0;
+
+	logger_copy(record, _logPrefix);
+
+	va_copy(captured, args);
+
+	if ( ! logger_capture(record, format, captured))
+	{
+		// Formatted here, after the prefix
+		record->format  = NULL;
+		record->message = record->used < LOGGER_TEXT_BYTES ? record->used : LOGGER_TEXT_BYTES - 1;
+
+		vsnprintf(record->text + record->message, LOGGER_TEXT_BYTES - record->message, format, args);
+	}
+
+	va_end(captured);
+
+	record->sequence.store(head + 1, std::memory_order_release);
+
+	// A writer thread that is stopping may already have looked at the ring for the last time
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if ( ! gLoggerAsync.load() || gLoggerSynchronous.load())
+	{
+		flush();
+		return;
+	}
+
+	if (gLoggerSleeping.load())
+	{
+		gLoggerWakeup->signal();
+	}
+}
+
 /**
  * @param char * format
  * @param ...
@@ -49,16 +1028,14 @@ Logger * Logger::getInstance()
  */
 void Logger::debug(const char *format, ...)
 {
-	va_list args;
-	va_start(args, format);
-
-	if (strcmp(_logPrefix, "") != 0)
+	if ( ! isEnabled(LOGGER_LEVEL_DEBUG))
 	{
-		fprintf(stderr, "%s::", _logPrefix);
+		return;
 	}
 
-	vfprintf(stderr, format, args);
-	fprintf(stderr, "\n");
+	va_list args;
+	va_start(args, format);
+	log(format, args);
 	va_end(args);
 }
 
@@ -70,20 +1047,20 @@ void Logger::debug(const char *format, ...)
  */
 void Logger::notice(const char *format, ...)
 {
-	va_list args;
-	va_start(args, format);
-
-	if (strcmp(_logPrefix, "") != 0)
+	if ( ! isEnabled(LOGGER_LEVEL_NOTICE))
 	{
-		fprintf(stderr, "%s::", _logPrefix);
+		return;
 	}
 
-	vfprintf(stderr, format, args);
-	fprintf(stderr, "\n");
+	va_list args;
+	va_start(args, format);
+	log(format, args);
 	va_end(args);
 }
 
 /**
+ * Logger::error - written (after everything on the ring that is ready) by the time this returns, never dropped
+ *
  * @param char * format
  * @param ...
  *
@@ -91,15 +1068,10 @@ void Logger::notice(const char *format, ...)
  */
 void Logger::error(const char *format, ...)
 {
+	pthread_once(&gLoggerOnce, logger_start);
+
 	va_list args;
 	va_start(args, format);
-
-	if (strcmp(_logPrefix, "") != 0)
-	{
-		fprintf(stderr, "%s::", _logPrefix);
-	}
-
-	vfprintf(stderr, format, args);
-	fprintf(stderr, "\n");
+	logger_write(_logPrefix, format, args);
 	va_end(args);
 }
@@ -4,24 +4,118 @@
  * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
  *
  * Simple logging package.
+ *
+ * Logging never waits on the terminal (or serial console): a message is captured as its format string and arguments
+ * (strings are copied) into a record on a lock-free ring shared by every thread, and a background thread started by the
+ * first message formats and writes the records in order. Messages the ring has no room for are dropped and counted,
+ * the count is logged once there is room again. setSynchronous() writes every message as it is logged instead, for
+ * simulations that log faster than any terminal.
+ *
+ * The format string is kept rather than copied, so it must be a string literal (or otherwise outlive the message).
+ *
+ * Errors never go on the ring: error() writes everything on it that is ready and then the error itself before it
+ * returns, as the caller may be about to give up (a message another thread is still capturing is written after it).
+ * flush() writes everything that is ready at any time. At exit, and when the program terminates on an exception, the writer thread is stopped before everything left
+ * is written.
+ *
+ * Messages below a logger's level are dropped before anything is captured. The level is notice unless setLevel() says
+ * otherwise, for every logger or just those with a given prefix (ie. "Odometer"), and LOGGER_LEVEL_ENV overrides both,
+ * ie. OROBOTO_LOG=notice,Odometer=debug. Errors are always logged.
+ *
+ * LOGGER_DEBUG() and LOGGER_NOTICE() only evaluate their arguments (and only call the logger) when the level is
+ * enabled, and compile to nothing below LOGGER_MIN_LEVEL, so use them anywhere that runs often (ie. per odometer edge).
  */
 
 #ifndef _LOGGER_H_INCLUDED
 #define _LOGGER_H_INCLUDED
 
+#include <stdarg.h>
+
+#include <atomic>
+
+#define LOGGER_RING_RECORDS     512     // messages that can wait to be written, a power of two
+#define LOGGER_MAX_ARGUMENTS    12      // a message with more is formatted by the caller
+#define LOGGER_TEXT_BYTES       256     // per message for the prefix and any string arguments (truncated beyond)
+#define LOGGER_LINE_BYTES       1024    // longest line written (truncated beyond)
+#define LOGGER_MAX_OVERRIDES    16      // prefixes with a level of their own
+#define LOGGER_LEVEL_ENV        "OROBOTO_LOG"       // ie. "debug" or "notice,Odometer=debug,Controller=error"
+
+// A LoggerLevel, LOGGER_DEBUG() and LOGGER_NOTICE() below it are compiled out. Set in common.mk rather than per
+// Makefile: every demo compiles the same ../libs and ../modules objects, so all of them have to agree on it.
+#ifndef LOGGER_MIN_LEVEL
+#define LOGGER_MIN_LEVEL        0
+#endif
+
+enum LoggerLevel
+{
+	LOGGER_LEVEL_DEBUG  = 0,
+	LOGGER_LEVEL_NOTICE = 1,
+	LOGGER_LEVEL_ERROR  = 2
+};
+
 class Logger
 {
 	private:
 		char 			_logPrefix[256];
+		std::atomic<unsigned int> _level;		// resolved level and the generation of the levels it was resolved from
+
+		void			log(const char *format, va_list args);
+		LoggerLevel		resolveLevel();
+
+		/**
+		 * @return LoggerLevel	this logger's level, only looked up again after a level has been changed
+		 */
+		LoggerLevel		getLevel()
+		{
+			unsigned int resolved = _level.load(std::memory_order_relaxed);
+
+			if ((resolved >> 2) == (_generation.load(std::memory_order_relaxed) & (~0U >> 2)))
+			{
+				return static_cast<LoggerLevel>(resolved & 3);
+			}
+
+			return resolveLevel();
+		}
 
 	public:
+		static std::atomic<unsigned int> _generation;	// bumped whenever a level is changed (by the logger package)
+
 		Logger(const char *logPrefix);
 
 		static Logger *	getInstance();
+		static void		setQuiet(bool bQuiet);
+		static void		setLevel(LoggerLevel level);
+		static int		setLevel(const char *logPrefix, LoggerLevel level);
+		static void		setSynchronous(bool bSynchronous);
+
+		static void		flush();
+		static unsigned long getDroppedCount();
+
+		/**
+		 * @param LoggerLevel level
+		 *
+		 * @return bool		a message at this level would be logged, to skip working out its arguments if not
+		 */
+		bool			isEnabled(LoggerLevel level)
+		{
+			return level >= LOGGER_MIN_LEVEL && (level >= LOGGER_LEVEL_ERROR || level >= getLevel());
+		}
 
-		void 			debug(const char *format, ...);
-		void 			notice(const char *format, ...);
-		void 			error(const char *format, ...);
+		void 			debug(const char *format, ...) __attribute__((format(printf, 2, 3)));
+		void 			notice(const char *format, ...) __attribute__((format(printf, 2, 3)));
+		void 			error(const char *format, ...) __attribute__((format(printf, 2, 3)));
 };
 
+#if LOGGER_MIN_LEVEL > 0
+#define LOGGER_DEBUG(logger, ...)   do { } while (0)
+#else
+#define LOGGER_DEBUG(logger, ...)   do { if ((logger)->isEnabled(LOGGER_LEVEL_DEBUG)) (logger)->debug(__VA_ARGS__); } while (0)
+#endif
+
+#if LOGGER_MIN_LEVEL > 1
+#define LOGGER_NOTICE(logger, ...)  do { } while (0)
+#else
+#define LOGGER_NOTICE(logger, ...)  do { if ((logger)->isEnabled(LOGGER_LEVEL_NOTICE)) (logger)->notice(__VA_ARGS__); } while (0)
+#endif
+
 #endif // _LOGGER_H_INCLUDED
@@ -0,0 +1,125 @@
+/**
+ * looptimer.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+
+#include "looptimer.h"
+#include "logger.h"
+
+/**
+ * ctor
+ *
+ * @param unsigned int rateHz	iterations per second (clamped to 1 - LOOPTIMER_RATE_MAX)
+ */
+LoopTimer::LoopTimer(unsigned int rateHz)
+{
+	_periodNs = 0;
+
+	if (setRate(rateHz) < 0)
+	{
+		setRate(rateHz == 0 ? 1 : LOOPTIMER_RATE_MAX);
+	}
+
+	start();
+}
+
+/**
+ * LoopTimer::setRate - takes effect from the next deadline
+ *
+ * @param unsigned int rateHz
+ *
+ * @return int	0 on success, -EINVAL if the rate is out of range (the rate is unchanged)
+ */
+int LoopTimer::setRate(unsigned int rateHz)
+{
+	if (rateHz == 0 || rateHz > LOOPTIMER_RATE_MAX)
+	{
+		return -EINVAL;
+	}
+
+	_periodNs = 1000000000ULL / rateHz;
+
+	return 0;
+}
+
+/**
+ * LoopTimer::start - the first iteration starts now, clears the statistics
+ *
+ * @return void
+ */
+void LoopTimer::start()
+{
+	_deadlineNs = _startNs = LatencyHistogram::now();
+	_iterations = 0;
+	_overruns   = 0;
+
+	_period.reset();
+	_jitter.reset();
+}
+
+/**
+ * LoopTimer::wait - sleep until the next iteration is due
+ *
+ * @return unsigned long long	ns since the previous iteration started (the loop's dt)
+ */
+unsigned long long LoopTimer::wait()
+{
+	unsigned long long previousNs = _startNs;
+	unsigned long long nowNs      = LatencyHistogram::now();
+
+	_deadlineNs += _periodNs;
+
+	if (nowNs >= _deadlineNs)
+	{
+		// Overran: go again now and keep the period from here
+		_overruns++;
+		_jitter.record(nowNs - _deadlineNs);
+
+		_deadlineNs = nowNs;
+	}
+	else
+	{
+		struct timespec deadline;
+
+		deadline.tv_sec  = _deadlineNs / 1000000000ULL;
+		deadline.tv_nsec = _deadlineNs % 1000000000ULL;
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+			;
+
+		nowNs = LatencyHistogram::now();
+		_jitter.record(nowNs > _deadlineNs ? nowNs - _deadlineNs : 0);
+	}
+
+	_startNs = nowNs;
+	_iterations++;
+	_period.record(nowNs - previousNs);
+
+	return nowNs - previousNs;
+}
+
+/**
+ * LoopTimer::log - iteration and overrun counts followed by the period and jitter histograms
+ *
+ * @param Logger * logger
+ * @param char *   name
+ *
+ * @return void
+ */
+void LoopTimer::log(Logger *logger, const char *name) const
+{
+	char histogram[128];
+
+	logger->notice("%s: %u Hz, %lu iterations, %lu overruns", name, getRate(), _iterations, _overruns);
+
+	snprintf(histogram, sizeof(histogram), "%s period", name);
+	_period.log(logger, histogram);
+
+	snprintf(histogram, sizeof(histogram), "%s jitter", name);
+	_jitter.log(logger, histogram);
+}
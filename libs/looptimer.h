@@ -0,0 +1,56 @@
+/**
+ * looptimer.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Fixed-rate loop timing against absolute CLOCK_MONOTONIC deadlines.
+ *
+ * Each wait() sleeps (clock_nanosleep, TIMER_ABSTIME) until one period after the previous deadline rather than for a
+ * period from now, so the time spent doing the work doesn't stretch the period. An iteration that runs past its next
+ * deadline is an overrun: the loop carries on straight away and the deadlines are re-anchored to now, rather than
+ * running several iterations back to back to catch up.
+ *
+ * The measured period (start of one iteration to the start of the next) and jitter (how far past its deadline an
+ * iteration started) of every iteration go into histograms.
+ */
+
+#ifndef _LOOPTIMER_H_INCLUDED
+#define _LOOPTIMER_H_INCLUDED
+
+#include "latency.h"
+
+#define LOOPTIMER_RATE_MAX 1000     // Hz
+
+class Logger;
+
+class LoopTimer
+{
+	private:
+		unsigned long long	_periodNs;
+		unsigned long long	_deadlineNs;		// absolute CLOCK_MONOTONIC time the current iteration was due to start
+		unsigned long long	_startNs;			// when the current iteration actually started
+		unsigned long		_iterations;
+		unsigned long		_overruns;
+
+		LatencyHistogram	_period;
+		LatencyHistogram	_jitter;
+
+	public:
+		LoopTimer(unsigned int rateHz);
+
+		int					setRate(unsigned int rateHz);
+		unsigned int		getRate() const					{ return (unsigned int)(1000000000ULL / _periodNs); }
+		unsigned long long	getPeriodNs() const				{ return _periodNs; }
+
+		void				start();
+		unsigned long long	wait();
+
+		unsigned long		getIterations() const			{ return _iterations; }
+		unsigned long		getOverruns() const				{ return _overruns; }
+		const LatencyHistogram & getPeriodHistogram() const	{ return _period; }
+		const LatencyHistogram & getJitterHistogram() const	{ return _jitter; }
+
+		void				log(Logger *logger, const char *name) const;
+};
+
+#endif // _LOOPTIMER_H_INCLUDED
@@ -0,0 +1,377 @@
+/**
+ * motorcal.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "motorcal.h"
+#include "motorlib.h"
+#include "pwmlib.h"
+#include "odo.h"
+#include "logger.h"
+
+static const char *gMotorNames[2]     = { "left", "right" };
+static const char *gDirectionNames[2] = { "forward", "reverse" };
+
+/**
+ * ctor
+ */
+MotorCalibration::MotorCalibration()
+{
+	_logger = new Logger("MotorCalibration");
+
+	memset(_curves, 0, sizeof(_curves));
+}
+
+/**
+ * dtor
+ */
+MotorCalibration::~MotorCalibration()
+{
+	delete _logger;
+}
+
+/**
+ * MotorCalibration::getDefaultFile
+ *
+ * @return const char *	$OROBOTO_MOTORCAL if it is set, otherwise MOTORCAL_DEFAULT_FILE
+ */
+const char * MotorCalibration::getDefaultFile()
+{
+	const char *filename = getenv(MOTORCAL_FILE_ENV);
+
+	return (filename && *filename) ? filename : MOTORCAL_DEFAULT_FILE;
+}
+
+/**
+ * MotorCalibration::setPoints - build the lookup curve for a motor and direction from measured points
+ *
+ * Points that are no faster than the one before (noise, or the wheel still stalled) are dropped so that velocity only
+ * ever increases along the curve. The first point is the highest duty cycle the wheel was still stalled at.
+ *
+ * @param int			 motor		MOTOR_LEFT or MOTOR_RIGHT
+ * @param bool			 forward
+ * @param double *		 duty		%, ascending
+ * @param double *		 velocity	cm/s
+ * @param unsigned int	 nPoints
+ *
+ * @return void
+ */
+void MotorCalibration::setPoints(int motor, bool forward, const double *duty, const double *velocity, unsigned int nPoints)
+{
+	MotorCalCurve &curve = _curves[motor][forward ? 0 : 1];
+	unsigned int   i, n = 0;
+	double         v;
+
+	for (i = 0; i < nPoints && n < MOTORCAL_MAX_POINTS; i++)
+	{
+		v = fabs(velocity[i]) < MOTORCAL_STALL_VELOCITY ? 0.0 : fabs(velocity[i]);
+
+		if (n == 0)
+		{
+			curve.duty[n]     = duty[i];
+			curve.velocity[n] = v;
+			n++;
+		}
+		else if (v > curve.velocity[n - 1])
+		{
+			curve.duty[n]     = duty[i];
+			curve.velocity[n] = v;
+			n++;
+		}
+		else if (n == 1 && v == 0.0)
+		{
+			// Still stalled
+			curve.duty[0] = duty[i];
+		}
+	}
+
+	curve.nPoints = n;
+}
+
+/**
+ * MotorCalibration::sweep - measure each wheel's steady state velocity across the duty cycles
+ *
+ * The odometer must be running. Each wheel is driven on its own, in each direction, at every dutyStep % from 0 to
+ * 100 and its velocity measured from the odometry between two snapshots measureMs apart.
+ *
+ * @param Odometer *	 odo
+ * @param int			 dutyStep	%
+ * @param unsigned int	 settleMs	how long to wait after changing the duty cycle before measuring
+ * @param unsigned int	 measureMs	how long to measure for
+ *
+ * @return int	0 or -1
+ */
+int MotorCalibration::sweep(Odometer *odo, int dutyStep, unsigned int settleMs, unsigned int measureMs)
+{
+	double           duty[MOTORCAL_MAX_POINTS], velocity[MOTORCAL_MAX_POINTS];
+	double           distLeftStart, distRightStart, distLeftEnd, distRightEnd, dist;
+	unsigned int     nPoints;
+	OdometrySnapshot start, end;
+
+	if ( ! odo->getRunning())
+	{
+		_logger->error("sweep: the odometer must be running");
+		return -1;
+	}
+
+	if (dutyStep < 1)
+	{
+		dutyStep = 1;
+	}
+
+	for (int motor = MOTOR_LEFT; motor <= MOTOR_RIGHT; motor++)
+	{
+		for (int direction = 0; direction < 2; direction++)
+		{
+			bool forward = (direction == 0);
+
+			nPoints = 0;
+
+			for (int dc = 0; dc <= 100 && nPoints < MOTORCAL_MAX_POINTS; dc += dutyStep)
+			{
+				if (forward)
+				{
+					motor_forward(motor, pwm_speed(dc));
+				}
+				else
+				{
+					motor_reverse(motor, pwm_speed(dc));
+				}
+
+				usleep(settleMs * 1000);
+
+				start = odo->getSnapshot();
+				usleep(measureMs * 1000);
+				end   = odo->getSnapshot();
+
+				if (odo->getError())
+				{
+					_logger->error("sweep: odometer stopped with an error");
+					motor_stop(motor);
+					return -1;
+				}
+
+				odo->getDistance(start, &distLeftStart, &distRightStart);
+				odo->getDistance(end,   &distLeftEnd,   &distRightEnd);
+
+				dist = (motor == MOTOR_LEFT) ? distLeftEnd - distLeftStart : distRightEnd - distRightStart;
+
+				// Time between the first and last edge counted, not the time we slept
+				duty[nPoints]     = dc;
+				velocity[nPoints] = (end.timestampNs > start.timestampNs && start.timestampNs != 0) ? fabs(dist) / ((end.timestampNs - start.timestampNs) / 1e9) : 0.0;
+
+				_logger->notice("sweep: %s %s %3d%% -> %.2f cm/s", gMotorNames[motor], gDirectionNames[direction], dc, velocity[nPoints]);
+
+				nPoints++;
+			}
+
+			motor_stop(motor);
+			usleep(settleMs * 1000);
+
+			setPoints(motor, forward, duty, velocity, nPoints);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * MotorCalibration::save
+ *
+ * @param char * filename	NULL for getDefaultFile()
+ *
+ * @return int	0 or -errno
+ */
+int MotorCalibration::save(const char *filename) const
+{
+	FILE *fp;
+
+	if (filename == NULL)
+	{
+		filename = getDefaultFile();
+	}
+
+	if ((fp = fopen(filename, "w")) == NULL)
+	{
+		_logger->error("save: could not open %s: %s", filename, strerror(errno));
+		return -errno;
+	}
+
+	fprintf(fp, "# oroboto motor calibration: <motor> <direction> <duty %%> <velocity cm/s>\n");
+
+	for (int motor = MOTOR_LEFT; motor <= MOTOR_RIGHT; motor++)
+	{
+		for (int direction = 0; direction < 2; direction++)
+		{
+			const MotorCalCurve &curve = _curves[motor][direction];
+
+			for (unsigned int i = 0; i < curve.nPoints; i++)
+			{
+				fprintf(fp, "%s %s %.1f %.3f\n", gMotorNames[motor], gDirectionNames[direction], curve.duty[i], curve.velocity[i]);
+			}
+		}
+	}
+
+	if (fclose(fp) != 0)
+	{
+		return -errno;
+	}
+
+	_logger->notice("save: wrote %s", filename);
+
+	return 0;
+}
+
+/**
+ * MotorCalibration::load
+ *
+ * @param char * filename	NULL for getDefaultFile()
+ *
+ * @return int	0 or -errno (-EINVAL if the file isn't a complete calibration)
+ */
+int MotorCalibration::load(const char *filename)
+{
+	double       duty[2][2][MOTORCAL_MAX_POINTS], velocity[2][2][MOTORCAL_MAX_POINTS];
+	unsigned int nPoints[2][2] = { { 0, 0 }, { 0, 0 } };
+	char         line[128], motorName[16], directionName[16];
+	double       dc, v;
+	int          motor, direction, ret = 0;
+	FILE *       fp;
+
+	if (filename == NULL)
+	{
+		filename = getDefaultFile();
+	}
+
+	if ((fp = fopen(filename, "r")) == NULL)
+	{
+		return -errno;
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		if (line[0] == '#' || line[0] == '\n')
+		{
+			continue;
+		}
+
+		if (sscanf(line, "%15s %15s %lf %lf", motorName, directionName, &dc, &v) != 4)
+		{
+			ret = -EINVAL;
+			break;
+		}
+
+		motor     = strcmp(motorName, gMotorNames[MOTOR_LEFT]) == 0 ? MOTOR_LEFT : (strcmp(motorName, gMotorNames[MOTOR_RIGHT]) == 0 ? MOTOR_RIGHT : -1);
+		direction = strcmp(directionName, gDirectionNames[0]) == 0 ? 0 : (strcmp(directionName, gDirectionNames[1]) == 0 ? 1 : -1);
+
+		if (motor < 0 || direction < 0 || nPoints[motor][direction] == MOTORCAL_MAX_POINTS)
+		{
+			ret = -EINVAL;
+			break;
+		}
+
+		duty[motor][direction][nPoints[motor][direction]]     = dc;
+		velocity[motor][direction][nPoints[motor][direction]] = v;
+		nPoints[motor][direction]++;
+	}
+
+	fclose(fp);
+
+	for (motor = MOTOR_LEFT; motor <= MOTOR_RIGHT && ret == 0; motor++)
+	{
+		for (direction = 0; direction < 2; direction++)
+		{
+			if (nPoints[motor][direction] < 2)
+			{
+				ret = -EINVAL;
+				break;
+			}
+		}
+	}
+
+	if (ret < 0)
+	{
+		_logger->error("load: %s is not a complete motor calibration", filename);
+		return ret;
+	}
+
+	for (motor = MOTOR_LEFT; motor <= MOTOR_RIGHT; motor++)
+	{
+		for (direction = 0; direction < 2; direction++)
+		{
+			setPoints(motor, direction == 0, duty[motor][direction], velocity[motor][direction], nPoints[motor][direction]);
+		}
+	}
+
+	_logger->notice("load: loaded %s", filename);
+
+	return 0;
+}
+
+/**
+ * MotorCalibration::isLoaded - is there a usable curve for every motor and direction?
+ *
+ * @return bool
+ */
+bool MotorCalibration::isLoaded() const
+{
+	for (int motor = MOTOR_LEFT; motor <= MOTOR_RIGHT; motor++)
+	{
+		for (int direction = 0; direction < 2; direction++)
+		{
+			if (_curves[motor][direction].nPoints < 2)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * MotorCalibration::getDuty - the duty cycle that turns a wheel at a velocity
+ *
+ * @param int	 motor		MOTOR_LEFT or MOTOR_RIGHT
+ * @param bool	 forward
+ * @param double velocity	cm/s (the magnitude is used), anything faster than was measured gets the top duty cycle
+ *
+ * @return int	duty cycle %, or -1 if there is no calibration
+ */
+int MotorCalibration::getDuty(int motor, bool forward, double velocity) const
+{
+	const MotorCalCurve &curve = _curves[motor][forward ? 0 : 1];
+	unsigned int         i;
+
+	if (curve.nPoints < 2)
+	{
+		return -1;
+	}
+
+	velocity = fabs(velocity);
+
+	if (velocity == 0.0)
+	{
+		return 0;
+	}
+
+	for (i = 1; i < curve.nPoints && curve.velocity[i] < velocity; i++)
+		;
+
+	if (i == curve.nPoints)
+	{
+		return static_cast<int>(round(curve.duty[curve.nPoints - 1]));
+	}
+
+	double fraction = (velocity - curve.velocity[i - 1]) / (curve.velocity[i] - curve.velocity[i - 1]);
+
+	return static_cast<int>(round(curve.duty[i - 1] + fraction * (curve.duty[i] - curve.duty[i - 1])));
+}
@@ -0,0 +1,64 @@
+/**
+ * motorcal.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Per-robot motor calibration: the velocity each wheel turns at for a given PWM duty cycle, in each direction.
+ *
+ * sweep() measures it by stepping each wheel through the duty cycles with the odometer running, save() and load()
+ * keep it in a small text file (one "<left|right> <forward|reverse> <duty %> <cm/s>" line per point). Once loaded,
+ * getDuty() turns a required velocity back into a duty cycle by interpolating between the measured points, without
+ * allocating.
+ *
+ * NOTE: The robot should be up on a stand for a sweep (or at least have room to pivot), each wheel is driven on its
+ *       own at every duty cycle.
+ */
+
+#ifndef _MOTORCAL_H_INCLUDED
+#define _MOTORCAL_H_INCLUDED
+
+#define MOTORCAL_FILE_ENV       "OROBOTO_MOTORCAL"  // environment variable naming the calibration file
+#define MOTORCAL_DEFAULT_FILE   "motorcal.txt"      // used when it isn't set
+
+#define MOTORCAL_MAX_POINTS     101                 // one per duty cycle %
+#define MOTORCAL_DUTY_STEP      5                   // default sweep step (%)
+#define MOTORCAL_SETTLE_MS      750                 // time for a wheel to reach steady state after a duty change
+#define MOTORCAL_MEASURE_MS     1500                // time the steady state velocity is measured over
+#define MOTORCAL_STALL_VELOCITY 0.05                // cm/s, slower than this the wheel isn't really turning
+
+class Odometer;
+class Logger;
+
+struct MotorCalCurve
+{
+	unsigned int	nPoints;
+	double			velocity[MOTORCAL_MAX_POINTS];	// cm/s, strictly increasing after the first (stall) point
+	double			duty[MOTORCAL_MAX_POINTS];		// %
+};
+
+class MotorCalibration
+{
+	private:
+		MotorCalCurve	_curves[2][2];		// [MOTOR_LEFT|MOTOR_RIGHT][forward, reverse]
+
+		Logger *		_logger;
+
+		void	setPoints(int motor, bool forward, const double *duty, const double *velocity, unsigned int nPoints);
+
+	public:
+		MotorCalibration();
+		~MotorCalibration();
+
+		int		sweep(Odometer *odo, int dutyStep = MOTORCAL_DUTY_STEP, unsigned int settleMs = MOTORCAL_SETTLE_MS, unsigned int measureMs = MOTORCAL_MEASURE_MS);
+
+		int		load(const char *filename = NULL);
+		int		save(const char *filename = NULL) const;
+
+		bool	isLoaded() const;
+
+		int		getDuty(int motor, bool forward, double velocity) const;
+
+		static const char * getDefaultFile();
+};
+
+#endif // _MOTORCAL_H_INCLUDED
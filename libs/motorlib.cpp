@@ -13,19 +13,28 @@
 #include "motorlib.h"
 #include "logger.h"
 #include "pwmlib.h"
+#include "actuator.h"
+
+static unsigned int gMotorPwms[2][2];      // [MOTOR_LEFT, MOTOR_RIGHT][MOTOR_PWM_A, MOTOR_PWM_B]
 
 /**
  * Initialise the motor subsystem.
+ *
+ * @param RobotProfile & profile    which PWMs drive which motor
  */
-void motor_init()
+void motor_init(const RobotProfile &profile)
 {
     pwm_init();
 
     // Control of two motors with the DRV8833 requires 4 PWM channels
-    pwm_enable(0);
-    pwm_enable(1);
-    pwm_enable(2);
-    pwm_enable(3);
+    for (int motor = MOTOR_LEFT; motor <= MOTOR_RIGHT; motor++)
+    {
+        gMotorPwms[motor][MOTOR_PWM_A] = profile.motorPwms[motor][MOTOR_PWM_A];
+        gMotorPwms[motor][MOTOR_PWM_B] = profile.motorPwms[motor][MOTOR_PWM_B];
+
+        pwm_enable(gMotorPwms[motor][MOTOR_PWM_A]);
+        pwm_enable(gMotorPwms[motor][MOTOR_PWM_B]);
+    }
 }
 
 /**
@@ -40,28 +49,35 @@ void motor_init()
  */
 int motor_forward(int motor, int speed)
 {
+    int ret = 0;
+
+    // The stop is only an intermediate state, don't let it reach the motor on its own
+    actuator_begin();
+
     motor_stop(motor);
 
     switch (motor)
     {
         case MOTOR_LEFT:
             // slow decay, see DRV8833 datasheet for truth table
-            pwm_pull(MOTOR_LEFT_PWM_A, PWM_DIRECTION_HIGH);
-            pwm_set_duty(MOTOR_LEFT_PWM_B, speed);
+            pwm_pull(gMotorPwms[MOTOR_LEFT][MOTOR_PWM_A], PWM_DIRECTION_HIGH);
+            pwm_set_duty(gMotorPwms[MOTOR_LEFT][MOTOR_PWM_B], speed);
             break;
 
         case MOTOR_RIGHT:
             // slow decay
-            pwm_pull(MOTOR_RIGHT_PWM_A, PWM_DIRECTION_HIGH);
-            pwm_set_duty(MOTOR_RIGHT_PWM_B, speed);
+            pwm_pull(gMotorPwms[MOTOR_RIGHT][MOTOR_PWM_A], PWM_DIRECTION_HIGH);
+            pwm_set_duty(gMotorPwms[MOTOR_RIGHT][MOTOR_PWM_B], speed);
             break;
 
         default:
         	Logger::getInstance()->error("motor::motor_forward: unknown motor");
-            return -1;
+            ret = -1;
     }
 
-    return 0;
+    actuator_commit();
+
+    return ret;
 }
 
 /**
@@ -76,28 +92,35 @@ int motor_forward(int motor, int speed)
  */
 int motor_reverse(int motor, int speed)
 {
+    int ret = 0;
+
+    // The stop is only an intermediate state, don't let it reach the motor on its own
+    actuator_begin();
+
     motor_stop(motor);
 
     switch (motor)
     {
         case MOTOR_LEFT:
             // slow decay
-            pwm_pull(MOTOR_LEFT_PWM_B, PWM_DIRECTION_HIGH);
-            pwm_set_duty(MOTOR_LEFT_PWM_A, speed);
+            pwm_pull(gMotorPwms[MOTOR_LEFT][MOTOR_PWM_B], PWM_DIRECTION_HIGH);
+            pwm_set_duty(gMotorPwms[MOTOR_LEFT][MOTOR_PWM_A], speed);
             break;
 
         case MOTOR_RIGHT:
             // slow decay
-            pwm_pull(MOTOR_RIGHT_PWM_B, PWM_DIRECTION_HIGH);
-            pwm_set_duty(MOTOR_RIGHT_PWM_A, speed);
+            pwm_pull(gMotorPwms[MOTOR_RIGHT][MOTOR_PWM_B], PWM_DIRECTION_HIGH);
+            pwm_set_duty(gMotorPwms[MOTOR_RIGHT][MOTOR_PWM_A], speed);
             break;
 
         default:
         	Logger::getInstance()->error("motor::motor_reverse: unknown motor");
-            return -1;
+            ret = -1;
     }
 
-    return 0;
+    actuator_commit();
+
+    return ret;
 }
 
 /**
@@ -110,13 +133,13 @@ int motor_stop(int motor)
     switch (motor)
     {
         case MOTOR_LEFT:
-            pwm_pull(MOTOR_LEFT_PWM_A, PWM_DIRECTION_HIGH);
-            pwm_pull(MOTOR_LEFT_PWM_B, PWM_DIRECTION_HIGH);
+            pwm_pull(gMotorPwms[MOTOR_LEFT][MOTOR_PWM_A], PWM_DIRECTION_HIGH);
+            pwm_pull(gMotorPwms[MOTOR_LEFT][MOTOR_PWM_B], PWM_DIRECTION_HIGH);
             break;
 
         case MOTOR_RIGHT:
-            pwm_pull(MOTOR_RIGHT_PWM_A, PWM_DIRECTION_HIGH);
-            pwm_pull(MOTOR_RIGHT_PWM_B, PWM_DIRECTION_HIGH);
+            pwm_pull(gMotorPwms[MOTOR_RIGHT][MOTOR_PWM_A], PWM_DIRECTION_HIGH);
+            pwm_pull(gMotorPwms[MOTOR_RIGHT][MOTOR_PWM_B], PWM_DIRECTION_HIGH);
             break;
 
         default:
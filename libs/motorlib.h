@@ -13,19 +13,18 @@
 #ifndef _MOTORLIB_H_INCLUDED
 #define _MOTORLIB_H_INCLUDED
 
+#include "robotprofile.h"
+
 #define MOTOR_LEFT          0
 #define MOTOR_RIGHT         1
 
-#define MOTOR_LEFT_PWM_A    1               // the PWMs that connect to the left motor's DRV8833 control signals, see pwmlib.h
-#define MOTOR_LEFT_PWM_B    0
-
-#define MOTOR_RIGHT_PWM_A   3               // the PWMs that connect to the right motor's DRV8833 control signals, see pwmlib.h
-#define MOTOR_RIGHT_PWM_B   2
+#define MOTOR_PWM_A         0               // the DRV8833 control signals, the PWMs that drive them come from the robot profile
+#define MOTOR_PWM_B         1
 
 #define SPIN_DIRECTION_LEFT  0
 #define SPIN_DIRECTION_RIGHT 1
 
-void motor_init();
+void motor_init(const RobotProfile &profile = ROBOT_PROFILE_OROBOTO);
 int  motor_forward(int motor, int speed);
 int  motor_reverse(int motor, int speed);
 int  motor_stop(int motor);
@@ -12,11 +12,17 @@
 #include <pthread.h>
 #include <fcntl.h>
 #include <math.h>
+#include <errno.h>
 #include <sys/time.h>
+#include <time.h>
 
 #include "odo.h"
 #include "gpio.h"
+#include "gpioedge.h"
+#include "quadrature.h"
+#include "poseestimator.h"
 #include "logger.h"
+#include "rtprofile.h"
 #include "motorlib.h"
 #include "pwmlib.h"
 
@@ -27,13 +33,15 @@ extern "C" void * gOdoThread(void *arg)
 }
 
 /**
- * @param unsigned int wheelLeftGPIOA		GPIO # for left wheel optical encoder output A
- * @param unsigned int wheelLeftGPIOB		GPIO # for left wheel optical encoder output B
- * @param unsigned int wheelRightGPIOA		GPIO # for right wheel optical encoder output A
- * @param unsigned int wheelRightGPIOB		GPIO # for right wheel optical encoder output B
- * @param unsigned int wheelRadius			the radius of the wheel in centimeters
+ * @param unsigned int     wheelLeftGPIOA		GPIO # for left wheel optical encoder output A
+ * @param unsigned int     wheelLeftGPIOB		GPIO # for left wheel optical encoder output B
+ * @param unsigned int     wheelRightGPIOA		GPIO # for right wheel optical encoder output A
+ * @param unsigned int     wheelRightGPIOB		GPIO # for right wheel optical encoder output B
+ * @param double           wheelRadius			the radius of the wheel in centimeters
+ * @param double           ticksPerRevolution	encoder ticks per turn of a wheel
+ * @param GpioEdgeSource * edgeSource			where to get encoder edges from (NULL to create one for the default backend)
  */
-Odometer::Odometer(unsigned int wheelLeftGPIOA, unsigned int wheelLeftGPIOB, unsigned int wheelRightGPIOA, unsigned int wheelRightGPIOB, unsigned int wheelRadius)
+Odometer::Odometer(unsigned int wheelLeftGPIOA, unsigned int wheelLeftGPIOB, unsigned int wheelRightGPIOA, unsigned int wheelRightGPIOB, double wheelRadius, double ticksPerRevolution, GpioEdgeSource *edgeSource)
 {
 	_logger     = new Logger("Odometer");
 
@@ -42,99 +50,182 @@ Odometer::Odometer(unsigned int wheelLeftGPIOA, unsigned int wheelLeftGPIOB, uns
 	_rightGPIOA = wheelRightGPIOA;
 	_rightGPIOB = wheelRightGPIOB;
 
-	_wheelRadius = wheelRadius;
+	_wheelRadius        = wheelRadius;
+	_ticksPerRevolution = ticksPerRevolution;
+
+	_bOwnEdgeSource = (edgeSource == NULL);
+	_edgeSource     = _bOwnEdgeSource ? GpioEdgeSource::create(GpioEdgeSource::getDefaultBackend()) : edgeSource;
 
 	_logger->notice("ctor: Configuring left wheel GPIOs %d and %d", _leftGPIOA, _leftGPIOB);
 	_logger->notice("ctor: Configuring right wheel GPIOs %d and %d", _rightGPIOA, _rightGPIOB);
 
-	// Configure the GPIOs to be inputs
-	gpio_export(_leftGPIOA);
-	gpio_export(_leftGPIOB);
-	gpio_export(_rightGPIOA);
-	gpio_export(_rightGPIOB);
+	// Configure the GPIOs to be inputs that interrupt on both rising and falling edges
+	unsigned int gpios[ODO_LINES] = { _leftGPIOA, _leftGPIOB, _rightGPIOA, _rightGPIOB };
+
+	if (_edgeSource->open(gpios, ODO_LINES) < 0)
+	{
+		_logger->error("ctor: failed to open encoder GPIOs");
+	}
+
+	_bRun           = false;
+	_bThreadStarted = false;
+	_poseEstimator  = NULL;
 
-	gpio_set_direction(_leftGPIOA, INPUT_PIN);
-	gpio_set_direction(_leftGPIOB, INPUT_PIN);
-	gpio_set_direction(_rightGPIOA, INPUT_PIN);
-	gpio_set_direction(_rightGPIOB, INPUT_PIN);
+	memset(&_counts, 0, sizeof(_counts));
+	memset(&_base, 0, sizeof(_base));
+	pthread_mutex_init(&_publishLock, NULL);
+	publish();
 
-	// The GPIOs should interrupt on both rising and falling edges
-	gpio_set_edge(_leftGPIOA, EDGE_BOTH);
-	gpio_set_edge(_leftGPIOB, EDGE_BOTH);
-	gpio_set_edge(_rightGPIOA, EDGE_BOTH);
-	gpio_set_edge(_rightGPIOB, EDGE_BOTH);
+	_errorsReported   = 0;
+	_errorsReportedNs = 0;
 
 	reset();
 }
 
+/**
+ * @param RobotProfile &   profile		the robot's encoder GPIOs and wheels
+ * @param GpioEdgeSource * edgeSource	where to get encoder edges from (NULL to create one for the default backend)
+ */
+Odometer::Odometer(const RobotProfile &profile, GpioEdgeSource *edgeSource) : Odometer(profile.encoderGpios[ODO_LINE_LEFT_A], profile.encoderGpios[ODO_LINE_LEFT_B], profile.encoderGpios[ODO_LINE_RIGHT_A], profile.encoderGpios[ODO_LINE_RIGHT_B], profile.wheelRadius, profile.ticksPerRevolution, edgeSource)
+{
+}
+
 /**
  * dtor
  */
 Odometer::~Odometer()
 {
-	_logger->debug("dtor");
+	LOGGER_DEBUG(_logger, "dtor");
+
+	stop();
+
+	_recorder.close();
+
+	if (_bOwnEdgeSource)
+	{
+		delete _edgeSource;
+	}
+
+	pthread_mutex_destroy(&_publishLock);
 }
 
 /**
  * Odometer::run - run the state machine thread
  *
+ * The thread can be run again after stop(), the odometry carries on from where it was.
+ *
  * @return void
  */
 void Odometer::run()
 {
-	pthread_t tOdo;
+	if (_bRun)
+	{
+		_logger->notice("run: odometry thread is already running");
+		return;
+	}
+
+	// It may have exited by itself (ie. on an error) since it was last run
+	join();
+
+	reset();
+
+	_bRun = true;
+
+	LOGGER_DEBUG(_logger, "run: creating odometry thread ...");
+
+	pthread_attr_t attr;
+	rt_thread_attr_init(&attr);
+
+	if (pthread_create(&_thread, &attr, gOdoThread, this) != 0)
+	{
+		_logger->error("run: could not create odometry thread");
+
+		_bRun   = false;
+		_bError = true;
+	}
+	else
+	{
+		_bThreadStarted = true;
+	}
 
-	_logger->debug("run: creating odometry thread ...");
-	pthread_create(&tOdo, NULL, gOdoThread, this);
+	pthread_attr_destroy(&attr);
+}
 
-	// pthread_join(tOdo);
+/**
+ * Odometer::join - wait for the thread to exit
+ *
+ * @return void
+ */
+void Odometer::join()
+{
+	if (_bThreadStarted)
+	{
+		pthread_join(_thread, NULL);
+		_bThreadStarted = false;
+	}
 }
 
 /**
  * Odometer::reset - reset the odometer
  *
+ * The decoding thread never stops counting, this just remembers the totals as they are now so that everything read
+ * afterwards is relative to them. That means it is safe to call while the thread is running, from any thread.
+ *
  * @return void
  */
 void Odometer::reset()
 {
-	_odoLeft    = _odoRight    = 0;
-	_errorsLeft = _errorsRight = 0;
+	pthread_mutex_lock(&_publishLock);
+
+	OdometryPublished published = _published.load();
+
+	_base          = published.counts;
+	published.base = published.counts;
+	_published.store(published);
+
+	pthread_mutex_unlock(&_publishLock);
 
 //	_bRun   = false;
 	_bError = false;
 }
 
+/**
+ * Odometer::getLineIndex - map a GPIO # to its ODO_LINE_* index
+ *
+ * @param unsigned int gpio
+ *
+ * @return int		-1 if the GPIO isn't one of ours
+ */
+int Odometer::getLineIndex(unsigned int gpio)
+{
+	if (gpio == _leftGPIOA)  return ODO_LINE_LEFT_A;
+	if (gpio == _leftGPIOB)  return ODO_LINE_LEFT_B;
+	if (gpio == _rightGPIOA) return ODO_LINE_RIGHT_A;
+	if (gpio == _rightGPIOB) return ODO_LINE_RIGHT_B;
+
+	return -1;
+}
+
 /**
  * Odometer::thread - the thread function
  *
- * This waits for transitions (rising or falling edges) on the GPIO file descriptors and then uses gray code to determine
- * which wheel has turned in which direction.
+ * This waits for batches of transitions (rising or falling edges) from the edge source, records them if a recording
+ * has been started and then decodes them.
  *
  * @return void *
  */
 void * Odometer::thread()
 {
-	struct pollfd fdset[4];
-	int           nfds = 4, i;
-	int           fdLeftA, fdLeftB, fdRightA, fdRightB;
-	char          buf[8];
-	unsigned int  nRead;
-
-	unsigned char level;
-	unsigned char levelLeftA     = 0, levelLeftB     = 0, levelRightA     = 0, levelRightB     = 0;
-	unsigned char levelLeftAPrev = 0, levelLeftBPrev = 0, levelRightAPrev = 0, levelRightBPrev = 0;
-
-	reset();
+	GpioEdgeEvent      events[ODO_EVENT_BATCH];
+	int                nEvents;
+	unsigned char      levels[ODO_LINES];
+	unsigned long long now;
 
-	fdLeftA  = gpio_fd_open(_leftGPIOA, O_RDONLY);
-	fdLeftB  = gpio_fd_open(_leftGPIOB, O_RDONLY);
+	rt_thread_enter(RT_THREAD_ODOMETRY);
 
-	fdRightA = gpio_fd_open(_rightGPIOA, O_RDONLY);
-	fdRightB = gpio_fd_open(_rightGPIOB, O_RDONLY);
-
-	if (fdLeftA < 0 || fdLeftB < 0 || fdRightA < 0 || fdRightB < 0)
+	if (_edgeSource->getLevels(levels) < 0)
 	{
-		_logger->error("thread: failed to open GPIO file descriptors");
+		_logger->error("thread: failed to read initial GPIO levels");
 
 		_bError = true;
 		_bRun   = false;
@@ -142,25 +233,14 @@ void * Odometer::thread()
 		pthread_exit((void*)-1);
 	}
 
-	_bRun = true;
+	setLevels(levels);
 
 	while (_bRun)
 	{
-		memset((void*)fdset, 0, sizeof(fdset));
-
-		fdset[0].fd     = fdLeftA;
-		fdset[0].events = POLLPRI;
-		fdset[1].fd     = fdLeftB;
-		fdset[1].events = POLLPRI;
-		fdset[2].fd     = fdRightA;
-		fdset[2].events = POLLPRI;
-		fdset[3].fd     = fdRightB;
-		fdset[3].events = POLLPRI;
-
-		// Wait for an interrupt
-		if (poll(fdset, nfds, -1 /* no timeout */) < 0)
+		// Wait for edges
+		if ((nEvents = _edgeSource->read(events, ODO_EVENT_BATCH, -1 /* no timeout */)) < 0)
 		{
-			_logger->error("thread: poll() returned < 0");
+			_logger->error("thread: failed to read GPIO edges");
 
 			_bError = true;
 			_bRun   = false;
@@ -168,123 +248,316 @@ void * Odometer::thread()
 			pthread_exit((void*)-1);
 		}
 
-		// Determine which GPIO interrupted
-		if ((fdset[0].revents & POLLPRI) || (fdset[1].revents & POLLPRI) || (fdset[2].revents & POLLPRI) || (fdset[3].revents & POLLPRI))
-//		if (fdset[0].revents & POLLPRI || fdset[1].revents & POLLPRI)
+		if (nEvents > 0)
 		{
-			for (i = 0; i < nfds; i++)
-			{
-				lseek(fdset[i].fd, 0, 0);
-
-				// Read the current state of the GPIO input (high or low)
-				if ((nRead = read(fdset[i].fd, buf, sizeof(buf))) <= 0)
-				{
-					_logger->error("thread: failed to read GPIO FD %d on interrupt", i);
-
-					_bError = true;
-					_bRun   = false;
-
-					pthread_exit((void*)-1);
-				}
-
-				buf[nRead] = '\0';
-				if (atoi(buf))
-				{
-					level = 1;
-				}
-				else
-				{
-					level = 0;
-				}
-
-				switch (i)
-				{
-					case 0:
-						levelLeftA = level;
-						break;
-
-					case 1:
-						levelLeftB = level;
-						break;
-
-					case 2:
-						levelRightA = level;
-						break;
-
-					case 3:
-						levelRightB = level;
-						break;
-				}
-			}
+			// The first edge is the one that woke us
+			now = LatencyHistogram::now();
 
-			// What's happening to the left wheel?
-			if (levelLeftA ^ levelLeftBPrev)
+			if (events[0].timestampNs != 0 && events[0].timestampNs <= now)
 			{
-				_odoLeft++;
-			}
-			if (levelLeftB ^ levelLeftAPrev)
-			{
-				_odoLeft--;
+				_wakeupLatency.record(now - events[0].timestampNs);
 			}
 
-//			_logger->debug("thread: LEFT [%d %d] => %d", levelLeftA, levelLeftB, _odoLeft);
+			_recorder.add(events, nEvents);
 
-			// We can't see state transitions on both channels, that's an invalid transition for the gray code.
-			if (levelLeftA != levelLeftAPrev && levelLeftB != levelLeftBPrev)
-			{
-				_logger->notice("thread: LEFT odometry error, multiple transitions");
-				_errorsLeft++;
-			}
+			decode(events, nEvents);
+		}
+	}
 
-			// What's happening to the right wheel?
-			//
-			// NOTE: If the wrong encoder sensor is connected to the wrong GPIO, this will count backwards when the
-			//       wheel is turning forwards.
-			if (levelRightA ^ levelRightBPrev)
-			{
-				_odoRight++;
-			}
-			if (levelRightB ^ levelRightAPrev)
-			{
-				_odoRight--;
-			}
+	LOGGER_DEBUG(_logger, "thread: exiting");
 
-//			_logger->debug("thread: RIGHT [%d %d] => %d", levelRightA, levelRightB, _odoRight);
+	_bRun = false;
 
-			// We can't see state transitions on both channels, that's an invalid transition for the gray code.
-			if (levelRightA != levelRightAPrev && levelRightB != levelRightBPrev)
-			{
-				_logger->notice("thread: RIGHT odometry error, multiple transitions");
-				_errorsRight++;
-			}
+	pthread_exit((void*)0);
+}
+
+/**
+ * Odometer::setLevels - set the encoder levels that the next edges are decoded against
+ *
+ * @param unsigned char * levels	indexed by ODO_LINE_*
+ *
+ * @return void
+ */
+void Odometer::setLevels(const unsigned char *levels)
+{
+	memcpy(_levels, levels, sizeof(_levels));
+
+	_stateLeftPrev  = QuadratureDecoder::state(_levels[ODO_LINE_LEFT_A],  _levels[ODO_LINE_LEFT_B]);
+	_stateRightPrev = QuadratureDecoder::state(_levels[ODO_LINE_RIGHT_A], _levels[ODO_LINE_RIGHT_B]);
+}
+
+/**
+ * Odometer::decode - use gray code to determine which wheel has turned in which direction (see quadrature.h)
+ *
+ * @param GpioEdgeEvent * events
+ * @param int             nEvents
+ *
+ * @return void
+ */
+void Odometer::decode(const GpioEdgeEvent *events, int nEvents)
+{
+	int          i, line, deltaLeft, deltaRight;
+	unsigned int stateLeft, stateRight, entry;
+
+	for (i = 0; i < nEvents; i++)
+	{
+		if ((line = getLineIndex(events[i].gpio)) >= 0)
+		{
+			_levels[line] = events[i].level;
+		}
 
-			levelLeftAPrev  = levelLeftA;
-			levelLeftBPrev  = levelLeftB;
-			levelRightAPrev = levelRightA;
-			levelRightBPrev = levelRightB;
+		// Edges with the same timestamp happened together as far as the backend can tell, decode them as one transition
+		if (i + 1 < nEvents && events[i + 1].timestampNs == events[i].timestampNs)
+		{
+			continue;
+		}
+
+		stateLeft  = QuadratureDecoder::state(_levels[ODO_LINE_LEFT_A],  _levels[ODO_LINE_LEFT_B]);
+		stateRight = QuadratureDecoder::state(_levels[ODO_LINE_RIGHT_A], _levels[ODO_LINE_RIGHT_B]);
+
+		// What's happening to the left wheel?
+		entry            = QuadratureDecoder::transition(_stateLeftPrev, stateLeft);
+		deltaLeft        = QUADRATURE_DELTA(entry);
+		_counts.odoLeft += deltaLeft;
+
+		if (QUADRATURE_DELTA(entry) != 0)
+		{
+			_edgesLeft.push(events[i].timestampNs, _counts.odoLeft, QUADRATURE_DELTA(entry));
+		}
+
+		LOGGER_DEBUG(_logger, "decode: LEFT [%d %d] => %d", _levels[ODO_LINE_LEFT_A], _levels[ODO_LINE_LEFT_B], _counts.odoLeft);
+
+		// We can't see state transitions on both channels, that's an invalid transition for the gray code.
+		if (QUADRATURE_INVALID(entry))
+		{
+			LOGGER_DEBUG(_logger, "decode: LEFT odometry error, multiple transitions");
+			_counts.errorsLeft++;
+		}
+
+		// What's happening to the right wheel?
+		//
+		// NOTE: If the wrong encoder sensor is connected to the wrong GPIO, this will count backwards when the
+		//       wheel is turning forwards.
+		entry             = QuadratureDecoder::transition(_stateRightPrev, stateRight);
+		deltaRight        = QUADRATURE_DELTA(entry);
+		_counts.odoRight += deltaRight;
+
+		if (QUADRATURE_DELTA(entry) != 0)
+		{
+			_edgesRight.push(events[i].timestampNs, _counts.odoRight, QUADRATURE_DELTA(entry));
+		}
+
+		LOGGER_DEBUG(_logger, "decode: RIGHT [%d %d] => %d", _levels[ODO_LINE_RIGHT_A], _levels[ODO_LINE_RIGHT_B], _counts.odoRight);
+
+		// We can't see state transitions on both channels, that's an invalid transition for the gray code.
+		if (QUADRATURE_INVALID(entry))
+		{
+			LOGGER_DEBUG(_logger, "decode: RIGHT odometry error, multiple transitions");
+			_counts.errorsRight++;
+		}
+
+		_stateLeftPrev  = stateLeft;
+		_stateRightPrev = stateRight;
+
+		_counts.timestampNs = events[i].timestampNs;
+
+		if (_poseEstimator && (deltaLeft != 0 || deltaRight != 0))
+		{
+			_poseEstimator->step(deltaLeft, deltaRight, events[i].timestampNs);
 		}
 	}
 
-	_logger->debug("thread: exiting");
+	// Readers see the whole batch at once
+	publish();
 
-	gpio_fd_close(fdLeftA);
-	gpio_fd_close(fdLeftB);
-	gpio_fd_close(fdRightA);
-	gpio_fd_close(fdRightB);
+	// A noisy encoder makes errors on every edge, only say so now and then
+	if (_counts.errorsLeft + _counts.errorsRight != _errorsReported && _counts.timestampNs - _errorsReportedNs >= ODO_ERROR_REPORT_NS)
+	{
+		_logger->notice("decode: odometry errors (multiple transitions) so far, left %u right %u", _counts.errorsLeft, _counts.errorsRight);
 
-	_bRun = false;
+		_errorsReported   = _counts.errorsLeft + _counts.errorsRight;
+		_errorsReportedNs = _counts.timestampNs;
+	}
 
-	pthread_exit((void*)0);
+	if (_poseEstimator)
+	{
+		_poseEstimator->publish();
+	}
+}
+
+/**
+ * Odometer::publish - make the running totals (with the totals at the last reset) what readers see
+ *
+ * @return void
+ */
+void Odometer::publish()
+{
+	OdometryPublished published;
+
+	pthread_mutex_lock(&_publishLock);
+
+	published.counts = _counts;
+	published.base   = _base;
+	_published.store(published);
+
+	pthread_mutex_unlock(&_publishLock);
+}
+
+/**
+ * Odometer::setPoseEstimator - integrate the pose on every transition the odometry thread decodes
+ *
+ * This can only be changed while the thread isn't running.
+ *
+ * @param PoseEstimator * poseEstimator	NULL to stop integrating
+ *
+ * @return int	0 or -EBUSY
+ */
+int Odometer::setPoseEstimator(PoseEstimator *poseEstimator)
+{
+	if (_bRun)
+	{
+		_logger->error("setPoseEstimator: the pose estimator cannot be changed while the odometry thread is running");
+		return -EBUSY;
+	}
+
+	_poseEstimator = poseEstimator;
+
+	return 0;
+}
+
+/**
+ * Odometer::record - record every edge the odometry thread sees to a file, see edgerecord.h
+ *
+ * This can only be started or stopped while the thread isn't running. The recording is finished when it is stopped or
+ * the odometer is destroyed.
+ *
+ * @param char *		 filename	where to record to, NULL to stop recording
+ * @param unsigned int bufferSize	edges buffered between writes, edges are dropped if the writer falls this far behind
+ *
+ * @return int	0 or -errno
+ */
+int Odometer::record(const char *filename, unsigned int bufferSize)
+{
+	unsigned int  gpios[ODO_LINES] = { _leftGPIOA, _leftGPIOB, _rightGPIOA, _rightGPIOB };
+	unsigned char levels[ODO_LINES];
+	int           ret;
+
+	if (_bRun)
+	{
+		_logger->error("record: recording cannot be started or stopped while the odometry thread is running");
+		return -EBUSY;
+	}
+
+	_recorder.close();
+
+	if (filename == NULL)
+	{
+		return 0;
+	}
+
+	if ((ret = _edgeSource->getLevels(levels)) < 0)
+	{
+		_logger->error("record: failed to read GPIO levels");
+		return ret;
+	}
+
+	if ((ret = _recorder.open(filename, gpios, levels, ODO_LINES, bufferSize)) < 0)
+	{
+		_logger->error("record: could not open %s: %s", filename, strerror(-ret));
+		return ret;
+	}
+
+	_logger->notice("record: recording edges to %s", filename);
+
+	return 0;
+}
+
+/**
+ * Odometer::replay - decode a recording as if its edges had just come from the edge source
+ *
+ * The recording is decoded as fast as possible on the calling thread, so this can only be done while the odometry
+ * thread isn't running. Its GPIO #s must match ours, and the counts carry on from where they are.
+ *
+ * @param EdgeRecording & recording
+ *
+ * @return long		the number of edges replayed, or -1
+ */
+long Odometer::replay(const EdgeRecording &recording)
+{
+	const GpioEdgeEvent *events = recording.getEvents();
+	unsigned long        nEvents = recording.getCount(), i, n;
+	unsigned char        levels[ODO_LINES];
+	int                  line;
+
+	if (_bRun)
+	{
+		_logger->error("replay: a recording cannot be replayed while the odometry thread is running");
+		return -1;
+	}
+
+	if (_edgeSource->getLevels(levels) < 0)
+	{
+		memset(levels, 0, sizeof(levels));
+	}
+
+	for (i = 0; i < recording.getLineCount(); i++)
+	{
+		if ((line = getLineIndex(recording.getGpios()[i])) >= 0)
+		{
+			levels[line] = recording.getLevels()[i];
+		}
+	}
+
+	setLevels(levels);
+
+	// Same batch size as the thread, a batch can split edges that share a timestamp there too
+	for (i = 0; i < nEvents; i += n)
+	{
+		n = nEvents - i < ODO_EVENT_BATCH ? nEvents - i : ODO_EVENT_BATCH;
+
+		decode(events + i, n);
+	}
+
+	return nEvents;
 }
 
 /**
  * Odometer::stop - stop the state machine thread
  *
+ * The thread's wait for edges is interrupted, so this returns as soon as it has exited even if the wheels are still.
+ *
  * @return void
  */
 void Odometer::stop()
 {
 	_bRun = false;
+
+	if (_bThreadStarted)
+	{
+		_edgeSource->wake();
+		join();
+	}
+}
+
+/**
+ * Odometer::getSnapshot
+ *
+ * Get the tick and error counts for both wheels since reset, along with the timestamp of the last edge they include.
+ * This doesn't take a lock and never blocks the odometry thread.
+ *
+ * @return OdometrySnapshot
+ */
+OdometrySnapshot Odometer::getSnapshot()
+{
+	OdometryPublished published = _published.load();
+	OdometrySnapshot  snapshot  = published.counts;
+
+	snapshot.odoLeft     -= published.base.odoLeft;
+	snapshot.odoRight    -= published.base.odoRight;
+	snapshot.errorsLeft  -= published.base.errorsLeft;
+	snapshot.errorsRight -= published.base.errorsRight;
+
+	return snapshot;
 }
 
 /**
@@ -297,9 +570,10 @@ void Odometer::stop()
  */
 void Odometer::getOdometry(int *wheelLeft, int *wheelRight)
 {
-	// @todo: lock
-	*wheelLeft  = _odoLeft;
-	*wheelRight = _odoRight;
+	OdometrySnapshot snapshot = getSnapshot();
+
+	*wheelLeft  = snapshot.odoLeft;
+	*wheelRight = snapshot.odoRight;
 }
 
 /**
@@ -312,8 +586,110 @@ void Odometer::getOdometry(int *wheelLeft, int *wheelRight)
  */
 void Odometer::getDistance(double *wheelLeft, double *wheelRight)
 {
-	*wheelLeft  = (2.0*M_PI*_wheelRadius*_odoLeft)  / ODO_TICKS_PER_REVOLUTION;
-	*wheelRight = (2.0*M_PI*_wheelRadius*_odoRight) / ODO_TICKS_PER_REVOLUTION;
+	getDistance(getSnapshot(), wheelLeft, wheelRight);
+}
+
+/**
+ * Odometer::getDistance (returns values in centimeters)
+ *
+ * @param OdometrySnapshot & snapshot	ticks to convert, from getSnapshot()
+ * @param double *			 wheelLeft	the distance travelled by the left wheel
+ * @param double *			 wheelRight	the distance travelled by the right wheel
+ *
+ * @return void
+ */
+void Odometer::getDistance(const OdometrySnapshot &snapshot, double *wheelLeft, double *wheelRight)
+{
+	*wheelLeft  = (2.0*M_PI*_wheelRadius*snapshot.odoLeft)  / _ticksPerRevolution;
+	*wheelRight = (2.0*M_PI*_wheelRadius*snapshot.odoRight) / _ticksPerRevolution;
+}
+
+/**
+ * Odometer::getVelocity (returns values in centimeters per second)
+ *
+ * Estimated from the time between the most recent edges, so it is good to within one edge period rather than one
+ * control period. When a wheel is turning too slowly for that to be meaningful, its ticks are counted over a window.
+ *
+ * @param double *			 wheelLeft	the velocity of the left wheel
+ * @param double *			 wheelRight	the velocity of the right wheel
+ * @param unsigned long long nowNs		the time to estimate at, on the edge source clock (0 for CLOCK_MONOTONIC now)
+ *
+ * @return void
+ */
+void Odometer::getVelocity(double *wheelLeft, double *wheelRight, unsigned long long nowNs)
+{
+	if (nowNs == 0)
+	{
+		struct timespec ts;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		nowNs = (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+	}
+
+	*wheelLeft  = getWheelVelocity(_edgesLeft,  nowNs);
+	*wheelRight = getWheelVelocity(_edgesRight, nowNs);
+}
+
+/**
+ * Odometer::getWheelVelocity (returns value in centimeters per second)
+ *
+ * @param EdgeRing &		 edges
+ * @param unsigned long long nowNs
+ *
+ * @return double
+ */
+double Odometer::getWheelVelocity(const EdgeRing<ODO_EDGE_RING> &edges, unsigned long long nowNs)
+{
+	EdgeSample         samples[ODO_EDGE_RING];
+	unsigned int       n, i;
+	unsigned long long sinceLast, span;
+	double             ticksPerNs, cmPerTick = (2.0*M_PI*_wheelRadius) / _ticksPerRevolution;
+
+	// Turning quickly: use the period over the last few edges
+	if ((n = edges.getLatest(samples, ODO_VELOCITY_EDGES + 1)) == 0)
+	{
+		return 0.0;
+	}
+
+	sinceLast = nowNs > samples[n - 1].timestampNs ? nowNs - samples[n - 1].timestampNs : 0;
+
+	if (n >= 2)
+	{
+		span = samples[n - 1].timestampNs - samples[0].timestampNs;
+
+		if (span > 0 && span / (n - 1) <= ODO_VELOCITY_PERIOD_MAX_NS && sinceLast <= ODO_VELOCITY_PERIOD_MAX_NS)
+		{
+			unsigned long long period = span / (n - 1);
+
+			ticksPerNs = static_cast<double>(samples[n - 1].count - samples[0].count) / span;
+
+			// If it's been longer than a period since the last edge the wheel has slowed down since
+			if (sinceLast > period)
+			{
+				ticksPerNs *= static_cast<double>(period) / sinceLast;
+			}
+
+			return ticksPerNs * 1e9 * cmPerTick;
+		}
+	}
+
+	// Turning slowly (or stopped): count the ticks in the window up to now
+	if (sinceLast >= ODO_VELOCITY_WINDOW_NS)
+	{
+		return 0.0;
+	}
+
+	n = edges.getLatest(samples, ODO_EDGE_RING);
+
+	const EdgeSample &last = samples[n - 1];
+
+	for (i = n; i > 0 && samples[i - 1].timestampNs + ODO_VELOCITY_WINDOW_NS > nowNs; i--)
+		;
+
+	// samples[i] is the oldest edge in the window, take the count from before it
+	ticksPerNs = static_cast<double>(last.count - (samples[i].count - samples[i].delta)) / ODO_VELOCITY_WINDOW_NS;
+
+	return ticksPerNs * 1e9 * cmPerTick;
 }
 
 /**
@@ -328,9 +704,10 @@ void Odometer::getDistance(double *wheelLeft, double *wheelRight)
  */
 void Odometer::getErrorCount(unsigned int *wheelLeft, unsigned int *wheelRight)
 {
-	// @todo: lock
-	*wheelLeft  = _errorsLeft;
-	*wheelRight = _errorsRight;
+	OdometrySnapshot snapshot = getSnapshot();
+
+	*wheelLeft  = snapshot.errorsLeft;
+	*wheelRight = snapshot.errorsRight;
 }
 
 /**
@@ -371,16 +748,12 @@ bool Odometer::getError()
  */
 unsigned long Odometer::getTimeToDistance(bool wheelLeft, bool forward, int revolutions, int speed)
 {
-	struct pollfd 	fdset[2];
-	int           	nfds = 2, i;
-	int           	fdA, fdB;
-	int          	gpioA, gpioB;
-	char          	buf[8];
-	unsigned int  	nRead;
+	GpioEdgeEvent 	events[ODO_EVENT_BATCH];
+	int           	nEvents, i;
+	int          	lineA, lineB;
+	unsigned char 	levels[ODO_LINES];
 
-	unsigned char 	ucState;
-	unsigned char 	ucA = 0,     ucB = 0;
-	unsigned char 	ucLastA = 0, ucLastB = 0;
+	unsigned int  	state, stateLast, entry;
 
 	int           	nCalibration = 0;
 
@@ -396,30 +769,27 @@ unsigned long Odometer::getTimeToDistance(bool wheelLeft, bool forward, int revo
 
 	if (wheelLeft)
 	{
-		_logger->debug("getTimeToDistance: running calibration for left wheel");
+		LOGGER_DEBUG(_logger, "getTimeToDistance: running calibration for left wheel");
 
-		gpioA = _leftGPIOA;
-		gpioB = _leftGPIOB;
+		lineA = ODO_LINE_LEFT_A;
+		lineB = ODO_LINE_LEFT_B;
 	}
 	else
 	{
-		_logger->debug("getTimeToDistance: running calibration for right wheel");
+		LOGGER_DEBUG(_logger, "getTimeToDistance: running calibration for right wheel");
 
-		gpioA = _rightGPIOA;
-		gpioB = _rightGPIOB;
+		lineA = ODO_LINE_RIGHT_A;
+		lineB = ODO_LINE_RIGHT_B;
 	}
 
-	_logger->debug("getTimeToDistance: opening the following GPIOs: %d and %d\n", gpioA, gpioB);
-
-	fdA  = gpio_fd_open(gpioA, O_RDONLY);
-	fdB  = gpio_fd_open(gpioB, O_RDONLY);
-
-	if (fdA < 0 || fdB < 0)
+	if (_edgeSource->getLevels(levels) < 0)
 	{
-		_logger->error("getTimeToDistance: failed to open GPIO file descriptors");
+		_logger->error("getTimeToDistance: failed to read GPIO levels");
 		return 0;
 	}
 
+	stateLast = QuadratureDecoder::state(levels[lineA], levels[lineB]);
+
 	if (gettimeofday(&tStart, NULL) < 0)
 	{
 		_logger->error("getTimeToDistance: could not get start time");
@@ -451,88 +821,55 @@ unsigned long Odometer::getTimeToDistance(bool wheelLeft, bool forward, int revo
 
 	bool firstRevolution = true;
 
-	while ( ! _bError && abs(nCalibration) < (static_cast<int>(ODO_TICKS_PER_REVOLUTION)*revolutions))
+	while ( ! _bError && abs(nCalibration) < (static_cast<int>(_ticksPerRevolution)*revolutions))
 	{
-//		_logger->debug("getTimeToDistance: waiting for interrupt");
+		LOGGER_DEBUG(_logger, "getTimeToDistance: waiting for interrupt");
 
-		memset((void*)fdset, 0, sizeof(fdset));
-
-		fdset[0].fd = fdA;
-		fdset[0].events = POLLPRI;
-		fdset[1].fd = fdB;
-		fdset[1].events = POLLPRI;
-
-		if (poll(fdset, nfds, -1 /* no timeout */) < 0)
+		if ((nEvents = _edgeSource->read(events, ODO_EVENT_BATCH, -1 /* no timeout */)) < 0)
 		{
-			_logger->error("getTimeToDistance: timed out waiting for interrupt");
+			_logger->error("getTimeToDistance: failed waiting for interrupt");
 			break;
 		}
 
-		if ((fdset[0].revents & POLLPRI) || (fdset[1].revents & POLLPRI))
+		for (i = 0; i < nEvents; i++)
 		{
-			for (i = 0; i < nfds; i++)
+			int line = getLineIndex(events[i].gpio);
+
+			if (line >= 0)
 			{
-				lseek(fdset[i].fd, 0, 0);
-
-				if ((nRead = read(fdset[i].fd, buf, sizeof(buf))) <= 0)
-				{
-					_logger->error("getTimeToDistance: failed to read GPIO FD %d on interrupt", i);
-
-					_bError = true;
-					break;
-				}
-
-				buf[nRead] = '\0';
-				if (atoi(buf))
-				{
-					ucState = 1;
-				}
-				else
-				{
-					ucState = 0;
-				}
-
-				switch (i)
-				{
-					case 0:
-						ucA = ucState;
-						break;
-
-					case 1:
-						ucB = ucState;
-						break;
-				}
+				levels[line] = events[i].level;
 			}
 
+			// Only decode once all of the edges that happened together have been applied, and only for our wheel
+			if ((i + 1 < nEvents && events[i + 1].timestampNs == events[i].timestampNs) || (line != lineA && line != lineB))
+			{
+				continue;
+			}
+
+			state = QuadratureDecoder::state(levels[lineA], levels[lineB]);
+
 			/**
 			 * What's happening to the wheel?
 			 *
 			 * NOTE: These depend on which GPIOs each sensor is connected to. If the wires are around the wrong way
 			 * we will count backwards when we the wheels are going forwards and vice versa.
 			 */
-			if (ucA ^ ucLastB)
-			{
-				nCalibration++;
-			}
-			if (ucB ^ ucLastA)
-			{
-				nCalibration--;
-			}
+			entry         = QuadratureDecoder::transition(stateLast, state);
+			nCalibration += QUADRATURE_DELTA(entry);
 
-//			_logger->debug("getTimeToDistance: CALIBRATION [%d %d] => %d", ucA, ucB, nCalibration);
+			LOGGER_DEBUG(_logger, "getTimeToDistance: CALIBRATION [%d %d] => %d", levels[lineA], levels[lineB], nCalibration);
 
 			/**
 			 * We can't see state transitions on both channels, that's an invalid transition for the gray code. However,
 			 * it IS valid to see this on the FIRST tick because we don't actually know our starting state.
 			 */
-			if (ucA != ucLastA && ucB != ucLastB && ! firstRevolution)
+			if (QUADRATURE_INVALID(entry) && ! firstRevolution)
 			{
 				_logger->error("getTimeToDistance: invalid transition detected");
 				_bError = true;
 			}
 
-			ucLastA  = ucA;
-			ucLastB  = ucB;
+			stateLast = state;
 
 			firstRevolution = false;
 		}
@@ -544,9 +881,6 @@ unsigned long Odometer::getTimeToDistance(bool wheelLeft, bool forward, int revo
 		_bError = true;
 	}
 
-	gpio_fd_close(fdA);
-	gpio_fd_close(fdB);
-
 	if (_bError)
 	{
 		_logger->notice("getTimeToDistance: calibration completed with errors");
@@ -7,43 +7,129 @@
  *
  * Uses the BBB GPIO pins as inputs to look for rising and falling edges from the optical encoders attached to the
  * wheels and then determines the distance traveled based on the number of revolutions turned and the wheel radius.
+ *
+ * Edges come from a GpioEdgeSource, the backend (sysfs, GPIO character device or mock) is selected at runtime.
  */
 
 #ifndef _ODO_H_INCLUDED
 #define _ODO_H_INCLUDED
 
-#define ODO_TICKS_PER_REVOLUTION 48.0
+#define ODO_EVENT_BATCH          64             // most edges taken from the edge source per read
+#define ODO_ERROR_REPORT_NS      1000000000ULL  // invalid transitions are logged at most this often
+
+// Velocity estimation
+#define ODO_EDGE_RING               64                  // edges remembered per wheel (power of 2)
+#define ODO_VELOCITY_EDGES          4                   // inter-edge periods averaged when the wheel is turning quickly
+#define ODO_VELOCITY_PERIOD_MAX_NS  50000000ULL         // slower than one tick per this, count ticks over a window instead
+#define ODO_VELOCITY_WINDOW_NS      500000000ULL        // window for counting ticks at low speed
+
+// Index of each encoder line in the set handed to the edge source
+#define ODO_LINE_LEFT_A     0
+#define ODO_LINE_LEFT_B     1
+#define ODO_LINE_RIGHT_A    2
+#define ODO_LINE_RIGHT_B    3
+#define ODO_LINES           4
+
+#include <atomic>
+#include <pthread.h>
+
+#include "seqlock.h"
+#include "edgering.h"
+#include "edgerecord.h"
+#include "latency.h"
+#include "robotprofile.h"
+
+/**
+ * A consistent view of the odometry, all fields are from the same instant.
+ */
+struct OdometrySnapshot
+{
+	int					odoLeft;		// ticks since reset
+	int					odoRight;
+	unsigned int		errorsLeft;		// invalid gray code transitions since reset
+	unsigned int		errorsRight;
+	unsigned long long	timestampNs;	// edge source timestamp (CLOCK_MONOTONIC) of the last edge decoded, 0 if none yet
+};
+
+/**
+ * The totals as published, with the totals at the last reset so that a reader never mixes the two across a reset
+ */
+struct OdometryPublished
+{
+	OdometrySnapshot	counts;
+	OdometrySnapshot	base;
+};
 
 class Logger;
+class PoseEstimator;
 
 class Odometer
 {
 	private:
 		// Physics
-		unsigned int	_wheelRadius;	// in centimeters
+		double			_wheelRadius;			// in centimeters
+		double			_ticksPerRevolution;
 
 		// The GPIO #s that we can read the optical encoder state for each wheel from
 		unsigned int	_leftGPIOA, _leftGPIOB;
 		unsigned int	_rightGPIOA, _rightGPIOB;
 
-		// The actual odometry for each wheel
-		int				_odoLeft;
-		int				_odoRight;
+		// Running totals of ticks and errors for each wheel, only ever written by the thread decoding edges
+		OdometrySnapshot	_counts;
+
+		// The totals as last published by the decoding thread and the totals at the last reset. Both the decoding thread
+		// and reset() store them, under the publish lock (the seqlock only takes one writer at a time).
+		SeqLock<OdometryPublished>	_published;
+		OdometrySnapshot			_base;
+		pthread_mutex_t				_publishLock;
+
+		// Invalid transitions as of the last time they were logged, and when that was (edge source time)
+		unsigned int		_errorsReported;
+		unsigned long long	_errorsReportedNs;
+
+		// Encoder levels and each wheel's gray code state as of the last edge decoded
+		unsigned char	_levels[ODO_LINES];
+		unsigned int	_stateLeftPrev, _stateRightPrev;
 
-		// The number of errors (since reset) for each wheel
-		unsigned int	_errorsLeft;
-		unsigned int	_errorsRight;
+		// Every edge that moved each wheel, for velocity estimation
+		EdgeRing<ODO_EDGE_RING>	_edgesLeft;
+		EdgeRing<ODO_EDGE_RING>	_edgesRight;
 
 		// Should the odometry thread exit?
-		bool			_bRun;
+		std::atomic<bool>	_bRun;
 
 		// Did an error occur that stopped the thread?
-		bool			_bError;
+		std::atomic<bool>	_bError;
+
+		// The odometry thread, if it has been started and not yet joined
+		pthread_t		_thread;
+		bool			_bThreadStarted;
+
+		// Where the encoder edges come from, and should we delete it?
+		GpioEdgeSource *	_edgeSource;
+		bool			_bOwnEdgeSource;
+
+		// Integrates the pose on every transition, if set
+		PoseEstimator *	_poseEstimator;
+
+		// How long after an edge the thread got to see it
+		LatencyHistogram	_wakeupLatency;
+
+		// Raw edges are recorded here when recording
+		EdgeRecorder	_recorder;
 
 		Logger *		_logger;
 
+		int     getLineIndex(unsigned int gpio);
+		void    join();
+		void    setLevels(const unsigned char *levels);
+		void    decode(const GpioEdgeEvent *events, int nEvents);
+		void    publish();
+		double  getWheelVelocity(const EdgeRing<ODO_EDGE_RING> &edges, unsigned long long nowNs);
+
 	public:
-		Odometer(unsigned int wheelLeftGPIOA, unsigned int wheelLeftGPIOB, unsigned int wheelRightGPIOA, unsigned int wheelRightGPIOB, unsigned int wheelRadius);
+		Odometer(unsigned int wheelLeftGPIOA, unsigned int wheelLeftGPIOB, unsigned int wheelRightGPIOA, unsigned int wheelRightGPIOB, double wheelRadius, double ticksPerRevolution, GpioEdgeSource *edgeSource = NULL);
+		Odometer(const RobotProfile &profile, GpioEdgeSource *edgeSource = NULL);
 		~Odometer();
 
 		void    reset();
@@ -52,12 +138,23 @@ class Odometer
 		void    stop();
 		void *  thread();
 
+		int     setPoseEstimator(PoseEstimator *poseEstimator);
+
+		int     record(const char *filename, unsigned int bufferSize = EDGE_RECORD_BUFFER);
+		long    replay(const EdgeRecording &recording);
+
 		unsigned long getTimeToDistance(bool wheelLeft, bool forward, int revolutions, int speed);
 
+		OdometrySnapshot getSnapshot();
+
 		void    getOdometry(int *wheelLeft, int *wheelRight);
 		void    getDistance(double *wheelLeft, double *wheelRight);
+		void    getDistance(const OdometrySnapshot &snapshot, double *wheelLeft, double *wheelRight);
+		void    getVelocity(double *wheelLeft, double *wheelRight, unsigned long long nowNs = 0);
 		void    getErrorCount(unsigned int *wheelLeft, unsigned int *wheelRight);
 		bool    getRunning();
+
+		const LatencyHistogram & getWakeupLatency() const	{ return _wakeupLatency; }
 		bool    getError();
 };
 
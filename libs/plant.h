@@ -0,0 +1,35 @@
+/**
+ * plant.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Interface for something the controller can drive in place of the real motors, encoders and clock (ie. a simulation).
+ *
+ * The controller commands each motor with the same duty cycle percentage it would give pwm_speed(), reads back how far
+ * each wheel has turned and then lets the plant's clock advance by one control period rather than sleeping.
+ */
+
+#ifndef _PLANT_H_INCLUDED
+#define _PLANT_H_INCLUDED
+
+class PoseEstimator;
+
+class Plant
+{
+	public:
+		virtual ~Plant() {}
+
+		// Step this with every encoder transition, as the odometry thread would (see odo.h)
+		virtual void				setPoseEstimator(PoseEstimator *poseEstimator) = 0;
+
+		virtual void				drive(unsigned int motor, bool forward, unsigned int duty) = 0;
+		virtual void				stop() = 0;
+
+		virtual void				resetDistance() = 0;
+		virtual void				getDistance(double *wheelLeft, double *wheelRight) = 0;
+
+		virtual unsigned long long	advance(unsigned long long periodNs) = 0;
+		virtual unsigned long long	getTimeNs() = 0;
+};
+
+#endif // _PLANT_H_INCLUDED
@@ -0,0 +1,337 @@
+/**
+ * plantsim.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "plantsim.h"
+#include "poseestimator.h"
+#include "poseintegrator.h"
+#include "motorlib.h"
+#include "odo.h"
+
+/**
+ * @param unsigned int * state
+ * @param double		 spread
+ *
+ * @return double	uniform in [1 - spread, 1 + spread]
+ */
+static double plantsim_vary(unsigned int *state, double spread)
+{
+	return 1.0 + spread * ((2.0 * rand_r(state) / RAND_MAX) - 1.0);
+}
+
+/**
+ * ctor
+ *
+ * @param SimulatedPlantParams & params
+ */
+SimulatedPlant::SimulatedPlant(const SimulatedPlantParams &params)
+{
+	Pose origin;
+
+	_params          = params;
+	_distancePerTick = (2.0 * M_PI * _params.wheelRadius) / _params.ticksPerRevolution;
+	_poseEstimator   = NULL;
+
+	memset(&origin, 0, sizeof(origin));
+	reset(origin);
+}
+
+/**
+ * SimulatedPlant::getDefaultParams - a robot as built, with the wheels matched and a little noise
+ *
+ * @param RobotProfile & profile	its wheels and encoders
+ *
+ * @return SimulatedPlantParams
+ */
+SimulatedPlantParams SimulatedPlant::getDefaultParams(const RobotProfile &profile)
+{
+	SimulatedPlantParams params;
+
+	params.wheelRadius        = profile.wheelRadius;
+	params.wheelbase          = profile.wheelbase;
+	params.ticksPerRevolution = profile.ticksPerRevolution;
+
+	// The inverse of the controller's default velocity to PWM fits
+	params.motors[MOTOR_LEFT].gain      = 0.1103;
+	params.motors[MOTOR_LEFT].offset    = 0.2833;
+	params.motors[MOTOR_LEFT].deadband  = 12.0;
+	params.motors[MOTOR_LEFT].scale     = 1.0;
+
+	params.motors[MOTOR_RIGHT].gain     = 0.10263;
+	params.motors[MOTOR_RIGHT].offset   = 0.2395;
+	params.motors[MOTOR_RIGHT].deadband = 12.0;
+	params.motors[MOTOR_RIGHT].scale    = 1.0;
+
+	params.timeConstant = 0.15;
+	params.slipNoise    = 0.02;
+	params.tickDropRate = 0.0;
+
+	params.seed = 1;
+
+	return params;
+}
+
+/**
+ * SimulatedPlant::getVariedParams - a slightly different robot every call (motor mismatch, deadband and lag), these are
+ * the robots demo_sim, demo_batch and tune fly for a seed
+ *
+ * @param RobotProfile & profile	the robot they are variations of
+ * @param unsigned int * seed		rand_r() state, advanced
+ *
+ * @return SimulatedPlantParams
+ */
+SimulatedPlantParams SimulatedPlant::getVariedParams(const RobotProfile &profile, unsigned int *seed)
+{
+	SimulatedPlantParams params = getDefaultParams(profile);
+
+	params.motors[MOTOR_LEFT].scale     = plantsim_vary(seed, 0.05);
+	params.motors[MOTOR_RIGHT].scale    = plantsim_vary(seed, 0.05);
+	params.motors[MOTOR_LEFT].deadband *= plantsim_vary(seed, 0.25);
+	params.motors[MOTOR_RIGHT].deadband *= plantsim_vary(seed, 0.25);
+	params.timeConstant                *= plantsim_vary(seed, 0.30);
+	params.seed                         = rand_r(seed) + 1;
+
+	return params;
+}
+
+/**
+ * SimulatedPlant::reset - stop, put the robot at a pose and start the clock again
+ *
+ * @param Pose & pose
+ *
+ * @return void
+ */
+void SimulatedPlant::reset(const Pose &pose)
+{
+	_timeNs = PLANTSIM_EPOCH_NS;
+	_random = _params.seed ? _params.seed : 1;
+
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		_duty[i]      = 0;
+		_velocity[i]  = 0.0;
+		_travel[i]    = 0.0;
+		_ticks[i]     = 0;
+		_ticksBase[i] = 0;
+	}
+
+	_truePose           = pose;
+	_truePose.timestamp = 0;
+	_trueDistance       = 0.0;
+}
+
+/**
+ * SimulatedPlant::setPoseEstimator
+ *
+ * @param PoseEstimator * poseEstimator		NULL to stop stepping one
+ *
+ * @return void
+ */
+void SimulatedPlant::setPoseEstimator(PoseEstimator *poseEstimator)
+{
+	_poseEstimator = poseEstimator;
+}
+
+/**
+ * SimulatedPlant::drive - as motor_forward() / motor_reverse()
+ *
+ * @param unsigned int motor	MOTOR_LEFT or MOTOR_RIGHT
+ * @param bool		   forward
+ * @param unsigned int duty		% duty cycle, as given to pwm_speed()
+ *
+ * @return void
+ */
+void SimulatedPlant::drive(unsigned int motor, bool forward, unsigned int duty)
+{
+	if (motor > MOTOR_RIGHT)
+	{
+		return;
+	}
+
+	duty = duty > 100 ? 100 : duty;
+
+	_duty[motor] = forward ? duty : -static_cast<int>(duty);
+}
+
+/**
+ * SimulatedPlant::stop - as bot_stop(), the wheels still take time to spin down
+ *
+ * @return void
+ */
+void SimulatedPlant::stop()
+{
+	_duty[MOTOR_LEFT] = _duty[MOTOR_RIGHT] = 0;
+}
+
+/**
+ * SimulatedPlant::resetDistance - as Odometer::reset()
+ *
+ * @return void
+ */
+void SimulatedPlant::resetDistance()
+{
+	_ticksBase[MOTOR_LEFT]  = _ticks[MOTOR_LEFT];
+	_ticksBase[MOTOR_RIGHT] = _ticks[MOTOR_RIGHT];
+}
+
+/**
+ * SimulatedPlant::getDistance - as Odometer::getDistance(), what the encoders say (in centimeters)
+ *
+ * @param double * wheelLeft
+ * @param double * wheelRight
+ *
+ * @return void
+ */
+void SimulatedPlant::getDistance(double *wheelLeft, double *wheelRight)
+{
+	*wheelLeft  = (_ticks[MOTOR_LEFT]  - _ticksBase[MOTOR_LEFT])  * _distancePerTick;
+	*wheelRight = (_ticks[MOTOR_RIGHT] - _ticksBase[MOTOR_RIGHT]) * _distancePerTick;
+}
+
+/**
+ * SimulatedPlant::advance - run the physics for a period of virtual time
+ *
+ * @param unsigned long long periodNs
+ *
+ * @return unsigned long long	the time that passed (ns), as LoopTimer::wait()
+ */
+unsigned long long SimulatedPlant::advance(unsigned long long periodNs)
+{
+	unsigned long long remainingNs = periodNs;
+
+	while (remainingNs > 0)
+	{
+		unsigned long long stepNs = remainingNs < PLANTSIM_STEP_NS ? remainingNs : PLANTSIM_STEP_NS;
+
+		step(stepNs);
+
+		remainingNs -= stepNs;
+	}
+
+	if (_poseEstimator)
+	{
+		_poseEstimator->publish();
+	}
+
+	return periodNs;
+}
+
+/**
+ * SimulatedPlant::random - xorshift64*, cheap and repeatable
+ *
+ * @return double	uniform in [0, 1)
+ */
+double SimulatedPlant::random()
+{
+	_random ^= _random >> 12;
+	_random ^= _random << 25;
+	_random ^= _random >> 27;
+
+	return ((_random * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * SimulatedMotor::getVelocity - the speed the wheel settles at for a duty cycle
+ *
+ * @param int duty	% duty cycle, negative in reverse
+ *
+ * @return double	cm/s, negative in reverse
+ */
+double SimulatedMotor::getVelocity(int duty) const
+{
+	double magnitude = fabs(static_cast<double>(duty));
+	double velocity;
+
+	if (magnitude < deadband)
+	{
+		return 0.0;
+	}
+
+	velocity = (gain * magnitude - offset) * scale;
+	velocity = velocity < 0.0 ? 0.0 : velocity;
+
+	return duty < 0 ? -velocity : velocity;
+}
+
+/**
+ * SimulatedPlant::getTargetVelocity - the speed a wheel settles at for its current duty cycle
+ *
+ * @param unsigned int motor
+ *
+ * @return double	cm/s, negative in reverse
+ */
+double SimulatedPlant::getTargetVelocity(unsigned int motor)
+{
+	return _params.motors[motor].getVelocity(_duty[motor]);
+}
+
+/**
+ * SimulatedPlant::step - one physics step
+ *
+ * @param unsigned long long stepNs
+ *
+ * @return void
+ */
+void SimulatedPlant::step(unsigned long long stepNs)
+{
+	double dt    = stepNs / 1000000000.0;
+	double alpha = dt / (_params.timeConstant + dt);
+	double dist[2];
+	int    delta[2];
+
+	_timeNs += stepNs;
+
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		int ticks;
+
+		_velocity[i] += (getTargetVelocity(i) - _velocity[i]) * alpha;
+
+		dist[i] = _velocity[i] * dt;
+
+		if (_params.slipNoise > 0.0)
+		{
+			dist[i] *= 1.0 + _params.slipNoise * (2.0 * random() - 1.0);
+		}
+
+		// The encoder ticks each time the wheel turns through another tick's worth
+		_travel[i] += dist[i] / _distancePerTick;
+		ticks       = static_cast<int>(floor(_travel[i]));
+		delta[i]    = 0;
+
+		while (ticks != _ticks[i] + delta[i])
+		{
+			int direction = ticks > _ticks[i] + delta[i] ? 1 : -1;
+
+			if (_params.tickDropRate > 0.0 && random() < _params.tickDropRate)
+			{
+				// Missed: the encoder carries on counting from here
+				_travel[i] -= direction;
+				ticks      -= direction;
+				continue;
+			}
+
+			delta[i] += direction;
+		}
+
+		_ticks[i] += delta[i];
+	}
+
+	// Each step's ticks as one transition, as if they'd come in the same batch
+	if (_poseEstimator && (delta[MOTOR_LEFT] != 0 || delta[MOTOR_RIGHT] != 0))
+	{
+		_poseEstimator->step(delta[MOTOR_LEFT], delta[MOTOR_RIGHT], _timeNs);
+	}
+
+	// The true pose moves along the arc the wheels actually travelled
+	_trueDistance += fabs((dist[MOTOR_LEFT] + dist[MOTOR_RIGHT]) / 2.0);
+
+	pose_integrate(&_truePose, dist[MOTOR_LEFT], dist[MOTOR_RIGHT], _params.wheelbase, POSE_INTEGRATION_ARC);
+	_truePose.timestamp = (_timeNs - PLANTSIM_EPOCH_NS) / 1000000;
+}
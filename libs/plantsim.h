@@ -0,0 +1,104 @@
+/**
+ * plantsim.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * A differential drive robot simulated on a virtual clock, for running the controller faster than real time.
+ *
+ * Each motor turns a duty cycle into a wheel speed along a straight line fit (as measured on the floor, see
+ * Controller::convertVelocityToPWMPercentage), with:
+ *
+ * - a deadband: below it the wheel doesn't turn at all
+ * - a per-wheel gain, so the two wheels don't match
+ * - first order lag towards that speed
+ * - slip noise on every step
+ *
+ * The wheels turn encoders with the profile's ticks per revolution, which step a PoseEstimator exactly as the odometry
+ * thread would, and can drop ticks. The robot's true pose is integrated separately (exactly, along the arc) so the
+ * estimate can be compared against it.
+ */
+
+#ifndef _PLANTSIM_H_INCLUDED
+#define _PLANTSIM_H_INCLUDED
+
+#include "plant.h"
+#include "poseprovider.h"
+#include "robotprofile.h"
+
+#define PLANTSIM_STEP_NS    1000000ULL          // physics step, 1ms
+#define PLANTSIM_EPOCH_NS   1000000000ULL       // the virtual clock starts here (0 means "no timestamp" elsewhere)
+
+struct SimulatedMotor
+{
+	double	gain;			// cm/s per % duty cycle
+	double	offset;			// cm/s subtracted from that
+	double	deadband;		// % duty cycle below which the wheel doesn't turn
+	double	scale;			// mismatch, multiplies the speed (1.0 for a perfect motor)
+
+	double	getVelocity(int duty) const;
+};
+
+struct SimulatedPlantParams
+{
+	double			wheelRadius;		// in centimeters
+	double			wheelbase;			// in centimeters
+	double			ticksPerRevolution;
+
+	SimulatedMotor	motors[2];			// indexed by MOTOR_LEFT, MOTOR_RIGHT
+
+	double			timeConstant;		// seconds for a wheel to get ~63% of the way to a new speed
+	double			slipNoise;			// each step's wheel travel is scaled by a uniform 1 +/- this
+	double			tickDropRate;		// probability an encoder tick is missed
+
+	unsigned long long	seed;			// for the noise, the same seed gives the same run
+};
+
+class SimulatedPlant : public Plant
+{
+	private:
+		SimulatedPlantParams	_params;
+		double				_distancePerTick;
+
+		unsigned long long	_timeNs;
+		unsigned long long	_random;
+
+		int					_duty[2];			// signed, negative is reverse
+		double				_velocity[2];		// cm/s
+		double				_travel[2];			// encoder position in (fractional) ticks
+		int					_ticks[2];			// whole ticks counted by the encoder
+		int					_ticksBase[2];		// _ticks at the last resetDistance()
+
+		Pose				_truePose;
+		double				_trueDistance;		// path length the robot actually covered (cm)
+
+		PoseEstimator *		_poseEstimator;
+
+		double				random();
+		double				getTargetVelocity(unsigned int motor);
+		void				step(unsigned long long stepNs);
+
+	public:
+		SimulatedPlant(const SimulatedPlantParams &params);
+
+		static SimulatedPlantParams getDefaultParams(const RobotProfile &profile = ROBOT_PROFILE_OROBOTO);
+		static SimulatedPlantParams getVariedParams(const RobotProfile &profile, unsigned int *seed);
+
+		void				reset(const Pose &pose);
+
+		void				setPoseEstimator(PoseEstimator *poseEstimator);
+
+		void				drive(unsigned int motor, bool forward, unsigned int duty);
+		void				stop();
+
+		void				resetDistance();
+		void				getDistance(double *wheelLeft, double *wheelRight);
+
+		unsigned long long	advance(unsigned long long periodNs);
+		unsigned long long	getTimeNs()				{ return _timeNs; }
+
+		Pose				getTruePose() const		{ return _truePose; }
+		double				getTrueDistance() const	{ return _trueDistance; }
+		void				getTicks(int *wheelLeft, int *wheelRight) const	{ *wheelLeft = _ticks[0]; *wheelRight = _ticks[1]; }
+};
+
+#endif // _PLANTSIM_H_INCLUDED
@@ -0,0 +1,56 @@
+/**
+ * poseestimator.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "poseestimator.h"
+
+/**
+ * ctor
+ *
+ * @param double wheelRadius			in centimeters
+ * @param double wheelbase			distance between the wheels in centimeters
+ * @param double ticksPerRevolution	encoder ticks per turn of a wheel
+ */
+PoseEstimator::PoseEstimator(double wheelRadius, double wheelbase, double ticksPerRevolution)
+{
+	Pose origin;
+
+	_distancePerTick = (2.0 * M_PI * wheelRadius) / ticksPerRevolution;
+	_wheelbase       = wheelbase;
+	_integration     = POSE_INTEGRATION_ARC;
+
+	memset(&origin, 0, sizeof(origin));
+	reset(origin);
+}
+
+/**
+ * PoseEstimator::reset - start integrating from a known pose
+ *
+ * This must not be called while the odometry thread may be calling step().
+ *
+ * @param Pose &			 pose
+ * @param unsigned long long originNs		the time pose timestamps are measured from (0 for CLOCK_MONOTONIC now)
+ *
+ * @return void
+ */
+void PoseEstimator::reset(const Pose &pose, unsigned long long originNs)
+{
+	if (originNs == 0)
+	{
+		struct timespec ts;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		originNs = (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+	}
+
+	_pose      = pose;
+	_originNs  = originNs;
+	_steps     = 0;
+
+	publish();
+}
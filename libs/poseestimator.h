@@ -0,0 +1,70 @@
+/**
+ * poseestimator.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Dead reckoning of the robot's pose from wheel encoder ticks, integrated on every decoded transition rather than once
+ * per control loop iteration.
+ *
+ * Each transition moves the pose along the arc the wheels travelled (see poseintegrator.h), or with a cheaper
+ * integration if setIntegration() asks for one.
+ *
+ * The odometry thread is the only writer: it calls step() for each transition that moved a wheel and publish() once per
+ * batch of edges. Any thread can read the last published pose with getCurrentPose(), which never blocks the odometry
+ * thread (see poseprovider.h).
+ */
+
+#ifndef _POSEESTIMATOR_H_INCLUDED
+#define _POSEESTIMATOR_H_INCLUDED
+
+#include <math.h>
+
+#include "poseprovider.h"
+#include "poseintegrator.h"
+
+class PoseEstimator : public PoseProvider
+{
+	private:
+		double				_distancePerTick;	// in centimeters
+		double				_wheelbase;			// in centimeters
+		PoseIntegration		_integration;
+
+		Pose				_pose;				// the writer's working pose
+		unsigned long long	_originNs;			// pose timestamps are in ms since this (edge source clock)
+		unsigned long		_steps;
+
+	public:
+		PoseEstimator(double wheelRadius, double wheelbase, double ticksPerRevolution);
+
+		void	reset(const Pose &pose, unsigned long long originNs = 0);
+
+		/**
+		 * Move the pose by one encoder transition (writer only).
+		 *
+		 * @param int				 ticksLeft		ticks the left wheel moved (usually -1, 0 or 1)
+		 * @param int				 ticksRight		ticks the right wheel moved
+		 * @param unsigned long long timestampNs	when the transition happened (edge source clock)
+		 */
+		inline void step(int ticksLeft, int ticksRight, unsigned long long timestampNs)
+		{
+			pose_integrate(&_pose, ticksLeft * _distancePerTick, ticksRight * _distancePerTick, _wheelbase, _integration);
+
+			if (timestampNs > _originNs)
+			{
+				_pose.timestamp = (timestampNs - _originNs) / 1000000;
+			}
+
+			_steps++;
+		}
+
+		/**
+		 * Make the steps so far visible to readers (writer only).
+		 */
+		void	publish()					{ publishPose(_pose); }
+
+		void	setIntegration(PoseIntegration integration)	{ _integration = integration; }
+
+		unsigned long getSteps() const	{ return _steps; }
+};
+
+#endif // _POSEESTIMATOR_H_INCLUDED
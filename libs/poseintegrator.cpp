@@ -0,0 +1,49 @@
+/**
+ * poseintegrator.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <string.h>
+
+#include "poseintegrator.h"
+
+/**
+ * pose_integration_error - how far an integration drifts driving at constant wheel speeds
+ *
+ * The robot starts at the origin and drives for nSteps steps. The reference drives the same path with each step split
+ * into nSubsteps Euler steps, which converges on the true arc as nSubsteps grows.
+ *
+ * @param PoseIntegration integration
+ * @param double		  velocityLeft		cm/s
+ * @param double		  velocityRight		cm/s
+ * @param double		  wheelbase			cm
+ * @param double		  stepS				length of a step in seconds (ie. one control loop period)
+ * @param unsigned int	  nSteps
+ * @param unsigned int	  nSubsteps			for the reference
+ *
+ * @return double	distance between the two final positions (cm)
+ */
+double pose_integration_error(PoseIntegration integration, double velocityLeft, double velocityRight, double wheelbase, double stepS, unsigned int nSteps, unsigned int nSubsteps)
+{
+	Pose pose, reference;
+
+	memset(&pose, 0, sizeof(pose));
+	memset(&reference, 0, sizeof(reference));
+
+	nSubsteps = nSubsteps > 0 ? nSubsteps : 1;
+
+	double subS = stepS / nSubsteps;
+
+	for (unsigned int i = 0; i < nSteps; i++)
+	{
+		pose_integrate(&pose, velocityLeft * stepS, velocityRight * stepS, wheelbase, integration);
+
+		for (unsigned int j = 0; j < nSubsteps; j++)
+		{
+			pose_integrate(&reference, velocityLeft * subS, velocityRight * subS, wheelbase, POSE_INTEGRATION_EULER);
+		}
+	}
+
+	return hypot(pose.x - reference.x, pose.y - reference.y);
+}
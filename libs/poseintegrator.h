@@ -0,0 +1,89 @@
+/**
+ * poseintegrator.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Moves a pose by the distance each wheel of a differential drive travelled in one step.
+ *
+ * Over a step the robot really travels along an arc (a straight line if the wheels moved the same distance). How
+ * closely the pose follows it depends on the integration:
+ *
+ * - POSE_INTEGRATION_EULER moves in a straight line at the heading from before the step, which cuts inside every turn
+ *   by an amount that grows with the square of the step.
+ * - POSE_INTEGRATION_MIDPOINT (RK2) moves in a straight line at the heading halfway through the step, the error is
+ *   third order in the step.
+ * - POSE_INTEGRATION_ARC moves along the arc's chord, which is exact whenever the wheels kept the same ratio of speeds
+ *   through the step. It costs one more sin() than the midpoint.
+ *
+ * pose_integration_error() measures an integration against a reference made of many much smaller steps, see
+ * demo_bench.
+ */
+
+#ifndef _POSEINTEGRATOR_H_INCLUDED
+#define _POSEINTEGRATOR_H_INCLUDED
+
+#include <math.h>
+
+#include "poseprovider.h"
+
+enum PoseIntegration
+{
+	POSE_INTEGRATION_EULER,
+	POSE_INTEGRATION_MIDPOINT,
+	POSE_INTEGRATION_ARC
+};
+
+/**
+ * Move a pose by one step. The heading is kept in (-pi, pi], the step must turn the robot by less than a revolution.
+ *
+ * @param Pose *		  pose
+ * @param double		  distLeft		distance the left wheel travelled (cm, negative in reverse)
+ * @param double		  distRight		distance the right wheel travelled
+ * @param double		  wheelbase		distance between the wheels (cm)
+ * @param PoseIntegration integration
+ */
+inline void pose_integrate(Pose *pose, double distLeft, double distRight, double wheelbase, PoseIntegration integration)
+{
+	double dist = (distLeft + distRight) / 2.0;
+	double turn = (distRight - distLeft) / wheelbase;
+
+	switch (integration)
+	{
+		case POSE_INTEGRATION_EULER:
+			pose->x += dist * cos(pose->heading);
+			pose->y += dist * sin(pose->heading);
+			break;
+
+		case POSE_INTEGRATION_MIDPOINT:
+			pose->x += dist * cos(pose->heading + turn / 2.0);
+			pose->y += dist * sin(pose->heading + turn / 2.0);
+			break;
+
+		case POSE_INTEGRATION_ARC:
+		{
+			// The chord of an arc of length dist turning through turn is dist * sin(turn/2) / (turn/2) long and points
+			// halfway round it. sin(h)/h loses precision as h goes to 0, where its series is exact enough.
+			double half  = turn / 2.0;
+			double chord = fabs(half) < 1e-4 ? dist * (1.0 - (half * half) / 6.0) : dist * sin(half) / half;
+
+			pose->x += chord * cos(pose->heading + half);
+			pose->y += chord * sin(pose->heading + half);
+			break;
+		}
+	}
+
+	pose->heading += turn;
+
+	if (pose->heading > M_PI)
+	{
+		pose->heading -= 2.0 * M_PI;
+	}
+	else if (pose->heading <= -M_PI)
+	{
+		pose->heading += 2.0 * M_PI;
+	}
+}
+
+double pose_integration_error(PoseIntegration integration, double velocityLeft, double velocityRight, double wheelbase, double stepS, unsigned int nSteps, unsigned int nSubsteps);
+
+#endif // _POSEINTEGRATOR_H_INCLUDED
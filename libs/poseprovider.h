@@ -9,6 +9,8 @@
 #ifndef _POSEPROVIDER_H_INCLUDED
 #define _POSEPROVIDER_H_INCLUDED
 
+#include "seqlock.h"
+
 struct Pose {
 	double 			x;
 	double 			y;
@@ -16,10 +18,23 @@ struct Pose {
 	unsigned long	timestamp;
 };
 
+/**
+ * A provider publishes each new pose as a whole with publishPose() (from one thread), and getCurrentPose() returns the
+ * last one published. Readers on other threads always get a consistent Pose, never fields from two different updates,
+ * and never block the publisher (see seqlock.h).
+ */
 class PoseProvider
 {
+	private:
+		SeqLock<Pose>	_publishedPose;
+
+	protected:
+		void			publishPose(const Pose &pose)	{ _publishedPose.store(pose); }
+
 	public:
-		virtual Pose getCurrentPose() = 0;
+		virtual			~PoseProvider()					{}
+
+		virtual Pose	getCurrentPose()				{ return _publishedPose.load(); }
 };
 
 #endif // _POSEPROVIDER_H_INCLUDED
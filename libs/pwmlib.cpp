@@ -7,12 +7,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
 
 #include "pwmlib.h"
 #include "logger.h"
 #include "sysfslib.h"
+#include "actuator.h"
 
 /**
  * Initialise the PWM subsystem.
@@ -65,8 +67,15 @@ int pwm_enable(int pwm)
             return -1;
     }
 
-    if (sysfs_write(SLOTS_FILE, pwmDriver) == 0)
+    int ret = sysfs_write(SLOTS_FILE, pwmDriver);
+
+    // CapeMgr refuses to load a cape that is already loaded
+    if (ret == 0 || ret == -EEXIST)
     {
+        // Loading the cape (re)creates the channel's control files
+        sysfs_invalidate(pwm_get_ctrl_file_prefix(pwm));
+        actuator_invalidate(pwm_get_ctrl_file_prefix(pwm));
+
         // Pull the PWM pin high by default
         pwm_set_period(pwm, PWM_DEFAULT_PERIOD);
         pwm_set_polarity(pwm, PWM_DEFAULT_POLARITY);
@@ -136,7 +145,8 @@ int pwm_set_duty(int pwm, int duty)
     snprintf(str_ctrl_file, sizeof(str_ctrl_file), "%s/%s", pwm_ctrl_file_prefix, DUTY_FILE);
     snprintf(str_duty, sizeof(str_duty), "%d", duty);
 
-    return sysfs_write(str_ctrl_file, str_duty);
+    // Duty cycles are changed on the control loop's hot path, let the actuator queue coalesce them
+    return actuator_write(str_ctrl_file, str_duty);
 }
 
 /**
@@ -15,6 +15,7 @@
 #define _PWMLIB_H_INCLUDED
 
 #define PWM_DRIVER          "am33xx_pwm"                // the name of the PWM cape
+#define PWM_CHANNELS        4                           // numbered 0 - 3
 #define PWM_0_DRIVER        "bone_pwm_P9_14"            // the PWM on P9_14
 #define PWM_1_DRIVER        "bone_pwm_P9_16"            // the PWM on P9_16
 #define PWM_2_DRIVER        "bone_pwm_P9_21"            // the PWM on P9_21
@@ -0,0 +1,143 @@
+/**
+ * quadrature.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Table-driven quadrature (gray code) decoder for the wheel encoders.
+ *
+ * A wheel's encoder state is the 2 bit value AB = (A << 1) | B. Every (previous AB, current AB) pair is looked up in a
+ * 16 entry table that gives both the change in count and whether the transition was invalid (both channels changed at
+ * once), so decoding a transition is a single load with no branches.
+ *
+ * The counting convention is the one the odometer has always used: count up when A differs from the previous B,
+ * count down when B differs from the previous A, so 00 -> 10 -> 11 -> 01 -> 00 counts up.
+ *
+ * Use QuadratureDecoder::transition() to decode live edges against state you keep yourself, or a QuadratureDecoder
+ * instance to decode a whole recorded trace with decode().
+ */
+
+#ifndef _QUADRATURE_H_INCLUDED
+#define _QUADRATURE_H_INCLUDED
+
+#define QUADRATURE_DELTA(entry)     (static_cast<int>((entry) & 3) - 1)     // -1, 0 or +1
+#define QUADRATURE_INVALID(entry)   ((entry) >> 2)                          // 1 if both channels changed
+
+class QuadratureDecoder
+{
+	private:
+		unsigned int	_state;		// last AB
+		int				_count;
+		unsigned int	_errors;
+
+	public:
+		QuadratureDecoder(unsigned int ab = 0)
+		{
+			reset(ab);
+		}
+
+		/**
+		 * Look up a transition. Each entry is (delta + 1) | (invalid << 2), see QUADRATURE_DELTA and QUADRATURE_INVALID.
+		 *
+		 * @param unsigned int prevAB
+		 * @param unsigned int curAB
+		 *
+		 * @return unsigned int
+		 */
+		static inline unsigned int transition(unsigned int prevAB, unsigned int curAB)
+		{
+			static const unsigned char table[16] = {
+				// cur:  00      01      10      11
+				         1,      0,      2,      5,        // prev 00
+				         2,      1,      5,      0,        // prev 01
+				         0,      5,      1,      2,        // prev 10
+				         5,      2,      0,      1         // prev 11
+			};
+
+			return table[((prevAB & 3) << 2) | (curAB & 3)];
+		}
+
+		/**
+		 * Build an AB state from the two channel levels.
+		 */
+		static inline unsigned int state(unsigned char a, unsigned char b)
+		{
+			return ((a & 1) << 1) | (b & 1);
+		}
+
+		/**
+		 * Start again from a known state.
+		 */
+		void reset(unsigned int ab = 0)
+		{
+			_state  = ab & 3;
+			_count  = 0;
+			_errors = 0;
+		}
+
+		/**
+		 * Decode one new state.
+		 *
+		 * @param unsigned int ab
+		 *
+		 * @return unsigned int		the table entry for the transition
+		 */
+		inline unsigned int step(unsigned int ab)
+		{
+			unsigned int entry = transition(_state, ab);
+
+			_state   = ab & 3;
+			_count  += QUADRATURE_DELTA(entry);
+			_errors += QUADRATURE_INVALID(entry);
+
+			return entry;
+		}
+
+		/**
+		 * Decode a recorded trace in bulk.
+		 *
+		 * @param Iterator first, last	the trace
+		 * @param ToState  toState		functor that turns *first into an AB state
+		 */
+		template <typename Iterator, typename ToState>
+		void decode(Iterator first, Iterator last, ToState toState)
+		{
+			unsigned int s      = _state;
+			int          count  = _count;
+			unsigned int errors = _errors;
+
+			for (; first != last; ++first)
+			{
+				unsigned int ab    = toState(*first);
+				unsigned int entry = transition(s, ab);
+
+				s       = ab & 3;
+				count  += QUADRATURE_DELTA(entry);
+				errors += QUADRATURE_INVALID(entry);
+			}
+
+			_state  = s;
+			_count  = count;
+			_errors = errors;
+		}
+
+		/**
+		 * Decode a trace of AB states in bulk.
+		 */
+		template <typename Iterator>
+		void decode(Iterator first, Iterator last)
+		{
+			decode(first, last, identity);
+		}
+
+		unsigned int	getState() const	{ return _state; }
+		int				getCount() const	{ return _count; }
+		unsigned int	getErrors() const	{ return _errors; }
+
+	private:
+		static inline unsigned int identity(unsigned int ab)
+		{
+			return ab;
+		}
+};
+
+#endif // _QUADRATURE_H_INCLUDED
@@ -0,0 +1,143 @@
+/**
+ * robotprofile.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "robotprofile.h"
+#include "gpio.h"
+#include "pwmlib.h"
+
+/**
+ * @param double	   value
+ * @param unsigned int limit
+ *
+ * @return bool	value is a whole number from 0 to limit - 1
+ */
+static bool robot_profile_is_index(double value, unsigned int limit)
+{
+	return value >= 0.0 && value < limit && value == floor(value);
+}
+
+/**
+ * RobotProfile::getDefaultFile
+ *
+ * @return const char *	$OROBOTO_PROFILE if it is set, otherwise ROBOT_PROFILE_FILE
+ */
+const char * RobotProfile::getDefaultFile()
+{
+	const char *filename = getenv(ROBOT_PROFILE_FILE_ENV);
+
+	return (filename && *filename) ? filename : ROBOT_PROFILE_FILE;
+}
+
+/**
+ * RobotProfile::load - nothing is changed unless the whole file can be read
+ *
+ * @param char * filename	NULL for getDefaultFile()
+ *
+ * @return int	0 or -errno (-EINVAL if the file has a line that isn't a known setting or doesn't make sense: a GPIO or
+ *				PWM that doesn't exist, a size, tick count or velocity that isn't positive, a negative gain, or an
+ *				approach velocity faster than cruising)
+ */
+int RobotProfile::load(const char *filename)
+{
+	RobotProfile profile = *this;
+	char         line[128], name[32];
+	double       v[4];
+	int          n, ret = 0;
+	FILE *       fp;
+
+	if (filename == NULL)
+	{
+		filename = getDefaultFile();
+	}
+
+	if ((fp = fopen(filename, "r")) == NULL)
+	{
+		return -errno;
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		if (line[0] == '#' || line[0] == '\n')
+		{
+			continue;
+		}
+
+		n = sscanf(line, "%31s %lf %lf %lf %lf", name, &v[0], &v[1], &v[2], &v[3]) - 1;
+
+		if (n == 1 && strcmp(name, "wheelradius") == 0 && v[0] > 0.0)
+		{
+			profile.wheelRadius = v[0];
+		}
+		else if (n == 1 && strcmp(name, "wheelbase") == 0 && v[0] > 0.0)
+		{
+			profile.wheelbase = v[0];
+		}
+		else if (n == 1 && strcmp(name, "ticks") == 0 && v[0] >= 1.0)
+		{
+			profile.ticksPerRevolution = v[0];
+		}
+		else if (n == 4 && strcmp(name, "encoders") == 0 && robot_profile_is_index(v[0], GPIO_MAX) && robot_profile_is_index(v[1], GPIO_MAX) && robot_profile_is_index(v[2], GPIO_MAX) && robot_profile_is_index(v[3], GPIO_MAX))
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				profile.encoderGpios[i] = static_cast<unsigned int>(v[i]);
+			}
+		}
+		else if (n == 4 && strcmp(name, "pwms") == 0 && robot_profile_is_index(v[0], PWM_CHANNELS) && robot_profile_is_index(v[1], PWM_CHANNELS) && robot_profile_is_index(v[2], PWM_CHANNELS) && robot_profile_is_index(v[3], PWM_CHANNELS))
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				profile.motorPwms[i / 2][i % 2] = static_cast<unsigned int>(v[i]);
+			}
+		}
+		else if (n == 1 && strcmp(name, "proportional") == 0 && v[0] >= 0.0)
+		{
+			profile.proportional = v[0];
+		}
+		else if (n == 1 && strcmp(name, "integral") == 0 && v[0] >= 0.0)
+		{
+			profile.integral = v[0];
+		}
+		else if (n == 1 && strcmp(name, "derivative") == 0 && v[0] >= 0.0)
+		{
+			profile.derivative = v[0];
+		}
+		else if (n == 1 && strcmp(name, "cruise") == 0 && v[0] > 0.0)
+		{
+			profile.cruiseVelocity = v[0];
+		}
+		else if (n == 1 && strcmp(name, "approach") == 0 && v[0] > 0.0)
+		{
+			profile.approachVelocity = v[0];
+		}
+		else
+		{
+			ret = -EINVAL;
+			break;
+		}
+	}
+
+	fclose(fp);
+
+	// As ROBOT_PROFILE_OROBOTO's static_asserts
+	if (ret == 0 && profile.approachVelocity > profile.cruiseVelocity)
+	{
+		ret = -EINVAL;
+	}
+
+	if (ret == 0)
+	{
+		*this = profile;
+	}
+
+	return ret;
+}
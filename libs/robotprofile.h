@@ -0,0 +1,79 @@
+/**
+ * robotprofile.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Everything that differs from one robot to the next: its geometry, which GPIOs its encoders are on, which PWMs drive
+ * its motors and the controller's default gains.
+ *
+ * ROBOT_PROFILE_OROBOTO is the robot as built and is constexpr, so its values are checked when compiling and can be used
+ * anywhere a constant can. A profile is an ordinary value though: copy one and load() a file over it to describe
+ * another robot at runtime, and give each Controller, Odometer, SimulatedPlant etc. the profile of the robot it is for.
+ * Simulated robots with different profiles can share one process. The real motors can't: motorlib drives one set for
+ * the whole process, with the PWMs of the profile given to motor_init().
+ *
+ * The file has one "<name> <value(s)>" line per setting, any not in the file keep the value they had:
+ *
+ *   wheelradius 2.0
+ *   wheelbase 9.0
+ *   ticks 48
+ *   encoders 30 31 66 67		(left A, left B, right A, right B)
+ *   pwms 1 0 3 2				(left A, left B, right A, right B)
+ *   proportional 0.9
+ *   integral 0.0005
+ *   derivative 0.0
+ *   cruise 9.0
+ *   approach 3.0
+ */
+
+#ifndef _ROBOTPROFILE_H_INCLUDED
+#define _ROBOTPROFILE_H_INCLUDED
+
+#include <math.h>
+
+#define ROBOT_PROFILE_FILE_ENV  "OROBOTO_PROFILE"   // environment variable naming a profile file
+#define ROBOT_PROFILE_FILE      "profile.txt"       // used when it isn't set
+
+struct RobotProfile
+{
+	double			wheelRadius;			// in centimeters
+	double			wheelbase;				// in centimeters, between the wheels
+	double			ticksPerRevolution;		// encoder ticks per turn of a wheel
+
+	unsigned int	encoderGpios[4];		// indexed by ODO_LINE_*, see odo.h
+	unsigned int	motorPwms[2][2];		// indexed by MOTOR_LEFT / MOTOR_RIGHT then MOTOR_PWM_A / MOTOR_PWM_B, see motorlib.h
+
+	double			proportional;			// the controller's default gains, see gains.h
+	double			integral;
+	double			derivative;
+	double			cruiseVelocity;
+	double			approachVelocity;
+
+	constexpr double getDistancePerTick() const		{ return (2.0 * M_PI * wheelRadius) / ticksPerRevolution; }
+
+	int		load(const char *filename = NULL);
+
+	static const char * getDefaultFile();
+};
+
+constexpr RobotProfile ROBOT_PROFILE_OROBOTO = {
+	2.0,					// wheel radius, ensure this matches
+	9.0,					// wheelbase
+	48.0,					// ticks per revolution
+
+	{ 30, 31, 66, 67 },		// encoders
+	{ { 1, 0 }, { 3, 2 } },	// the PWMs that connect to each motor's DRV8833 control signals, see pwmlib.h
+
+	0.90,					// proportional: contributes to stability and medium-rate responsiveness
+	0.0005,					// integral: tracking and disturbance rejection (slow-rate responsiveness, may cause oscillations)
+	0.00,					// derivative: fast-rate responsiveness, can cause overshoot: note 0.1 is safer
+
+	9.0,					// cruise velocity: 5.0 works as well but undershoots
+	3.0						// approach velocity: 3.0 works as well, safer
+};
+
+static_assert(ROBOT_PROFILE_OROBOTO.wheelRadius > 0.0 && ROBOT_PROFILE_OROBOTO.wheelbase > 0.0, "the robot needs wheels");
+static_assert(ROBOT_PROFILE_OROBOTO.ticksPerRevolution >= 1.0, "the encoders need to tick");
+static_assert(ROBOT_PROFILE_OROBOTO.approachVelocity <= ROBOT_PROFILE_OROBOTO.cruiseVelocity, "approach no faster than cruising");
+
+#endif // _ROBOTPROFILE_H_INCLUDED
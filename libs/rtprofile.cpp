@@ -0,0 +1,331 @@
+/**
+ * rtprofile.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "rtprofile.h"
+#include "logger.h"
+
+#define RT_PAGE_SIZE    4096        // the smallest page size, a stride that touches every page
+
+struct RtThreadGrant
+{
+	bool	entered;
+	int		schedError;		// 0 or errno from pthread_setschedparam()
+	int		cpuError;		// 0 or errno from pthread_setaffinity_np()
+	int		policy;			// what the thread ended up with
+	int		priority;
+};
+
+static const char *    gRtThreadNames[RT_THREADS] = { "odometry", "control", "actuator", "sonar", "led", "logger", "recorder" };
+
+// The encoder edges are the least tolerant of latency, then the control loop that consumes them and the actuator
+// writes it produces. The LED is cosmetic, and log messages and recorded edges wait in memory (see logger.h and
+// edgerecord.h) for as long as it takes. Nothing is pinned unless RT_CPU_ENV or rt_set_thread_config() says so.
+static RtThreadConfig  gRtConfig[RT_THREADS] = {
+	{ SCHED_FIFO,  80, -1 },    // odometry
+	{ SCHED_FIFO,  70, -1 },    // control
+	{ SCHED_FIFO,  60, -1 },    // actuator
+	{ SCHED_FIFO,  30, -1 },    // sonar
+	{ SCHED_OTHER,  0, -1 },    // led
+	{ SCHED_OTHER,  0, -1 },    // logger
+	{ SCHED_OTHER,  0, -1 }     // recorder
+};
+
+static RtThreadGrant   gRtGrants[RT_THREADS];
+
+static bool            gRtEnabled     = false;
+static bool            gRtInitialised = false;
+static int             gRtLockError   = -1;       // -1 not attempted, otherwise 0 or errno from mlockall()
+
+static pthread_mutex_t gRtLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @param int policy
+ *
+ * @return const char *
+ */
+static const char * rt_policy_name(int policy)
+{
+	switch (policy)
+	{
+		case SCHED_FIFO:  return "SCHED_FIFO";
+		case SCHED_RR:    return "SCHED_RR";
+		case SCHED_OTHER: return "SCHED_OTHER";
+		default:          return "?";
+	}
+}
+
+/**
+ * Touch the stack so that its pages are faulted in (and, after mlockall(), locked) before they are needed.
+ */
+static void __attribute__((noinline)) rt_prefault_stack()
+{
+	volatile unsigned char stack[RT_STACK_PREFAULT];
+
+	// A volatile store to every page, which (unlike a memset() of the array) can't be optimised away
+	for (unsigned int i = 0; i < sizeof(stack); i += RT_PAGE_SIZE)
+	{
+		stack[i] = 0;
+	}
+}
+
+/**
+ * Apply RT_CPU_ENV: a CPU for every SCHED_FIFO role, and/or role=cpu for any role (-1 for any CPU).
+ *
+ * @param char * env
+ *
+ * @return void
+ */
+static void rt_parse_cpus(const char *env)
+{
+	char  list[256];
+	char *save = NULL;
+
+	snprintf(list, sizeof(list), "%s", env);
+
+	for (char *item = strtok_r(list, ",", &save); item; item = strtok_r(NULL, ",", &save))
+	{
+		char *equals = strchr(item, '=');
+		char *end;
+		long  cpu = strtol(equals ? equals + 1 : item, &end, 10);
+		int   thread;
+
+		if (*end != '\0' || end == (equals ? equals + 1 : item) || cpu < -1 || cpu >= CPU_SETSIZE)
+		{
+			Logger::getInstance()->error("rt_init: ignoring [%s] in %s", item, RT_CPU_ENV);
+			continue;
+		}
+
+		if ( ! equals)
+		{
+			for (thread = 0; thread < RT_THREADS; thread++)
+			{
+				if (gRtConfig[thread].policy != SCHED_OTHER)
+				{
+					gRtConfig[thread].cpu = cpu;
+				}
+			}
+
+			continue;
+		}
+
+		*equals = '\0';
+
+		for (thread = 0; thread < RT_THREADS && strcmp(item, gRtThreadNames[thread]) != 0; thread++)
+			;
+
+		if (thread == RT_THREADS)
+		{
+			Logger::getInstance()->error("rt_init: ignoring unknown thread [%s] in %s", item, RT_CPU_ENV);
+			continue;
+		}
+
+		gRtConfig[thread].cpu = cpu;
+	}
+}
+
+/**
+ * Enable the profile (if RT_ENV says so or rt_set_enabled() was called) and lock memory.
+ *
+ * Call once at startup, before any of the threads are started.
+ *
+ * @return int	0 or -errno if memory couldn't be locked (the profile is still applied to threads)
+ */
+int rt_init()
+{
+	const char *env  = getenv(RT_ENV);
+	const char *cpus = getenv(RT_CPU_ENV);
+
+	pthread_mutex_lock(&gRtLock);
+
+	if (env && strcmp(env, "1") == 0)
+	{
+		gRtEnabled = true;
+	}
+
+	if (cpus)
+	{
+		rt_parse_cpus(cpus);
+	}
+
+	gRtInitialised = true;
+
+	if ( ! gRtEnabled)
+	{
+		pthread_mutex_unlock(&gRtLock);
+		return 0;
+	}
+
+	gRtLockError = mlockall(MCL_CURRENT | MCL_FUTURE) < 0 ? errno : 0;
+
+	pthread_mutex_unlock(&gRtLock);
+
+	rt_prefault_stack();
+
+	if (gRtLockError)
+	{
+		Logger::getInstance()->error("rt_init: mlockall failed: %s", strerror(gRtLockError));
+		return -gRtLockError;
+	}
+
+	return 0;
+}
+
+/**
+ * @param bool enabled
+ */
+void rt_set_enabled(bool enabled)
+{
+	pthread_mutex_lock(&gRtLock);
+	gRtEnabled = enabled;
+	pthread_mutex_unlock(&gRtLock);
+}
+
+/**
+ * @return bool
+ */
+bool rt_enabled()
+{
+	return gRtEnabled && gRtInitialised;
+}
+
+/**
+ * Change the profile for a thread role, takes effect when a thread next enters it.
+ *
+ * @param RT_THREAD thread
+ * @param int       policy
+ * @param int       priority
+ * @param int       cpu			-1 for any
+ */
+void rt_set_thread_config(RT_THREAD thread, int policy, int priority, int cpu)
+{
+	pthread_mutex_lock(&gRtLock);
+
+	gRtConfig[thread].policy   = policy;
+	gRtConfig[thread].priority = priority;
+	gRtConfig[thread].cpu      = cpu;
+
+	pthread_mutex_unlock(&gRtLock);
+}
+
+/**
+ * Apply the profile for a role to the calling thread.
+ *
+ * @param RT_THREAD thread
+ *
+ * @return int	0, or -errno of the first thing that couldn't be granted
+ */
+int rt_thread_enter(RT_THREAD thread)
+{
+	struct sched_param param;
+	RtThreadConfig     config;
+	RtThreadGrant      grant;
+	cpu_set_t          cpus;
+
+	if ( ! rt_enabled())
+	{
+		return 0;
+	}
+
+	pthread_mutex_lock(&gRtLock);
+	config = gRtConfig[thread];
+	pthread_mutex_unlock(&gRtLock);
+
+	memset(&grant, 0, sizeof(grant));
+	grant.entered = true;
+
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = config.policy == SCHED_OTHER ? 0 : config.priority;
+
+	grant.schedError = pthread_setschedparam(pthread_self(), config.policy, &param);
+
+	if (config.cpu >= 0)
+	{
+		CPU_ZERO(&cpus);
+		CPU_SET(config.cpu, &cpus);
+
+		grant.cpuError = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	}
+
+	pthread_getschedparam(pthread_self(), &grant.policy, &param);
+	grant.priority = param.sched_priority;
+
+	rt_prefault_stack();
+
+	pthread_mutex_lock(&gRtLock);
+	gRtGrants[thread] = grant;
+	pthread_mutex_unlock(&gRtLock);
+
+	if (grant.schedError || grant.cpuError)
+	{
+		Logger::getInstance()->notice("rt_thread_enter: %s thread: %s", gRtThreadNames[thread], strerror(grant.schedError ? grant.schedError : grant.cpuError));
+	}
+
+	return -(grant.schedError ? grant.schedError : grant.cpuError);
+}
+
+/**
+ * Initialise the attributes for creating a thread that will enter the profile.
+ *
+ * @param pthread_attr_t * attr
+ */
+void rt_thread_attr_init(pthread_attr_t *attr)
+{
+	pthread_attr_init(attr);
+
+	if (rt_enabled())
+	{
+		pthread_attr_setstacksize(attr, RT_THREAD_STACK_SIZE);
+	}
+}
+
+/**
+ * Log what was asked for and what was granted.
+ */
+void rt_report()
+{
+	Logger *logger = Logger::getInstance();
+
+	pthread_mutex_lock(&gRtLock);
+
+	if ( ! rt_enabled())
+	{
+		pthread_mutex_unlock(&gRtLock);
+
+		logger->notice("rt_report: real-time profile is not enabled (set %s=1)", RT_ENV);
+		return;
+	}
+
+	logger->notice("rt_report: mlockall %s", gRtLockError == 0 ? "granted" : strerror(gRtLockError));
+
+	for (int i = 0; i < RT_THREADS; i++)
+	{
+		const RtThreadConfig &config = gRtConfig[i];
+		const RtThreadGrant  &grant  = gRtGrants[i];
+
+		if ( ! grant.entered)
+		{
+			logger->notice("rt_report: %-8s wanted %s/%d cpu %d, not started", gRtThreadNames[i], rt_policy_name(config.policy), config.priority, config.cpu);
+			continue;
+		}
+
+		logger->notice("rt_report: %-8s wanted %s/%d cpu %d, got %s/%d%s%s", gRtThreadNames[i], rt_policy_name(config.policy), config.priority, config.cpu,
+			rt_policy_name(grant.policy), grant.priority, grant.cpuError ? ", not pinned: " : "", grant.cpuError ? strerror(grant.cpuError) : "");
+	}
+
+	pthread_mutex_unlock(&gRtLock);
+}
@@ -0,0 +1,62 @@
+/**
+ * rtprofile.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Opt-in real-time profile for the sensor, actuator and control threads.
+ *
+ * When enabled (OROBOTO_RT=1 in the environment, or rt_set_enabled(true) before rt_init()):
+ *
+ * - rt_init() locks all current and future memory (mlockall) so that nothing the loops touch can be paged out
+ * - each thread calls rt_thread_enter() for its role as it starts, which sets its scheduling policy and priority, pins
+ *   it to a CPU if RT_CPU_ENV (or rt_set_thread_config()) gives it one and prefaults RT_STACK_PREFAULT bytes of its
+ *   stack. The control loop runs on the program's own thread, which enters RT_THREAD_CONTROL itself before it starts
+ *   driving a Controller (ie. demo_gotogoal)
+ * - threads created with rt_thread_attr_init() get a RT_THREAD_STACK_SIZE stack rather than the default, which would
+ *   otherwise all be locked in memory too
+ *
+ * What was actually granted (ie. SCHED_FIFO needs CAP_SYS_NICE or an RLIMIT_RTPRIO) is logged by rt_report().
+ *
+ * When it isn't enabled all of these do nothing.
+ */
+
+#ifndef _RTPROFILE_H_INCLUDED
+#define _RTPROFILE_H_INCLUDED
+
+#include <pthread.h>
+
+#define RT_ENV                  "OROBOTO_RT"        // set to 1 to enable the real-time profile
+#define RT_CPU_ENV              "OROBOTO_RT_CPUS"   // ie. "1" pins every SCHED_FIFO thread to CPU 1, "odometry=1,control=2"
+#define RT_STACK_PREFAULT       (64 * 1024)         // bytes of each thread's stack touched on entry
+#define RT_THREAD_STACK_SIZE    (256 * 1024)        // stack size for threads created with rt_thread_attr_init()
+
+enum RT_THREAD
+{
+	RT_THREAD_ODOMETRY = 0,
+	RT_THREAD_CONTROL,
+	RT_THREAD_ACTUATOR,
+	RT_THREAD_SONAR,
+	RT_THREAD_LED,
+	RT_THREAD_LOGGER,
+	RT_THREAD_RECORDER,
+	RT_THREADS
+};
+
+struct RtThreadConfig
+{
+	int		policy;			// SCHED_FIFO, SCHED_RR or SCHED_OTHER
+	int		priority;		// 1 - 99 for SCHED_FIFO / SCHED_RR
+	int		cpu;			// CPU to pin to, -1 for any
+};
+
+int  rt_init();
+void rt_set_enabled(bool enabled);
+bool rt_enabled();
+
+void rt_set_thread_config(RT_THREAD thread, int policy, int priority, int cpu);
+int  rt_thread_enter(RT_THREAD thread);
+void rt_thread_attr_init(pthread_attr_t *attr);
+
+void rt_report();
+
+#endif // _RTPROFILE_H_INCLUDED
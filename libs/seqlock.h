@@ -0,0 +1,107 @@
+/**
+ * seqlock.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * A sequence lock for publishing a small struct from one writer thread to any number of readers without a mutex.
+ *
+ * The writer bumps the sequence to odd, stores the value and bumps it back to even. Readers copy the value and retry if
+ * the sequence was odd or moved while they were copying, so they always see a whole value from a single store() and
+ * never block the writer.
+ *
+ * The value is held as relaxed atomic words so that a reader racing the writer is well defined, T must therefore be
+ * trivially copyable. Only one thread may call store() at a time.
+ */
+
+#ifndef _SEQLOCK_H_INCLUDED
+#define _SEQLOCK_H_INCLUDED
+
+#include <atomic>
+#include <string.h>
+#include <type_traits>
+
+template <typename T>
+class SeqLock
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock values must be trivially copyable");
+
+	private:
+		static const size_t WORDS = (sizeof(T) + sizeof(unsigned long) - 1) / sizeof(unsigned long);
+
+		std::atomic<unsigned int>	_seq;
+		std::atomic<unsigned long>	_words[WORDS];
+
+	public:
+		SeqLock()
+		{
+			_seq.store(0, std::memory_order_relaxed);
+
+			for (size_t i = 0; i < WORDS; i++)
+			{
+				_words[i].store(0, std::memory_order_relaxed);
+			}
+		}
+
+		/**
+		 * Publish a new value (single writer).
+		 *
+		 * @param T & value
+		 */
+		void store(const T &value)
+		{
+			unsigned long words[WORDS] = { 0 };
+			unsigned int  seq = _seq.load(std::memory_order_relaxed);
+
+			memcpy(words, &value, sizeof(T));
+
+			_seq.store(seq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			for (size_t i = 0; i < WORDS; i++)
+			{
+				_words[i].store(words[i], std::memory_order_relaxed);
+			}
+
+			_seq.store(seq + 2, std::memory_order_release);
+		}
+
+		/**
+		 * Read the last published value (any thread, never blocks the writer).
+		 *
+		 * @return T
+		 */
+		T load() const
+		{
+			unsigned long words[WORDS];
+			unsigned int  seqStart, seqEnd;
+			T             value;
+
+			do
+			{
+				seqStart = _seq.load(std::memory_order_acquire);
+
+				for (size_t i = 0; i < WORDS; i++)
+				{
+					words[i] = _words[i].load(std::memory_order_relaxed);
+				}
+
+				std::atomic_thread_fence(std::memory_order_acquire);
+				seqEnd = _seq.load(std::memory_order_relaxed);
+			}
+			while ((seqStart & 1) || seqStart != seqEnd);
+
+			memcpy(&value, words, sizeof(T));
+
+			return value;
+		}
+
+		/**
+		 * @return unsigned int	the number of store()s so far
+		 */
+		unsigned int getSequence() const
+		{
+			return _seq.load(std::memory_order_acquire) / 2;
+		}
+};
+
+#endif // _SEQLOCK_H_INCLUDED
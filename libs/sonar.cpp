@@ -15,6 +15,7 @@
 
 #include "sonar.h"
 #include "logger.h"
+#include "rtprofile.h"
 #include "dotlog.h"
 #include "adclib.h"
 #include "poseprovider.h"
@@ -41,8 +42,9 @@ Sonar::Sonar(const unsigned int nADC, const unsigned int nSamples, PoseProvider
 	_logger      = new Logger("Sonar");
 	_dotLogSonar = new DotLog("sonar", true);
 
-	_bRun     = false;
-	_bMeasure = false;
+	_bRun           = false;
+	_bMeasure       = false;
+	_bThreadStarted = false;
 }
 
 /**
@@ -50,6 +52,7 @@ Sonar::Sonar(const unsigned int nADC, const unsigned int nSamples, PoseProvider
  */
 Sonar::~Sonar()
 {
+	stop();
 }
 
 /**
@@ -57,10 +60,34 @@ Sonar::~Sonar()
  */
 void Sonar::run()
 {
-	pthread_t tSonar;
+	if (_bRun)
+	{
+		return;
+	}
+
+	// It may have been stopped (but not joined) before
+	stop();
+
+	_bRun = true;
+
+	LOGGER_DEBUG(_logger, "run: starting SONAR thread ...");
+
+	pthread_attr_t attr;
+	rt_thread_attr_init(&attr);
+
+	int ret = pthread_create(&_thread, &attr, gSonarThread, this);
+
+	pthread_attr_destroy(&attr);
+
+	if (ret != 0)
+	{
+		_logger->error("run: could not create SONAR thread");
 
-	_logger->debug("run: starting SONAR thread ...");
-	pthread_create(&tSonar, NULL, gSonarThread, this);
+		_bRun = false;
+		return;
+	}
+
+	_bThreadStarted = true;
 }
 
 /**
@@ -68,7 +95,7 @@ void Sonar::run()
  */
 void * Sonar::sonarThread()
 {
-	_bRun = true;
+	rt_thread_enter(RT_THREAD_SONAR);
 
 	while (_bRun)
 	{
@@ -86,7 +113,15 @@ void * Sonar::sonarThread()
             _dotLogSonar->log((currentPose.timestamp / 1000.0), fPosXObstacle, fPosYObstacle, DotLog::DotLogPositionColour::BLACK, false);
 		}
 
-		usleep(SONAR_SLEEP_PER_MEASUREMENT_USEC);
+		// Sleep until the next measurement, or until stop() wakes us
+		unsigned long long tSleep = LatencyHistogram::now();
+
+		if (_wakeup.wait(SONAR_SLEEP_PER_MEASUREMENT_USEC) == 0)
+		{
+			unsigned long long late = LatencyHistogram::now() - tSleep;
+
+			_wakeupLatency.record(late > SONAR_SLEEP_PER_MEASUREMENT_USEC * 1000ULL ? late - SONAR_SLEEP_PER_MEASUREMENT_USEC * 1000ULL : 0);
+		}
 	}
 
 	_bRun = false;
@@ -94,12 +129,21 @@ void * Sonar::sonarThread()
 }
 
 /**
- * Sonar::stop - stop the SONAR thread
+ * Sonar::stop - stop the SONAR thread, returns once it has exited
  */
 void Sonar::stop()
 {
-	_logger->debug("stop: stopping SONAR thread");
 	_bRun = false;
+
+	if (_bThreadStarted)
+	{
+		LOGGER_DEBUG(_logger, "stop: stopping SONAR thread");
+
+		_wakeup.signal();
+		pthread_join(_thread, NULL);
+
+		_bThreadStarted = false;
+	}
 }
 
 /**
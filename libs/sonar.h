@@ -18,6 +18,12 @@
 #define SONAR_ADC_DISTANCE_CORRECTION_FACTOR 1.0		// environment specific fuzz factor
 #define SONAR_SLEEP_PER_MEASUREMENT_USEC 100000
 
+#include <atomic>
+#include <pthread.h>
+
+#include "wakeup.h"
+#include "latency.h"
+
 class Logger;
 class DotLog;
 class PoseProvider;
@@ -29,8 +35,13 @@ class Sonar
 		unsigned int	_nSamples;
 		PoseProvider *  _poseProvider;
 
-		bool			_bRun;       // Should the SONAR thread exit?
-		bool			_bMeasure;   // Should the SONAR thread make measurements?
+		std::atomic<bool>	_bRun;       // Should the SONAR thread exit?
+		std::atomic<bool>	_bMeasure;   // Should the SONAR thread make measurements?
+
+		pthread_t		_thread;
+		bool			_bThreadStarted;
+		LatencyHistogram	_wakeupLatency;	// how late the thread woke from its sleep
+		Wakeup			_wakeup;     // interrupts the sleep between measurements
 
 		Logger *		_logger;
 		DotLog * 		_dotLogSonar;
@@ -49,6 +60,8 @@ class Sonar
 		void	stopMeasuring();
 
 		bool    isRunning();
+
+		const LatencyHistogram & getWakeupLatency() const	{ return _wakeupLatency; }
 		bool	isMeasuring();
 };
 
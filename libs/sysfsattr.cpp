@@ -0,0 +1,202 @@
+/**
+ * sysfsattr.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "sysfsattr.h"
+
+/**
+ * ctor
+ */
+SysfsIntAttr::SysfsIntAttr() : _fd(-1)
+{
+	_path[0] = '\0';
+	_flags   = O_RDONLY;
+
+	pthread_mutex_init(&_lock, NULL);
+}
+
+/**
+ * dtor
+ */
+SysfsIntAttr::~SysfsIntAttr()
+{
+	close();
+
+	pthread_mutex_destroy(&_lock);
+}
+
+/**
+ * SysfsIntAttr::open - resolve and open the attribute
+ *
+ * @param char * filename	absolute sysfs path (resolved relative to the sysfs root)
+ * @param int    flags		open() flags, ie. O_RDONLY
+ *
+ * @return int				0 or -errno
+ */
+int SysfsIntAttr::open(const char *filename, int flags)
+{
+	close();
+
+	if (strlen(filename) >= sizeof(_path))
+	{
+		return -ENAMETOOLONG;
+	}
+
+	snprintf(_path, sizeof(_path), "%s", filename);
+	_flags = flags;
+
+	return reopen(-1);
+}
+
+/**
+ * SysfsIntAttr::reopen - (re)open the descriptor for the stored path
+ *
+ * A stale descriptor is replaced in place (dup2()) rather than closed, other threads may be reading it.
+ *
+ * @param int stale			the descriptor a read failed on, -1 if the attribute isn't open
+ *
+ * @return int				0 or -errno
+ */
+int SysfsIntAttr::reopen(int stale)
+{
+	char path[SYSFS_MAX_PATH * 2];
+	int  fd, ret = 0;
+
+	if ( ! sysfs_path(path, sizeof(path), _path))
+	{
+		return -ENAMETOOLONG;
+	}
+
+	if ((fd = ::open(path, _flags)) < 0)
+	{
+		return -errno;
+	}
+
+	pthread_mutex_lock(&_lock);
+
+	if (_fd.load(std::memory_order_relaxed) != stale)
+	{
+		// Closed, or already reopened, since the caller looked
+		ret = _fd.load(std::memory_order_relaxed) < 0 ? -EBADF : 0;
+		::close(fd);
+	}
+	else if (stale < 0)
+	{
+		_fd.store(fd, std::memory_order_release);
+	}
+	else
+	{
+		ret = dup2(fd, stale) < 0 ? -errno : 0;
+		::close(fd);
+	}
+
+	pthread_mutex_unlock(&_lock);
+
+	return ret;
+}
+
+/**
+ * SysfsIntAttr::close
+ */
+void SysfsIntAttr::close()
+{
+	pthread_mutex_lock(&_lock);
+
+	int fd = _fd.exchange(-1, std::memory_order_acq_rel);
+
+	pthread_mutex_unlock(&_lock);
+
+	if (fd >= 0)
+	{
+		::close(fd);
+	}
+}
+
+/**
+ * SysfsIntAttr::read - read and parse the attribute's current value
+ *
+ * If the read fails because the node has been recreated (ie. re-exported) the attribute is reopened and read once more.
+ *
+ * @param int * value
+ *
+ * @return int				0 or -errno (-EINVAL if the attribute does not hold an integer)
+ */
+int SysfsIntAttr::read(int *value)
+{
+	char buf[SYSFS_ATTR_MAX_LEN];
+	int  nRead, ret;
+	int  fd = getFd();
+
+	if (fd < 0)
+	{
+		return -EBADF;
+	}
+
+	if ((nRead = pread(fd, buf, sizeof(buf), 0)) < 0)
+	{
+		if (errno != ENODEV && errno != ENOENT && errno != EBADF)
+		{
+			return -errno;
+		}
+
+		if ((ret = reopen(fd)) < 0)
+		{
+			return ret;
+		}
+
+		if ((nRead = pread(fd, buf, sizeof(buf), 0)) < 0)
+		{
+			return -errno;
+		}
+	}
+
+	return parse(buf, nRead, value);
+}
+
+/**
+ * SysfsIntAttr::parse - parse an optionally signed decimal integer from the start of buf
+ *
+ * Stops at the first non-digit (ie. the trailing newline sysfs adds). Does not need buf to be NULL terminated.
+ *
+ * @param char * buf
+ * @param int    len
+ * @param int *  value
+ *
+ * @return int				0 or -EINVAL if there are no digits
+ */
+int SysfsIntAttr::parse(const char *buf, int len, int *value)
+{
+	int          negative = (len > 0 && buf[0] == '-');
+	unsigned int result   = 0;
+	int          i;
+
+	for (i = negative; i < len; i++)
+	{
+		unsigned int digit = static_cast<unsigned int>(buf[i] - '0');
+
+		if (digit > 9)
+		{
+			break;
+		}
+
+		result = (result * 10) + digit;
+	}
+
+	if (i == negative)
+	{
+		return -EINVAL;
+	}
+
+	// Branch-free negate: (x ^ -1) + 1 == -x, (x ^ 0) + 0 == x
+	*value = static_cast<int>((result ^ -static_cast<unsigned int>(negative)) + negative);
+
+	return 0;
+}
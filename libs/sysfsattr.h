@@ -0,0 +1,56 @@
+/**
+ * sysfsattr.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Fast path for polling integer sysfs attributes (ADC AINx, GPIO value etc).
+ *
+ * The attribute's path is resolved (relative to the sysfs root) and opened once, each read() is then a single pread()
+ * at offset 0 into a stack buffer and a simple digit parse: no path formatting, no lseek(), no allocation and no
+ * logging. Errors are returned to the caller as negative errno values.
+ *
+ * The descriptor is suitable for poll()ing (ie. for POLLPRI on a GPIO value file), see getFd().
+ *
+ * The descriptor is published with release / acquire ordering, so one thread may check isOpen() while another opens
+ * the attribute (under a lock of the caller's, ie. adc_get_attr()). When a read finds the node has been recreated the
+ * new node is dup2()ed over the old descriptor under the attribute's own lock, so the descriptor number other readers
+ * hold never goes away or comes back as some other file. close() is not safe against concurrent reads.
+ */
+
+#ifndef _SYSFSATTR_H_INCLUDED
+#define _SYSFSATTR_H_INCLUDED
+
+#include <pthread.h>
+
+#include <atomic>
+
+#include "sysfslib.h"
+
+#define SYSFS_ATTR_MAX_LEN 32       // longest attribute value that can be read
+
+class SysfsIntAttr
+{
+	private:
+		char	_path[SYSFS_MAX_PATH];		// unresolved sysfs path, kept so that the attribute can be reopened
+		int		_flags;
+		std::atomic<int> _fd;
+		pthread_mutex_t	_lock;				// serialises reopen()
+
+		int		reopen(int stale);
+
+	public:
+		SysfsIntAttr();
+		~SysfsIntAttr();
+
+		int		open(const char *filename, int flags);
+		void	close();
+
+		int		read(int *value);
+
+		int		getFd() const			{ return _fd.load(std::memory_order_acquire); }
+		bool	isOpen() const			{ return getFd() >= 0; }
+
+		static int parse(const char *buf, int len, int *value);
+};
+
+#endif // _SYSFSATTR_H_INCLUDED
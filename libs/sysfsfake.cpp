@@ -0,0 +1,176 @@
+/**
+ * sysfsfake.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+#include "sysfsfake.h"
+#include "sysfslib.h"
+#include "pwmlib.h"
+#include "adclib.h"
+#include "gpio.h"
+#include "led.h"
+#include "logger.h"
+
+/**
+ * Create a file (and any missing parent directories) below root with the given contents.
+ *
+ * @param char * root
+ * @param char * filename   absolute sysfs path, ie. GPIO_DIR_PREFIX "/export"
+ * @param char * contents
+ *
+ * @return int
+ */
+static int sysfs_fake_file(const char *root, const char *filename, const char *contents)
+{
+    char path[SYSFS_MAX_PATH * 2];
+    int  fd;
+
+    snprintf(path, sizeof(path), "%s%s", root, filename);
+
+    // mkdir -p the parent
+    for (char *p = path + strlen(root) + 1; (p = strchr(p, '/')) != NULL; p++)
+    {
+        *p = '\0';
+
+        if (mkdir(path, 0755) < 0 && errno != EEXIST)
+        {
+        	Logger::getInstance()->error("sysfs::sysfs_fake_file: could not create %s", path);
+            return -1;
+        }
+
+        *p = '/';
+    }
+
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+    {
+    	Logger::getInstance()->error("sysfs::sysfs_fake_file: could not create %s", path);
+        return -1;
+    }
+
+    if (write(fd, contents, strlen(contents)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    close(fd);
+
+    return 0;
+}
+
+/**
+ * Build a fake sysfs tree in a new temporary directory.
+ *
+ * The GPIOs are created as if already exported (inputs, no edge), writes to their value files behave like a normal
+ * file, polling them for POLLPRI will never fire.
+ *
+ * @param char *         root      receives the path of the new tree (pass it to sysfs_set_root())
+ * @param int            maxlen    size of root
+ * @param unsigned int * gpios     the GPIOs to create gpioN directories for
+ * @param unsigned int   nGpios
+ *
+ * @return int
+ */
+int sysfs_fake_create(char *root, int maxlen, const unsigned int *gpios, unsigned int nGpios)
+{
+    const char *pwmDirs[] = { PWM_DIR_PREFIX PWM_0_DIR, PWM_DIR_PREFIX PWM_1_DIR, PWM_DIR_PREFIX PWM_2_DIR, PWM_DIR_PREFIX PWM_3_DIR };
+    const char *adcFiles[] = { ADC_0_DIR, ADC_1_DIR, ADC_2_DIR, ADC_3_DIR, ADC_4_DIR, ADC_5_DIR, ADC_6_DIR, ADC_7_DIR };
+    char        filename[SYSFS_MAX_PATH];
+    char        value[16];
+    int         ret = 0;
+    unsigned int i;
+
+    if (snprintf(root, maxlen, "%s", SYSFS_FAKE_TEMPLATE) >= maxlen || mkdtemp(root) == NULL)
+    {
+    	Logger::getInstance()->error("sysfs::sysfs_fake_create: could not create temporary directory");
+        return -1;
+    }
+
+    ret |= sysfs_fake_file(root, SLOTS_FILE, "");
+
+    for (i = 0; i < sizeof(pwmDirs) / sizeof(pwmDirs[0]); i++)
+    {
+        snprintf(value, sizeof(value), "%d", PWM_DEFAULT_PERIOD);
+
+        snprintf(filename, sizeof(filename), "%s/%s", pwmDirs[i], PERIOD_FILE);
+        ret |= sysfs_fake_file(root, filename, value);
+
+        snprintf(filename, sizeof(filename), "%s/%s", pwmDirs[i], DUTY_FILE);
+        ret |= sysfs_fake_file(root, filename, value);
+
+        snprintf(filename, sizeof(filename), "%s/%s", pwmDirs[i], POLARITY_FILE);
+        ret |= sysfs_fake_file(root, filename, "0");
+    }
+
+    for (i = 0; i < sizeof(adcFiles) / sizeof(adcFiles[0]); i++)
+    {
+        snprintf(filename, sizeof(filename), "%s%s", ADC_DIR_PREFIX, adcFiles[i]);
+        ret |= sysfs_fake_file(root, filename, SYSFS_FAKE_ADC_VALUE);
+    }
+
+    ret |= sysfs_fake_file(root, GPIO_DIR_PREFIX "/export", "");
+    ret |= sysfs_fake_file(root, GPIO_DIR_PREFIX "/unexport", "");
+
+    for (i = 0; i < nGpios; i++)
+    {
+        snprintf(filename, sizeof(filename), GPIO_DIR_PREFIX "/gpio%d/value", gpios[i]);
+        ret |= sysfs_fake_file(root, filename, "0");
+
+        snprintf(filename, sizeof(filename), GPIO_DIR_PREFIX "/gpio%d/direction", gpios[i]);
+        ret |= sysfs_fake_file(root, filename, "in");
+
+        snprintf(filename, sizeof(filename), GPIO_DIR_PREFIX "/gpio%d/edge", gpios[i]);
+        ret |= sysfs_fake_file(root, filename, "none");
+    }
+
+    for (i = 0; i <= 3; i++)
+    {
+        snprintf(filename, sizeof(filename), "%s%d/brightness", LED_FILE_PREFIX, i);
+        ret |= sysfs_fake_file(root, filename, "0");
+
+        snprintf(filename, sizeof(filename), "%s%d/trigger", LED_FILE_PREFIX, i);
+        ret |= sysfs_fake_file(root, filename, "heartbeat");
+    }
+
+    if (ret != 0)
+    {
+        sysfs_fake_destroy(root);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * nftw() callback to remove a file or (empty) directory.
+ */
+static int sysfs_fake_remove(const char *path, const struct stat *sb, int typeflag, struct FTW *ftwbuf)
+{
+    return remove(path);
+}
+
+/**
+ * Remove a tree created by sysfs_fake_create().
+ *
+ * @param char * root
+ */
+void sysfs_fake_destroy(const char *root)
+{
+    if (strncmp(root, SYSFS_FAKE_TEMPLATE, strlen(SYSFS_FAKE_TEMPLATE) - 6) != 0)
+    {
+    	Logger::getInstance()->error("sysfs::sysfs_fake_destroy: refusing to remove %s, not a fake tree", root);
+        return;
+    }
+
+    nftw(root, sysfs_fake_remove, 16, FTW_DEPTH | FTW_PHYS);
+}
@@ -0,0 +1,29 @@
+/**
+ * sysfsfake.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Builds a fake, file-backed copy of the parts of the BeagleBone sysfs tree that the libs use (CapeMgr slots, PWM
+ * period/duty/polarity, ADC AINx, GPIO export/value/direction/edge and LED brightness/trigger) so that the motor, ADC,
+ * GPIO and LED code can be run and timed on a plain Linux box.
+ *
+ * Usage:
+ *
+ *   char root[SYSFS_MAX_PATH];
+ *
+ *   sysfs_fake_create(root, sizeof(root), gpios, nGpios);
+ *   sysfs_set_root(root);
+ *   ...
+ *   sysfs_fake_destroy(root);
+ */
+
+#ifndef _SYSFSFAKE_H_INCLUDED
+#define _SYSFSFAKE_H_INCLUDED
+
+#define SYSFS_FAKE_TEMPLATE     "/tmp/oroboto-sysfs-XXXXXX"
+#define SYSFS_FAKE_ADC_VALUE    "1024"                      // what every fake AINx reads back as
+
+int  sysfs_fake_create(char *root, int maxlen, const unsigned int *gpios, unsigned int nGpios);
+void sysfs_fake_destroy(const char *root);
+
+#endif // _SYSFSFAKE_H_INCLUDED
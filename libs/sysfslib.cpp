@@ -7,39 +7,414 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #include "sysfslib.h"
 #include "logger.h"
 
 /**
- * Open, write, close a file.
+ * The handle registry.
+ *
+ * Every attribute that is read or written through sysfs_read() or sysfs_write() is opened once and the descriptor is
+ * kept here, subsequent accesses use pread() / pwrite() at offset 0 (sysfs attributes always start at offset 0).
+ *
+ * The table is open addressed on a hash of the path, entries are never removed, an invalidated entry just has its
+ * descriptor closed (fd = -1) and will be reopened on next use. Once the table is full, paths that aren't in it are
+ * opened and closed around every access instead.
+ */
+struct SysfsHandle
+{
+    char            path[SYSFS_MAX_PATH];
+    int             accessMode;             // O_RDONLY or O_WRONLY
+    int             fd;                     // -1 if the attribute is not currently open
+    bool            regular;                // is this a regular file (ie. part of a fake tree) rather than a sysfs node?
+};
+
+static SysfsHandle      gSysfsHandles[SYSFS_MAX_HANDLES];
+static unsigned int     gSysfsHandleCount = 0;
+static pthread_mutex_t  gSysfsHandleLock  = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * The root that all sysfs paths are resolved relative to ("" for the real /sys).
+ */
+static char             gSysfsRoot[SYSFS_MAX_PATH];
+static pthread_once_t   gSysfsRootOnce    = PTHREAD_ONCE_INIT;
+
+/**
+ * Pick up the root from the environment the first time any path is resolved.
+ */
+static void sysfs_root_init()
+{
+    const char *root = getenv(SYSFS_ROOT_ENV);
+
+    if (root && strlen(root) < sizeof(gSysfsRoot))
+    {
+        snprintf(gSysfsRoot, sizeof(gSysfsRoot), "%s", root);
+    }
+}
+
+/**
+ * Set the directory that all sysfs paths are resolved relative to.
+ *
+ * This overrides SYSFS_ROOT_ENV. Any cached descriptors are closed so that subsequent accesses open files under the
+ * new root.
+ *
+ * @param char * root       the root directory, NULL or "" to use the real sysfs
+ *
+ * @return int
+ */
+int sysfs_set_root(const char *root)
+{
+    if (root && strlen(root) >= sizeof(gSysfsRoot))
+    {
+    	Logger::getInstance()->error("sysfs::sysfs_set_root: root %s is too long", root);
+        return -1;
+    }
+
+    pthread_once(&gSysfsRootOnce, sysfs_root_init);
+
+    // Drop every cached descriptor (they all refer to the old root) and swap the root in one hold of the lock, so that
+    // no other thread can reopen a file under the old root in between
+    pthread_mutex_lock(&gSysfsHandleLock);
+
+    for (unsigned int i = 0; i < SYSFS_MAX_HANDLES; i++)
+    {
+        if (gSysfsHandles[i].fd >= 0)
+        {
+            close(gSysfsHandles[i].fd);
+            gSysfsHandles[i].fd = -1;
+        }
+    }
+
+    snprintf(gSysfsRoot, sizeof(gSysfsRoot), "%s", root ? root : "");
+
+    pthread_mutex_unlock(&gSysfsHandleLock);
+
+    return 0;
+}
+
+/**
+ * Get a copy of the directory that sysfs paths are resolved relative to.
+ *
+ * @param char * buf        buffer to copy the root to
+ * @param int    maxlen     size of buf (SYSFS_MAX_PATH always fits)
+ *
+ * @return const char *     buf, "" when using the real sysfs
+ */
+const char * sysfs_get_root(char *buf, int maxlen)
+{
+    pthread_once(&gSysfsRootOnce, sysfs_root_init);
+
+    pthread_mutex_lock(&gSysfsHandleLock);
+    snprintf(buf, maxlen, "%s", gSysfsRoot);
+    pthread_mutex_unlock(&gSysfsHandleLock);
+
+    return buf;
+}
+
+/**
+ * Resolve a sysfs path against the current root.
+ *
+ * Must be called with gSysfsHandleLock held.
+ *
+ * @param char * buf        buffer to write the resolved path to
+ * @param int    maxlen     size of buf
+ * @param char * filename   absolute sysfs path
+ *
+ * @return const char *     buf, or NULL if the resolved path does not fit
+ */
+static const char * sysfs_path_locked(char *buf, int maxlen, const char *filename)
+{
+    pthread_once(&gSysfsRootOnce, sysfs_root_init);
+
+    if (snprintf(buf, maxlen, "%s%s", gSysfsRoot, filename) >= maxlen)
+    {
+        return NULL;
+    }
+
+    return buf;
+}
+
+/**
+ * Resolve a sysfs path (ie. one of the *_PREFIX paths) against the current root.
+ *
+ * @param char * buf        buffer to write the resolved path to
+ * @param int    maxlen     size of buf
+ * @param char * filename   absolute sysfs path
+ *
+ * @return const char *     buf, or NULL if the resolved path does not fit
+ */
+const char * sysfs_path(char *buf, int maxlen, const char *filename)
+{
+    const char *path;
+
+    pthread_mutex_lock(&gSysfsHandleLock);
+    path = sysfs_path_locked(buf, maxlen, filename);
+    pthread_mutex_unlock(&gSysfsHandleLock);
+
+    return path;
+}
+
+/**
+ * Open a sysfs path relative to the current root.
+ *
+ * Must be called with gSysfsHandleLock held.
  *
  * @param char * filename
- * @param char * str        the NULL terminated string to write
+ * @param int    flags
  *
  * @return int
  */
-int sysfs_write(const char *filename, const char *str)
+static int sysfs_open_locked(const char *filename, int flags)
 {
-    int fd;
+    char path[SYSFS_MAX_PATH * 2];
 
-    fd = open(filename, O_WRONLY);
-    if (fd < 0)
+    if ( ! sysfs_path_locked(path, sizeof(path), filename))
     {
-    	Logger::getInstance()->error("sysfs::sysfs_write: failed to open %s for writing", filename);
-        return fd;
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    return open(path, flags);
+}
+
+/**
+ * Open a sysfs path relative to the current root.
+ *
+ * @param char * filename
+ * @param int    flags
+ *
+ * @return int
+ */
+static int sysfs_open(const char *filename, int flags)
+{
+    char path[SYSFS_MAX_PATH * 2];
+
+    if ( ! sysfs_path(path, sizeof(path), filename))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    return open(path, flags);
+}
+
+/**
+ * FNV-1a hash of a path and access mode.
+ *
+ * @param char * filename
+ * @param int    accessMode
+ *
+ * @return unsigned int
+ */
+static unsigned int sysfs_handle_hash(const char *filename, int accessMode)
+{
+    unsigned int hash = 2166136261u;
+
+    for (const char *p = filename; *p; p++)
+    {
+        hash = (hash ^ static_cast<unsigned char>(*p)) * 16777619u;
+    }
+
+    return (hash ^ static_cast<unsigned int>(accessMode)) * 16777619u;
+}
+
+static bool sysfs_handle_reopen(SysfsHandle *handle);
+
+/**
+ * Find (or create) the registry entry for a path and make sure it has an open descriptor.
+ *
+ * Must be called with gSysfsHandleLock held.
+ *
+ * @param char * filename
+ * @param int    accessMode  O_RDONLY or O_WRONLY
+ *
+ * @return SysfsHandle *     NULL if the file can't be opened, or with errno ENOSPC if the path can't be cached (the
+ *                          registry is full or the path is too long)
+ */
+static SysfsHandle * sysfs_handle_get(const char *filename, int accessMode)
+{
+    unsigned int slot = sysfs_handle_hash(filename, accessMode) & (SYSFS_MAX_HANDLES - 1);
+    SysfsHandle *handle;
+
+    for (;;)
+    {
+        handle = &gSysfsHandles[slot];
+
+        if (handle->path[0] == '\0')
+        {
+            // Not seen before, claim this slot (always keep one slot free so that lookups terminate)
+            if (gSysfsHandleCount >= SYSFS_MAX_HANDLES - 1 || strlen(filename) >= sizeof(handle->path))
+            {
+                errno = ENOSPC;
+                return NULL;
+            }
+
+            snprintf(handle->path, sizeof(handle->path), "%s", filename);
+            handle->accessMode = accessMode;
+            handle->fd         = -1;
+
+            gSysfsHandleCount++;
+            break;
+        }
+
+        if (handle->accessMode == accessMode && strcmp(handle->path, filename) == 0)
+        {
+            break;
+        }
+
+        slot = (slot + 1) & (SYSFS_MAX_HANDLES - 1);
+    }
+
+    if (handle->fd < 0)
+    {
+        sysfs_handle_reopen(handle);
+    }
+
+    return handle->fd < 0 ? NULL : handle;
+}
+
+/**
+ * Close and reopen a registry entry's descriptor.
+ *
+ * Used when I/O on a cached descriptor fails because the underlying sysfs node was removed and recreated (ie. the
+ * GPIO was unexported and exported again, or a cape was reloaded), in which case the old descriptor is stale.
+ *
+ * Must be called with gSysfsHandleLock held.
+ *
+ * @param SysfsHandle * handle
+ *
+ * @return bool     true if the handle has a fresh descriptor
+ */
+static bool sysfs_handle_reopen(SysfsHandle *handle)
+{
+    if (handle->fd >= 0)
+    {
+        close(handle->fd);
+    }
+
+    struct stat st;
+
+    handle->fd      = sysfs_open_locked(handle->path, handle->accessMode);
+    handle->regular = handle->fd >= 0 && fstat(handle->fd, &st) == 0 && S_ISREG(st.st_mode);
+
+    return handle->fd >= 0;
+}
+
+/**
+ * Is this errno what we get back from I/O on a descriptor whose sysfs node has gone away?
+ *
+ * @param int err
+ *
+ * @return bool
+ */
+static bool sysfs_handle_is_stale(int err)
+{
+    return err == ENODEV || err == ENOENT || err == EBADF || err == ENXIO;
+}
+
+/**
+ * Write a string to a file that can't be cached in the registry, with its own open / pwrite / close.
+ *
+ * @param char * filename
+ * @param char * str
+ *
+ * @return int              as sysfs_write()
+ */
+static int sysfs_write_once(const char *filename, const char *str)
+{
+    size_t      len = strlen(str);
+    struct stat st;
+    int         fd;
+
+    if ((fd = sysfs_open(filename, O_WRONLY)) < 0)
+    {
+        return -1;
+    }
+
+    ssize_t written = pwrite(fd, str, len, 0);
+    int     ret     = written < 0 ? -errno : (static_cast<size_t>(written) < len ? -EIO : 0);
+
+    if (ret == 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && ftruncate(fd, len) < 0)
+    {
+        ret = -errno;
     }
 
-    write(fd, str, strlen(str));
     close(fd);
 
-    return 0;
+    return ret;
+}
+
+/**
+ * Write a string to a file.
+ *
+ * The file is only opened the first time it is written, the descriptor is then cached for subsequent writes.
+ *
+ * @param char * filename
+ * @param char * str        the NULL terminated string to write
+ *
+ * @return int              0 on success, -1 if the file can't be opened, -errno if the write fails (-EIO if short)
+ */
+int sysfs_write(const char *filename, const char *str)
+{
+    SysfsHandle *handle;
+    size_t       len = strlen(str);
+
+    pthread_mutex_lock(&gSysfsHandleLock);
+
+    if ((handle = sysfs_handle_get(filename, O_WRONLY)) == NULL)
+    {
+        bool cacheable = errno != ENOSPC;
+
+        pthread_mutex_unlock(&gSysfsHandleLock);
+
+        int ret = cacheable ? -1 : sysfs_write_once(filename, str);
+
+        if (ret == -1)
+        {
+        	Logger::getInstance()->error("sysfs::sysfs_write: failed to open %s for writing", filename);
+        }
+        else if (ret < 0)
+        {
+        	Logger::getInstance()->error("sysfs::sysfs_write: failed to write [%s] to %s: %s", str, filename, strerror(-ret));
+        }
+
+        return ret;
+    }
+
+    ssize_t written = pwrite(handle->fd, str, len, 0);
+
+    if (written < 0 && sysfs_handle_is_stale(errno) && sysfs_handle_reopen(handle))
+    {
+        written = pwrite(handle->fd, str, len, 0);
+    }
+
+    int ret = written < 0 ? -errno : (static_cast<size_t>(written) < len ? -EIO : 0);
+
+    // A sysfs attribute takes the whole write as its new value, a regular file needs the old tail trimming
+    if (ret == 0 && handle->regular && ftruncate(handle->fd, len) < 0)
+    {
+        ret = -errno;
+    }
+
+    pthread_mutex_unlock(&gSysfsHandleLock);
+
+    if (ret < 0)
+    {
+    	Logger::getInstance()->error("sysfs::sysfs_write: failed to write [%s] to %s: %s", str, filename, strerror(-ret));
+    }
+
+    return ret;
 }
 
 /**
- * Open, read, close a file.
+ * Read a file.
+ *
+ * The file is only opened the first time it is read, the descriptor is then cached for subsequent reads.
  *
  * @param char * filename
  * @param char * buf        buffer to read into
@@ -49,25 +424,79 @@ int sysfs_write(const char *filename, const char *str)
  */
 int sysfs_read(const char *filename, char *buf, int maxlen)
 {
-    int fd, bytes_read;
+    SysfsHandle *handle;
+    int          bytes_read;
 
-    fd = open(filename, O_RDONLY);
-    if (fd < 0)
+    pthread_mutex_lock(&gSysfsHandleLock);
+
+    if ((handle = sysfs_handle_get(filename, O_RDONLY)) == NULL)
     {
-    	Logger::getInstance()->error("sysfs::sysfs_read: failed to open %s for reading", filename);
-        return fd;
+        bool cacheable = errno != ENOSPC;
+        int  fd;
+
+        pthread_mutex_unlock(&gSysfsHandleLock);
+
+        // Not in the registry, read it with a descriptor of its own
+        if (cacheable || (fd = sysfs_open(filename, O_RDONLY)) < 0)
+        {
+        	Logger::getInstance()->error("sysfs::sysfs_read: failed to open %s for reading", filename);
+            return -1;
+        }
+
+        bytes_read = pread(fd, buf, maxlen, 0);
+        close(fd);
+
+        if (bytes_read <= 0)
+        {
+        	Logger::getInstance()->error("sysfs::sysfs_read: failed to read from %s", filename);
+        }
+
+        return bytes_read;
     }
 
-    if ((bytes_read = read(fd, buf, maxlen)) <= 0)
+    if ((bytes_read = pread(handle->fd, buf, maxlen, 0)) < 0 && sysfs_handle_is_stale(errno) && sysfs_handle_reopen(handle))
     {
-    	Logger::getInstance()->error("sysfs::sysfs_read: failed to read from %s", filename);
+        bytes_read = pread(handle->fd, buf, maxlen, 0);
     }
 
-    close(fd);
+    pthread_mutex_unlock(&gSysfsHandleLock);
+
+    if (bytes_read <= 0)
+    {
+    	Logger::getInstance()->error("sysfs::sysfs_read: failed to read from %s", filename);
+    }
 
     return bytes_read;
 }
 
+/**
+ * Close any cached descriptors for files whose path starts with prefix (relative to the root, "" closes everything).
+ *
+ * Call this whenever the files under a path are about to be recreated (ie. GPIO export / unexport, cape load) so
+ * that the next access opens the new node rather than using a stale descriptor.
+ *
+ * @param char * prefix
+ */
+void sysfs_invalidate(const char *prefix)
+{
+    size_t prefixLen = strlen(prefix);
+
+    pthread_mutex_lock(&gSysfsHandleLock);
+
+    for (unsigned int i = 0; i < SYSFS_MAX_HANDLES; i++)
+    {
+        SysfsHandle *handle = &gSysfsHandles[i];
+
+        if (handle->fd >= 0 && strncmp(handle->path, prefix, prefixLen) == 0)
+        {
+            close(handle->fd);
+            handle->fd = -1;
+        }
+    }
+
+    pthread_mutex_unlock(&gSysfsHandleLock);
+}
+
 /**
  * Open a file for reading and return the open filehandle.
  *
@@ -80,7 +509,7 @@ int sysfs_open_read(const char *filename, int flags = O_RDONLY)
 {
     int fd;
 
-    fd = open(filename, flags);
+    fd = sysfs_open(filename, flags);
     if (fd < 0)
     {
     	Logger::getInstance()->error("sysfs::sysfs_open_read: failed to open %s for reading", filename);
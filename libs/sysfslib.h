@@ -4,6 +4,9 @@
  * @author <oroboto@oroboto.net>, www.oroboto.net, 2014
  *
  * Trivial abstraction to simplify reading/writing to files, primarily used for accessing SYSFS files on BeagleBone.
+ *
+ * Files accessed through sysfs_read() and sysfs_write() are opened once and their descriptors cached, so repeated
+ * writes to the same attribute (ie. a PWM duty cycle) cost a single pwrite() rather than open/write/close.
  */
 
 #ifndef _SYSFSLIB_H_INCLUDED
@@ -18,8 +21,29 @@
  */
 #define SLOTS_FILE          "/sys/devices/bone_capemgr.9/slots"
 
+/**
+ * All of the sysfs paths used by the libs (SLOTS_FILE, *_DIR_PREFIX etc) are resolved relative to a root directory,
+ * which is empty (ie. the real sysfs) unless set by sysfs_set_root() or this environment variable. Pointing it at a
+ * tree built by sysfs_fake_create() lets the libs run on something other than a BeagleBone.
+ */
+#define SYSFS_ROOT_ENV      "OROBOTO_SYSFS_ROOT"
+
+/**
+ * sysfs_read() and sysfs_write() keep the files they touch open, these size the table of cached descriptors.
+ *
+ * SYSFS_MAX_HANDLES must be a power of two.
+ */
+#define SYSFS_MAX_HANDLES   128
+#define SYSFS_MAX_PATH      256
+
 int  sysfs_write(const char *filename, const char *str);
 int  sysfs_read(const char *filename, char *buf, int maxlen);
+void sysfs_invalidate(const char *prefix);
+
+int          sysfs_set_root(const char *root);
+const char * sysfs_get_root(char *buf, int maxlen);
+const char * sysfs_path(char *buf, int maxlen, const char *filename);
+
 int  sysfs_open_read(const char *filename, int flags);
 void sysfs_close(int fd);
 
@@ -0,0 +1,88 @@
+/**
+ * wakeup.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/eventfd.h>
+
+#include "wakeup.h"
+
+/**
+ * ctor
+ */
+Wakeup::Wakeup()
+{
+	_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+/**
+ * dtor
+ */
+Wakeup::~Wakeup()
+{
+	if (_fd >= 0)
+	{
+		close(_fd);
+	}
+}
+
+/**
+ * Wakeup::signal - wake the waiter (or the next one to wait)
+ *
+ * @return void
+ */
+void Wakeup::signal()
+{
+	uint64_t one = 1;
+
+	if (write(_fd, &one, sizeof(one)) < 0)
+	{
+		// EAGAIN: the counter is saturated, a wakeup is already pending
+	}
+}
+
+/**
+ * Wakeup::clear - consume any pending wakeup
+ *
+ * @return bool	was there one?
+ */
+bool Wakeup::clear()
+{
+	uint64_t count;
+
+	return read(_fd, &count, sizeof(count)) == sizeof(count);
+}
+
+/**
+ * Wakeup::wait - sleep until signalled or the timeout expires
+ *
+ * @param long long timeoutUs	microseconds, < 0 to wait forever
+ *
+ * @return int	1 if signalled, 0 on timeout, -errno on error
+ */
+int Wakeup::wait(long long timeoutUs)
+{
+	struct pollfd	fdset;
+	struct timespec	ts;
+	int				ret;
+
+	fdset.fd      = _fd;
+	fdset.events  = POLLIN;
+	fdset.revents = 0;
+
+	ts.tv_sec  = timeoutUs / 1000000;
+	ts.tv_nsec = (timeoutUs % 1000000) * 1000;
+
+	if ((ret = ppoll(&fdset, 1, timeoutUs < 0 ? NULL : &ts, NULL)) < 0)
+	{
+		return errno == EINTR ? 0 : -errno;
+	}
+
+	return (ret > 0 && clear()) ? 1 : 0;
+}
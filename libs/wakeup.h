@@ -0,0 +1,31 @@
+/**
+ * wakeup.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * An eventfd that a worker thread waits on alongside (or instead of) whatever it is really waiting for, so that another
+ * thread can interrupt the wait straight away, ie. when asking it to stop.
+ *
+ * A signal() is never lost: if nobody is waiting the next wait() returns immediately.
+ */
+
+#ifndef _WAKEUP_H_INCLUDED
+#define _WAKEUP_H_INCLUDED
+
+class Wakeup
+{
+	private:
+		int		_fd;
+
+	public:
+		Wakeup();
+		~Wakeup();
+
+		void	signal();
+		bool	clear();
+		int		wait(long long timeoutUs);
+
+		int		getFd() const		{ return _fd; }
+};
+
+#endif // _WAKEUP_H_INCLUDED
@@ -0,0 +1,261 @@
+/**
+ * workpool.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <unistd.h>
+
+#include "workpool.h"
+#include "logger.h"
+
+extern "C" void * gWorkPoolThread(void *arg)
+{
+	WorkQueue *queue = static_cast<WorkQueue *>(arg);
+	return queue->pool->thread(queue);
+}
+
+/**
+ * ctor, starts the workers
+ *
+ * @param unsigned int nThreads	0 for one per online CPU
+ */
+WorkPool::WorkPool(unsigned int nThreads)
+{
+	if (nThreads == 0)
+	{
+		long nCpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		nThreads = nCpus > 0 ? nCpus : 1;
+	}
+
+	_nThreads  = nThreads;
+	_nextQueue = 0;
+	_queued    = 0;
+	_pending   = 0;
+	_bRun      = true;
+
+	pthread_mutex_init(&_lock, NULL);
+	pthread_cond_init(&_work, NULL);
+	pthread_cond_init(&_done, NULL);
+
+	_queues = new WorkQueue[_nThreads];
+
+	for (unsigned int i = 0; i < _nThreads; i++)
+	{
+		pthread_mutex_init(&_queues[i].lock, NULL);
+
+		_queues[i].pool     = this;
+		_queues[i].index    = i;
+		_queues[i].executed = 0;
+		_queues[i].stolen   = 0;
+	}
+
+	for (unsigned int i = 0; i < _nThreads; i++)
+	{
+		if (pthread_create(&_queues[i].thread, NULL, gWorkPoolThread, &_queues[i]) != 0)
+		{
+			Logger::getInstance()->error("WorkPool::ctor: could not create worker thread %u, running with %u", i, i);
+
+			// Only the workers we have get jobs (with none, submit() runs them itself)
+			_nThreads = i;
+
+			break;
+		}
+	}
+}
+
+/**
+ * dtor, finishes any jobs still queued and joins the workers
+ */
+WorkPool::~WorkPool()
+{
+	wait();
+
+	pthread_mutex_lock(&_lock);
+	_bRun = false;
+	pthread_cond_broadcast(&_work);
+	pthread_mutex_unlock(&_lock);
+
+	for (unsigned int i = 0; i < _nThreads; i++)
+	{
+		pthread_join(_queues[i].thread, NULL);
+		pthread_mutex_destroy(&_queues[i].lock);
+	}
+
+	delete [] _queues;
+
+	pthread_cond_destroy(&_done);
+	pthread_cond_destroy(&_work);
+	pthread_mutex_destroy(&_lock);
+}
+
+/**
+ * WorkPool::submit - queue a job, it runs on some worker at some point before wait() returns
+ *
+ * @param WorkFunction function
+ * @param void *	   arg
+ *
+ * @return void
+ */
+void WorkPool::submit(WorkFunction function, void *arg)
+{
+	WorkItem item = { function, arg };
+
+	if (_nThreads == 0)
+	{
+		function(arg);
+		return;
+	}
+
+	WorkQueue *queue = &_queues[_nextQueue];
+
+	_nextQueue = (_nextQueue + 1) % _nThreads;
+
+	// Counted before it is published, a worker can take (and finish) the job as soon as it is on the queue
+	pthread_mutex_lock(&_lock);
+	_queued++;
+	_pending++;
+
+	pthread_mutex_lock(&queue->lock);
+	queue->items.push_back(item);
+	pthread_mutex_unlock(&queue->lock);
+
+	pthread_cond_signal(&_work);
+	pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * WorkPool::wait - until every job submitted so far has finished
+ *
+ * @return void
+ */
+void WorkPool::wait()
+{
+	pthread_mutex_lock(&_lock);
+
+	while (_pending > 0)
+	{
+		pthread_cond_wait(&_done, &_lock);
+	}
+
+	pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * WorkPool::getStolenCount
+ *
+ * @return unsigned long	jobs so far that were run by a worker other than the one they were dealt to
+ */
+unsigned long WorkPool::getStolenCount() const
+{
+	unsigned long stolen = 0;
+
+	for (unsigned int i = 0; i < _nThreads; i++)
+	{
+		stolen += _queues[i].stolen;
+	}
+
+	return stolen;
+}
+
+/**
+ * WorkPool::take - the newest job on a worker's own queue, otherwise the oldest on someone else's
+ *
+ * @param WorkQueue * queue
+ * @param WorkItem *  item
+ *
+ * @return bool	false if every queue was empty
+ */
+bool WorkPool::take(WorkQueue *queue, WorkItem *item)
+{
+	bool bFound = false;
+
+	pthread_mutex_lock(&queue->lock);
+
+	if ( ! queue->items.empty())
+	{
+		*item  = queue->items.back();
+		bFound = true;
+
+		queue->items.pop_back();
+	}
+
+	pthread_mutex_unlock(&queue->lock);
+
+	for (unsigned int i = 1; i < _nThreads && ! bFound; i++)
+	{
+		WorkQueue *victim = &_queues[(queue->index + i) % _nThreads];
+
+		pthread_mutex_lock(&victim->lock);
+
+		if ( ! victim->items.empty())
+		{
+			*item  = victim->items.front();
+			bFound = true;
+
+			victim->items.pop_front();
+			queue->stolen++;
+		}
+
+		pthread_mutex_unlock(&victim->lock);
+	}
+
+	if (bFound)
+	{
+		_queued--;
+	}
+
+	return bFound;
+}
+
+/**
+ * WorkPool::thread - a worker
+ *
+ * @param WorkQueue * queue		this worker's queue
+ *
+ * @return void *
+ */
+void * WorkPool::thread(WorkQueue *queue)
+{
+	WorkItem item;
+
+	while (true)
+	{
+		if (take(queue, &item))
+		{
+			item.function(item.arg);
+			queue->executed++;
+
+			pthread_mutex_lock(&_lock);
+
+			if (--_pending == 0)
+			{
+				pthread_cond_broadcast(&_done);
+			}
+
+			pthread_mutex_unlock(&_lock);
+
+			continue;
+		}
+
+		// Nothing anywhere, sleep until something is queued
+		pthread_mutex_lock(&_lock);
+
+		while (_queued.load() == 0 && _bRun)
+		{
+			pthread_cond_wait(&_work, &_lock);
+		}
+
+		bool bRun = _bRun;
+
+		pthread_mutex_unlock(&_lock);
+
+		if ( ! bRun && _queued.load() == 0)
+		{
+			break;
+		}
+	}
+
+	return NULL;
+}
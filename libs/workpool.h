@@ -0,0 +1,76 @@
+/**
+ * workpool.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * A fixed pool of worker threads for running many independent jobs (ie. simulated missions) across all cores.
+ *
+ * Each worker has its own queue: submit() deals jobs out to the queues in turn, a worker runs the newest job on its own
+ * queue first and, when that is empty, steals the oldest job from another worker's queue. Jobs that take very
+ * different amounts of time therefore still keep every core busy until the end.
+ *
+ * Jobs must not throw. submit() and wait() are for one (non-worker) thread at a time.
+ */
+
+#ifndef _WORKPOOL_H_INCLUDED
+#define _WORKPOOL_H_INCLUDED
+
+#include <atomic>
+#include <deque>
+#include <pthread.h>
+
+typedef void (*WorkFunction)(void *arg);
+
+struct WorkItem
+{
+	WorkFunction	function;
+	void *			arg;
+};
+
+class WorkPool;
+
+struct WorkQueue
+{
+	pthread_t				thread;
+	pthread_mutex_t			lock;
+	std::deque<WorkItem>	items;
+
+	WorkPool *				pool;
+	unsigned int			index;
+
+	unsigned long			executed;		// jobs run by this worker
+	unsigned long			stolen;			// of which were taken from another worker's queue
+};
+
+class WorkPool
+{
+	private:
+		WorkQueue *			_queues;
+		unsigned int		_nThreads;
+		unsigned int		_nextQueue;
+
+		std::atomic<long>	_queued;		// jobs waiting in any queue
+		unsigned long		_pending;		// jobs submitted and not yet finished
+
+		pthread_mutex_t		_lock;
+		pthread_cond_t		_work;			// signalled when a job is queued or the pool is stopping
+		pthread_cond_t		_done;			// signalled when the last pending job finishes
+
+		bool				_bRun;
+
+		bool				take(WorkQueue *queue, WorkItem *item);
+
+	public:
+		WorkPool(unsigned int nThreads = 0);
+		~WorkPool();
+
+		void			submit(WorkFunction function, void *arg);
+		void			wait();
+
+		unsigned int	getThreadCount() const		{ return _nThreads; }
+		unsigned long	getStolenCount() const;		// only meaningful after wait()
+
+		void *			thread(WorkQueue *queue);
+};
+
+#endif // _WORKPOOL_H_INCLUDED
@@ -0,0 +1,691 @@
+/**
+ * batchsim.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "batchsim.h"
+#include "mission.h"
+#include "../libs/motorlib.h"
+#include "../libs/motorcal.h"
+#include "../libs/looptimer.h"
+#include "../libs/logger.h"
+
+typedef int BatchInt __attribute__((vector_size(BATCH_LANES * sizeof(int))));
+
+/**
+ * A pack of robots' plant and pose estimator state, loaded into locals for the steps of one control period
+ */
+struct BatchPack
+{
+	BatchDouble	slipNoise, distancePerTick, wheelbase;
+
+	BatchDouble	target[2], velocity[2], travel[2], ticks[2];
+	BatchRandom	random;
+
+	BatchDouble	estX, estY, estHeading, estCos, estSin;
+	BatchDouble	trueX, trueY, trueHeading, trueCos, trueSin, trueDistance;
+};
+
+/**
+ * @param double value
+ *
+ * @return BatchDouble	value in every lane
+ */
+static inline BatchDouble batch_broadcast(double value)
+{
+	BatchDouble v = {};
+
+	return v + value;
+}
+
+/**
+ * As SimulatedPlant::random(), for every lane at once
+ *
+ * @param BatchRandom * state
+ *
+ * @return BatchDouble	uniform in [0, 1)
+ */
+static inline BatchDouble batch_random(BatchRandom *state)
+{
+	BatchRandom r = *state;
+
+	r ^= r >> 12;
+	r ^= r << 25;
+	r ^= r >> 27;
+
+	*state = r;
+
+	r = (r * 2685821657736338717ULL) >> 11;
+
+	// 53 bits to double without a 64 bit conversion (AVX2 has none): each half goes into the mantissa of a power of two
+	BatchDouble hi = (BatchDouble)((r >> 32) | 0x4530000000000000ULL) - 19342813113834066795298816.0;	// 2^84
+	BatchDouble lo = (BatchDouble)((r & 0xffffffffULL) | 0x4330000000000000ULL) - 4503599627370496.0;	// 2^52
+
+	return (hi + lo) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @param BatchDouble x		within the range of an int
+ *
+ * @return BatchDouble	floor(x) of every lane
+ */
+static inline BatchDouble batch_floor(BatchDouble x)
+{
+	BatchDouble t = __builtin_convertvector(__builtin_convertvector(x, BatchInt), BatchDouble);
+
+	return x < t ? t - 1.0 : t;
+}
+
+/**
+ * As pose_integrate() with POSE_INTEGRATION_ARC for every lane at once, with the heading also kept as a unit vector.
+ *
+ * sin() and cos() of half the step's turn come from their series, which are exact to rounding for the turns one
+ * physics step makes (well under 0.1 rad) and still good to 1e-9 at 0.5 rad. The heading isn't wrapped.
+ *
+ * @param BatchDouble * x
+ * @param BatchDouble * y
+ * @param BatchDouble * heading
+ * @param BatchDouble * c			cos(heading)
+ * @param BatchDouble * s			sin(heading)
+ * @param BatchDouble	distLeft
+ * @param BatchDouble	distRight
+ * @param BatchDouble	wheelbase
+ */
+static inline void batch_integrate(BatchDouble *x, BatchDouble *y, BatchDouble *heading, BatchDouble *c, BatchDouble *s, BatchDouble distLeft, BatchDouble distRight, BatchDouble wheelbase)
+{
+	BatchDouble dist = (distLeft + distRight) / 2.0;
+	BatchDouble turn = (distRight - distLeft) / wheelbase;
+	BatchDouble half = turn / 2.0;
+	BatchDouble h2   = half * half;
+
+	BatchDouble sinc    = 1.0 - h2 * (1.0/6.0) * (1.0 - h2 * (1.0/20.0) * (1.0 - h2 * (1.0/42.0) * (1.0 - h2 * (1.0/72.0))));
+	BatchDouble cosHalf = 1.0 - h2 * (1.0/2.0) * (1.0 - h2 * (1.0/12.0) * (1.0 - h2 * (1.0/30.0) * (1.0 - h2 * (1.0/56.0))));
+	BatchDouble sinHalf = half * sinc;
+
+	// Along the chord, which points halfway round the arc
+	BatchDouble chord  = dist * sinc;
+	BatchDouble cosMid = (*c * cosHalf) - (*s * sinHalf);
+	BatchDouble sinMid = (*s * cosHalf) + (*c * sinHalf);
+
+	*x += chord * cosMid;
+	*y += chord * sinMid;
+
+	// and on round the other half
+	*c = (cosMid * cosHalf) - (sinMid * sinHalf);
+	*s = (sinMid * cosHalf) + (cosMid * sinHalf);
+
+	*heading += turn;
+}
+
+/**
+ * As SimulatedPlant::step() (without tick drops) for every lane at once
+ *
+ * @param BatchPack & p
+ * @param BatchDouble dt				seconds, 0 in lanes that aren't running
+ * @param BatchDouble alpha			of the first order lag over dt
+ * @param BatchDouble distancePerTick	the pose estimator's, from the controller's profile
+ * @param BatchDouble wheelbase		the pose estimator's
+ */
+static inline void batch_step(BatchPack &p, BatchDouble dt, BatchDouble alpha, BatchDouble distancePerTick, BatchDouble wheelbase)
+{
+	BatchDouble dist[2], delta[2];
+
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		p.velocity[i] += (p.target[i] - p.velocity[i]) * alpha;
+
+		dist[i]  = p.velocity[i] * dt;
+		dist[i] *= 1.0 + p.slipNoise * (2.0 * batch_random(&p.random) - 1.0);
+
+		p.travel[i] += dist[i] / p.distancePerTick;
+
+		BatchDouble ticks = batch_floor(p.travel[i]);
+
+		delta[i]   = ticks - p.ticks[i];
+		p.ticks[i] = ticks;
+	}
+
+	// No ticks moves the estimate by nothing at all, so every lane can be stepped
+	batch_integrate(&p.estX, &p.estY, &p.estHeading, &p.estCos, &p.estSin, delta[MOTOR_LEFT] * distancePerTick, delta[MOTOR_RIGHT] * distancePerTick, wheelbase);
+
+	BatchDouble moved = (dist[MOTOR_LEFT] + dist[MOTOR_RIGHT]) / 2.0;
+
+	p.trueDistance += moved < 0.0 ? -moved : moved;
+
+	batch_integrate(&p.trueX, &p.trueY, &p.trueHeading, &p.trueCos, &p.trueSin, dist[MOTOR_LEFT], dist[MOTOR_RIGHT], p.wheelbase);
+}
+
+/**
+ * @param BatchDouble heading
+ *
+ * @return BatchDouble	in (-pi, pi], for headings less than a revolution outside it
+ */
+static inline BatchDouble batch_wrap(BatchDouble heading)
+{
+	heading = heading > M_PI ? heading - (2.0 * M_PI) : heading;
+
+	return heading <= -M_PI ? heading + (2.0 * M_PI) : heading;
+}
+
+/**
+ * ctor, configured as a Controller and Mission would be (loop rate, blend radius, gains and motor calibration)
+ *
+ * @param std::vector<SimulatedPlantParams> & robots	one per robot
+ * @param RobotProfile &						 profile	the robot the controller thinks it is driving
+ */
+BatchSimulator::BatchSimulator(const std::vector<SimulatedPlantParams> &robots, const RobotProfile &profile) : _profile(profile), _gains(profile), _params(robots)
+{
+	_logger       = new Logger("BatchSimulator");
+	_nRobots      = robots.size();
+	_nPacks       = (_nRobots + BATCH_LANES - 1) / BATCH_LANES;
+	_steps        = 0;
+	_fBlendRadius = MISSION_BLEND_RADIUS;
+	_periodNs     = 1000000000ULL / CONTROLLER_LOOP_RATE;
+
+	const char *rate = getenv(CONTROLLER_LOOP_RATE_ENV);
+
+	if (rate && *rate && setLoopRate(atoi(rate)) < 0)
+	{
+		_logger->notice("ctor: ignoring %s=%s, running the control loop at %llu Hz", CONTROLLER_LOOP_RATE_ENV, rate, 1000000000ULL / _periodNs);
+	}
+
+	const char *radius = getenv(MISSION_BLEND_RADIUS_ENV);
+
+	if (radius && *radius && setBlendRadius(atof(radius)) < 0)
+	{
+		_logger->notice("ctor: ignoring %s=%s, blending within %.1f cm", MISSION_BLEND_RADIUS_ENV, radius, _fBlendRadius);
+	}
+
+	const char *tracking = getenv(CONTROLLER_TRACKING_ENV);
+
+	if (tracking && strcmp(tracking, "pursuit") == 0)
+	{
+		_logger->notice("ctor: ignoring %s=%s, only heading tracking is simulated", CONTROLLER_TRACKING_ENV, tracking);
+	}
+
+	if (_gains.load() < 0)
+	{
+		_logger->notice("ctor: no gains in %s, using the defaults", ControllerGains::getDefaultFile());
+	}
+
+	_motorCal = new MotorCalibration();
+
+	if (_motorCal->load() < 0)
+	{
+		_logger->notice("ctor: no motor calibration in %s, using the default velocity to PWM fits", MotorCalibration::getDefaultFile());
+	}
+
+	_controllers.resize(_nRobots);
+
+	_timeConstant.resize(_nPacks);
+	_slipNoise.resize(_nPacks);
+	_distancePerTick.resize(_nPacks);
+	_wheelbase.resize(_nPacks);
+	_active.resize(_nPacks);
+	_random.resize(_nPacks);
+
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		_target[i].resize(_nPacks);
+		_velocity[i].resize(_nPacks);
+		_travel[i].resize(_nPacks);
+		_ticks[i].resize(_nPacks);
+	}
+
+	_estX.resize(_nPacks);
+	_estY.resize(_nPacks);
+	_estHeading.resize(_nPacks);
+	_estCos.resize(_nPacks);
+	_estSin.resize(_nPacks);
+
+	_trueX.resize(_nPacks);
+	_trueY.resize(_nPacks);
+	_trueHeading.resize(_nPacks);
+	_trueCos.resize(_nPacks);
+	_trueSin.resize(_nPacks);
+	_trueDistance.resize(_nPacks);
+
+	// The lanes past the last robot are never run, but are kept finite
+	for (unsigned int r = 0; r < _nPacks * BATCH_LANES; r++)
+	{
+		const SimulatedPlantParams *params = r < _nRobots ? &_params[r] : NULL;
+
+		setLane(_timeConstant, r, params ? params->timeConstant : 1.0);
+		setLane(_slipNoise, r, params ? params->slipNoise : 0.0);
+		setLane(_distancePerTick, r, params ? (2.0 * M_PI * params->wheelRadius) / params->ticksPerRevolution : 1.0);
+		setLane(_wheelbase, r, params ? params->wheelbase : 1.0);
+
+		if (params && params->tickDropRate > 0.0)
+		{
+			_logger->notice("ctor: robot %u drops encoder ticks, which is not simulated", r);
+		}
+	}
+}
+
+/**
+ * dtor
+ */
+BatchSimulator::~BatchSimulator()
+{
+	delete _motorCal;
+	delete _logger;
+}
+
+/**
+ * BatchSimulator::setLoopRate - as Controller::setLoopRate()
+ *
+ * @param unsigned int rateHz
+ *
+ * @return int	0 on success, -EINVAL if out of range
+ */
+int BatchSimulator::setLoopRate(unsigned int rateHz)
+{
+	if (rateHz == 0 || rateHz > LOOPTIMER_RATE_MAX)
+	{
+		return -EINVAL;
+	}
+
+	_periodNs = 1000000000ULL / rateHz;
+
+	return 0;
+}
+
+/**
+ * BatchSimulator::setBlendRadius - as Mission::setBlendRadius()
+ *
+ * @param double fBlendRadius	cm, 0 to stop at every waypoint
+ *
+ * @return int	0 on success, -EINVAL if negative
+ */
+int BatchSimulator::setBlendRadius(double fBlendRadius)
+{
+	if (fBlendRadius < 0.0)
+	{
+		return -EINVAL;
+	}
+
+	_fBlendRadius = fBlendRadius;
+
+	return 0;
+}
+
+/**
+ * BatchSimulator::getTruePose
+ *
+ * @param unsigned int robot
+ *
+ * @return Pose		where the robot really is, as SimulatedPlant::getTruePose()
+ */
+Pose BatchSimulator::getTruePose(unsigned int robot) const
+{
+	Pose pose;
+
+	pose.x         = getLane(_trueX, robot);
+	pose.y         = getLane(_trueY, robot);
+	pose.heading   = getLane(_trueHeading, robot);
+	pose.timestamp = _controllers[robot].transitNs / 1000000;
+
+	return pose;
+}
+
+/**
+ * BatchSimulator::reset - every robot stopped at the origin with its noise stream from the start, as a newly built
+ * SimulatedPlant and Controller
+ *
+ * @return void
+ */
+void BatchSimulator::reset()
+{
+	BatchController controller;
+
+	memset(&controller, 0, sizeof(controller));
+	controller.bLegStart = true;
+
+	for (unsigned int r = 0; r < _nRobots; r++)
+	{
+		_controllers[r] = controller;
+	}
+
+	for (unsigned int r = 0; r < _nPacks * BATCH_LANES; r++)
+	{
+		unsigned long long seed = r < _nRobots ? _params[r].seed : 1;
+
+		_random[r / BATCH_LANES][r % BATCH_LANES] = seed ? seed : 1;
+
+		setLane(_active, r, r < _nRobots ? 1.0 : 0.0);
+	}
+
+	BatchDouble zero = batch_broadcast(0.0), one = batch_broadcast(1.0);
+
+	for (unsigned int p = 0; p < _nPacks; p++)
+	{
+		for (unsigned int i = 0; i < 2; i++)
+		{
+			_target[i][p] = _velocity[i][p] = zero;
+			_travel[i][p] = _ticks[i][p]    = zero;
+		}
+
+		_estX[p]  = _estY[p]  = _estHeading[p]  = _estSin[p]  = zero;
+		_trueX[p] = _trueY[p] = _trueHeading[p] = _trueSin[p] = _trueDistance[p] = zero;
+
+		_estCos[p] = _trueCos[p] = one;
+	}
+
+	_steps = 0;
+}
+
+/**
+ * BatchSimulator::run - fly every robot through the waypoints, as Mission::run()
+ *
+ * @param Waypoint *   waypoints
+ * @param unsigned int nWaypoints
+ *
+ * @return unsigned int	the number of robots that reached every waypoint
+ */
+unsigned int BatchSimulator::run(const Waypoint *waypoints, unsigned int nWaypoints)
+{
+	unsigned int nRunning = nWaypoints > 0 ? _nRobots : 0, nSucceeded = 0;
+
+	reset();
+
+	_logger->notice("run: %u robots in packs of %u through %u waypoints, blending within %.1f cm", _nRobots, BATCH_LANES, nWaypoints, _fBlendRadius);
+
+	while (nRunning > 0)
+	{
+		nRunning = 0;
+
+		// Every robot's controller sees the pose from the end of the last period and sets its wheels for the next
+		for (unsigned int r = 0; r < _nRobots; r++)
+		{
+			if ( ! _controllers[r].bDone && control(r, waypoints, nWaypoints))
+			{
+				nRunning++;
+			}
+		}
+
+		for (unsigned int p = 0; p < _nPacks && nRunning > 0; p++)
+		{
+			advance(p, _periodNs);
+		}
+	}
+
+	for (unsigned int r = 0; r < _nRobots; r++)
+	{
+		nSucceeded += (_controllers[r].nReached == nWaypoints);
+	}
+
+	_logger->notice("run: %u of %u robots reached every waypoint in %llu robot-steps", nSucceeded, _nRobots, _steps);
+
+	return nSucceeded;
+}
+
+/**
+ * BatchSimulator::control - one iteration of Controller::transit() for a robot, then any legs that start at once
+ *
+ * @param unsigned int robot
+ * @param Waypoint *   waypoints
+ * @param unsigned int nWaypoints
+ *
+ * @return bool		false once the robot's mission is over
+ */
+bool BatchSimulator::control(unsigned int robot, const Waypoint *waypoints, unsigned int nWaypoints)
+{
+	BatchController &c = _controllers[robot];
+
+	while ( ! c.bDone)
+	{
+		const Waypoint &to = waypoints[c.leg];
+
+		bool   bBlend         = c.leg + 1 < nWaypoints && _fBlendRadius > 0.0;
+		double fArrivalRadius = bBlend ? _fBlendRadius : CONTROLLER_ARRIVAL_RADIUS;
+
+		if (c.bLegStart)
+		{
+			c.bLegStart              = false;
+			c.iteration              = 0;
+			c.dtNs                   = 0;
+			c.legNs                  = 0;
+			c.distanceLast           = 0.0;
+			c.distanceInitial        = 0.0;
+			c.distanceAtStartOfDrift = 0.0;
+			c.nIncreasingDistance    = 0;
+			c.bApproaching           = false;
+		}
+
+		if (c.iteration % 10 == 0)
+		{
+			c.headingRef = controller_heading(to.x, to.y, c.pose.x, c.pose.y, c.pose.heading);
+		}
+
+		c.legNs     += c.dtNs;
+		c.transitNs += c.dtNs;
+
+		double dt = c.dtNs / 1000000000.0;
+
+		// The estimator's pose from the end of the last period. The unit vectors the physics steps rotate are refreshed
+		// from the headings, so rounding doesn't build up in them.
+		c.pose.x         = getLane(_estX, robot);
+		c.pose.y         = getLane(_estY, robot);
+		c.pose.heading   = getLane(_estHeading, robot);
+		c.pose.timestamp = c.transitNs / 1000000;
+
+		setLane(_estCos, robot, cos(c.pose.heading));
+		setLane(_estSin, robot, sin(c.pose.heading));
+		setLane(_trueCos, robot, cos(getLane(_trueHeading, robot)));
+		setLane(_trueSin, robot, sin(getLane(_trueHeading, robot)));
+
+		double fHeadingErrorRaw = c.headingRef - c.pose.heading;
+		double fHeadingError    = atan2(sin(fHeadingErrorRaw), cos(fHeadingErrorRaw));
+		double fForwardVelocity = _gains.cruiseVelocity;
+		double fDistance        = sqrt(((to.x - c.pose.x)*(to.x - c.pose.x)) + ((to.y - c.pose.y)*(to.y - c.pose.y)));
+
+		if (c.iteration == 0)
+		{
+			c.distanceInitial = fDistance;
+		}
+		else if (fDistance >= c.distanceLast)
+		{
+			if (c.nIncreasingDistance == 0)
+			{
+				c.distanceAtStartOfDrift = fDistance;
+			}
+
+			c.nIncreasingDistance++;
+
+			if (fDistance - c.distanceAtStartOfDrift >= (0.25 * c.distanceInitial))
+			{
+				endLeg(robot, nWaypoints, -ERANGE);
+				continue;
+			}
+		}
+		else
+		{
+			c.nIncreasingDistance = 0;
+		}
+
+		if ( ! bBlend && (fDistance < CONTROLLER_APPROACH_RADIUS || c.bApproaching))
+		{
+			c.bApproaching   = true;
+			fForwardVelocity = _gains.approachVelocity;
+		}
+
+		if (fDistance <= fArrivalRadius)
+		{
+			endLeg(robot, nWaypoints, 0);
+			continue;
+		}
+
+		if (c.legNs > CONTROLLER_LEG_TIMEOUT_NS)
+		{
+			endLeg(robot, nWaypoints, -ETIMEDOUT);
+			continue;
+		}
+
+		c.distanceLast = fDistance;
+
+		double fHeadingErrorDerivative = dt > 0.0 ? (fHeadingError - c.headingErrorPrev) / dt : 0.0;
+		c.headingErrorIntegral        += (fHeadingError * dt);
+		c.headingErrorPrev             = fHeadingError;
+
+		double u = (_gains.proportional * fHeadingError) + (_gains.integral * c.headingErrorIntegral) + (_gains.derivative * fHeadingErrorDerivative);
+
+		drive(robot, MOTOR_LEFT,  ((2.0*fForwardVelocity) - (u*_profile.wheelbase)) / (2.0*_profile.wheelRadius));
+		drive(robot, MOTOR_RIGHT, ((2.0*fForwardVelocity) + (u*_profile.wheelbase)) / (2.0*_profile.wheelRadius));
+
+		c.dtNs = _periodNs;
+		c.iteration++;
+
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * BatchSimulator::endLeg - on to the next waypoint, or stop as Mission::end() does after the last
+ *
+ * @param unsigned int robot
+ * @param unsigned int nWaypoints
+ * @param int		   result		as Controller::transit()
+ *
+ * @return void
+ */
+void BatchSimulator::endLeg(unsigned int robot, unsigned int nWaypoints, int result)
+{
+	BatchController &c = _controllers[robot];
+
+	c.nReached += (result == 0);
+
+	if (++c.leg < nWaypoints)
+	{
+		c.bLegStart = true;
+		return;
+	}
+
+	// The wheels would spin down, but nothing steps a plant once its mission is over
+	c.bDone = true;
+
+	setLane(_target[MOTOR_LEFT], robot, 0.0);
+	setLane(_target[MOTOR_RIGHT], robot, 0.0);
+	setLane(_active, robot, 0.0);
+}
+
+/**
+ * BatchSimulator::drive - controller_duty() into SimulatedPlant::drive(), leaving the speed the wheel will settle at
+ *
+ * @param unsigned int robot
+ * @param unsigned int motor		MOTOR_LEFT or MOTOR_RIGHT
+ * @param double	   fVelocity	cm/s, negative in reverse
+ *
+ * @return void
+ */
+void BatchSimulator::drive(unsigned int robot, unsigned int motor, double fVelocity)
+{
+	int duty = static_cast<int>(round(controller_duty(_motorCal, motor == MOTOR_LEFT, fVelocity)));
+
+	duty = duty > 100 ? 100 : duty;
+
+	setLane(_target[motor], robot, _params[robot].motors[motor].getVelocity(fVelocity >= 0.0 ? duty : -duty));
+}
+
+/**
+ * BatchSimulator::advance - run a pack's physics for a period, as SimulatedPlant::advance()
+ *
+ * @param unsigned int		 pack
+ * @param unsigned long long periodNs
+ *
+ * @return void
+ */
+void BatchSimulator::advance(unsigned int pack, unsigned long long periodNs)
+{
+	BatchPack   p;
+	BatchDouble  active          = _active[pack];
+	BatchDouble  distancePerTick = batch_broadcast(_profile.getDistancePerTick());
+	BatchDouble  wheelbase       = batch_broadcast(_profile.wheelbase);
+	unsigned int nActive         = 0;
+
+	for (unsigned int l = 0; l < BATCH_LANES; l++)
+	{
+		nActive += (active[l] != 0.0);
+	}
+
+	if (nActive == 0)
+	{
+		return;
+	}
+
+	p.slipNoise       = _slipNoise[pack];
+	p.distancePerTick = _distancePerTick[pack];
+	p.wheelbase       = _wheelbase[pack];
+	p.random          = _random[pack];
+
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		p.target[i]   = _target[i][pack];
+		p.velocity[i] = _velocity[i][pack];
+		p.travel[i]   = _travel[i][pack];
+		p.ticks[i]    = _ticks[i][pack];
+	}
+
+	p.estX         = _estX[pack];
+	p.estY         = _estY[pack];
+	p.estHeading   = _estHeading[pack];
+	p.estCos       = _estCos[pack];
+	p.estSin       = _estSin[pack];
+	p.trueX        = _trueX[pack];
+	p.trueY        = _trueY[pack];
+	p.trueHeading  = _trueHeading[pack];
+	p.trueCos      = _trueCos[pack];
+	p.trueSin      = _trueSin[pack];
+	p.trueDistance = _trueDistance[pack];
+
+	unsigned long long remainingNs = periodNs;
+
+	while (remainingNs > 0)
+	{
+		// Whole steps first, then whatever is left over, as SimulatedPlant::advance() cuts the period
+		unsigned long long stepNs = remainingNs < PLANTSIM_STEP_NS ? remainingNs : PLANTSIM_STEP_NS;
+		unsigned long long nSteps = remainingNs / stepNs;
+
+		BatchDouble dt    = active * (stepNs / 1000000000.0);
+		BatchDouble alpha = dt / (_timeConstant[pack] + dt);
+
+		for (unsigned long long s = 0; s < nSteps; s++)
+		{
+			batch_step(p, dt, alpha, distancePerTick, wheelbase);
+		}
+
+		remainingNs -= nSteps * stepNs;
+		_steps      += nSteps * nActive;
+	}
+
+	p.estHeading  = batch_wrap(p.estHeading);
+	p.trueHeading = batch_wrap(p.trueHeading);
+
+	_random[pack] = p.random;
+
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		_velocity[i][pack] = p.velocity[i];
+		_travel[i][pack]   = p.travel[i];
+		_ticks[i][pack]    = p.ticks[i];
+	}
+
+	_estX[pack]         = p.estX;
+	_estY[pack]         = p.estY;
+	_estHeading[pack]   = p.estHeading;
+	_estCos[pack]       = p.estCos;
+	_estSin[pack]       = p.estSin;
+	_trueX[pack]        = p.trueX;
+	_trueY[pack]        = p.trueY;
+	_trueHeading[pack]  = p.trueHeading;
+	_trueCos[pack]      = p.trueCos;
+	_trueSin[pack]      = p.trueSin;
+	_trueDistance[pack] = p.trueDistance;
+}
@@ -0,0 +1,143 @@
+/**
+ * batchsim.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Flies many simulated robots through the same waypoint mission at once, for Monte Carlo runs of the go-to-goal
+ * controller where building a Controller, SimulatedPlant and Mission for every robot in turn is too slow.
+ *
+ * Every robot runs what Controller::transit() (heading PID tracking) and Mission run against a SimulatedPlant: the leg
+ * and blend radius logic, the PID, the velocity to PWM conversion, the motors, encoders, PoseEstimator and true pose.
+ * The robots are stepped in lockstep on one virtual clock, which the controller's fixed rate loop allows: every robot
+ * is controlled at the same instants, a robot that has finished its mission simply stops being stepped.
+ *
+ * The plant's 1ms physics steps are nearly all of the work. Their state is kept as a structure of arrays, packs of
+ * BATCH_LANES robots held in SIMD vectors (GCC vector extensions, so SSE2/AVX/AVX-512 on x86 and NEON on AArch64
+ * depending on what the compiler is allowed to use, ie. -march=native). Each robot has its own noise stream, the same
+ * xorshift64* sequence its SimulatedPlant would draw, so a robot flies the same mission as it would alone with the
+ * scalar controller. The per robot control step (20 Hz by default) stays scalar.
+ *
+ * The results match the scalar controller to within floating point rounding (the heading is advanced by rotating a
+ * unit vector rather than calling sin() and cos() every step), see demo_batch. Not modelled: pure pursuit tracking and
+ * encoder tick drops (SimulatedPlantParams::tickDropRate), robots with either are flown without them.
+ */
+
+#ifndef _BATCHSIM_H_INCLUDED
+#define _BATCHSIM_H_INCLUDED
+
+#include <vector>
+
+#include "../libs/plantsim.h"
+#include "../libs/robotprofile.h"
+#include "controller.h"
+#include "gains.h"
+
+#ifndef BATCH_LANES
+#if defined(__AVX512F__)
+#define BATCH_LANES 8
+#elif defined(__AVX__)
+#define BATCH_LANES 4
+#elif defined(__SSE2__) || defined(__aarch64__)
+#define BATCH_LANES 2
+#else
+#define BATCH_LANES 1					// no double precision SIMD (ie. ARMv7 NEON), plain scalar code
+#endif
+#endif
+
+typedef double				BatchDouble __attribute__((vector_size(BATCH_LANES * sizeof(double))));
+typedef unsigned long long	BatchRandom __attribute__((vector_size(BATCH_LANES * sizeof(unsigned long long))));
+
+class Logger;
+class MotorCalibration;
+
+/**
+ * One robot's controller: Controller::transit()'s state for the leg being flown and Mission's for the whole mission.
+ */
+struct BatchController
+{
+	unsigned int		leg;						// index of the waypoint being driven to
+	unsigned int		nReached;					// legs that ended at their waypoint
+	bool				bLegStart;					// the next control step starts the leg
+	bool				bDone;						// the mission is over, the robot is stopped
+
+	unsigned int		iteration;
+	unsigned long long	dtNs;						// time since the last control step of this leg
+	unsigned long long	legNs;						// time on this leg
+	unsigned long long	transitNs;					// time on the whole mission
+
+	Pose				pose;						// (believed) current pose
+
+	double				headingRef;
+	double				headingErrorPrev;
+	double				headingErrorIntegral;
+
+	double				distanceLast;
+	double				distanceInitial;
+	double				distanceAtStartOfDrift;
+	unsigned int		nIncreasingDistance;
+	bool				bApproaching;
+};
+
+class BatchSimulator
+{
+	private:
+		RobotProfile		_profile;
+		ControllerGains		_gains;
+		double				_fBlendRadius;
+		unsigned long long	_periodNs;
+
+		unsigned int		_nRobots;
+		unsigned int		_nPacks;
+		unsigned long long	_steps;					// robot-steps (one robot, one physics step) so far
+
+		std::vector<SimulatedPlantParams> _params;
+		std::vector<BatchController> _controllers;
+
+		// The plant and pose estimator, BATCH_LANES robots per element
+		std::vector<BatchDouble> _timeConstant, _slipNoise, _distancePerTick, _wheelbase;
+		std::vector<BatchDouble> _active;			// 1.0 while a robot's mission is running, 0.0 freezes it
+
+		std::vector<BatchDouble> _target[2];		// velocity each wheel is heading for at its duty cycle (cm/s)
+		std::vector<BatchDouble> _velocity[2];		// cm/s
+		std::vector<BatchDouble> _travel[2];		// encoder position in (fractional) ticks
+		std::vector<BatchDouble> _ticks[2];			// whole ticks counted by the encoder
+		std::vector<BatchRandom> _random;			// xorshift64* state
+
+		std::vector<BatchDouble> _estX, _estY, _estHeading, _estCos, _estSin;
+		std::vector<BatchDouble> _trueX, _trueY, _trueHeading, _trueCos, _trueSin, _trueDistance;
+
+		MotorCalibration *	_motorCal;
+		Logger *			_logger;
+
+		double				getLane(const std::vector<BatchDouble> &v, unsigned int robot) const	{ return v[robot / BATCH_LANES][robot % BATCH_LANES]; }
+		void				setLane(std::vector<BatchDouble> &v, unsigned int robot, double value)	{ v[robot / BATCH_LANES][robot % BATCH_LANES] = value; }
+
+		void				reset();
+		bool				control(unsigned int robot, const Waypoint *waypoints, unsigned int nWaypoints);
+		void				endLeg(unsigned int robot, unsigned int nWaypoints, int result);
+		void				drive(unsigned int robot, unsigned int motor, double fVelocity);
+		void				advance(unsigned int pack, unsigned long long periodNs);
+
+	public:
+		BatchSimulator(const std::vector<SimulatedPlantParams> &robots, const RobotProfile &profile = ROBOT_PROFILE_OROBOTO);
+		~BatchSimulator();
+
+		unsigned int		run(const Waypoint *waypoints, unsigned int nWaypoints);
+
+		int					setLoopRate(unsigned int rateHz);
+		int					setBlendRadius(double fBlendRadius);
+
+		void				setGains(const ControllerGains &gains)	{ _gains = gains; }
+		const ControllerGains & getGains() const				{ return _gains; }
+
+		unsigned int		getRobotCount() const				{ return _nRobots; }
+		unsigned long long	getStepCount() const				{ return _steps; }
+
+		Pose				getTruePose(unsigned int robot) const;
+		double				getTrueDistance(unsigned int robot) const	{ return getLane(_trueDistance, robot); }
+		Pose				getCurrentPose(unsigned int robot) const	{ return _controllers[robot].pose; }
+		unsigned long long	getTransitNs(unsigned int robot) const		{ return _controllers[robot].transitNs; }
+		unsigned int		getReachedCount(unsigned int robot) const	{ return _controllers[robot].nReached; }
+};
+
+#endif // _BATCHSIM_H_INCLUDED
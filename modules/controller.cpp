@@ -12,7 +12,7 @@
 #include <pthread.h>
 #include <fcntl.h>
 #include <math.h>
-#include <sys/time.h>
+#include <errno.h>
 
 #include "controller.h"
 #include "../libs/motorlib.h"
@@ -21,25 +21,114 @@
 #include "../libs/logger.h"
 #include "../libs/dotlog.h"
 #include "../libs/odo.h"
+#include "../libs/poseestimator.h"
+#include "../libs/poseintegrator.h"
+#include "../libs/plant.h"
 #include "../libs/poseprovider.h"
+#include "../libs/actuator.h"
+#include "../libs/motorcal.h"
 
-Controller::Controller()
+/**
+ * ctor
+ *
+ * @param Plant *		  plant		drive this rather than the robot's motors and encoders (NULL for the robot)
+ * @param RobotProfile & profile	the robot being driven (or simulated)
+ */
+Controller::Controller(Plant *plant, const RobotProfile &profile) : _profile(profile), _gains(profile), _loop(CONTROLLER_LOOP_RATE)
 {
-	_totalTime  = 0;
+	_totalTimeNs = 0;
 	_bSimulation = false;	// (debug) simulate movement rather than actually turning wheels
+	_bMoving     = false;
+	_tracking    = CONTROLLER_TRACKING_HEADING;
+	_fVelocity   = 0.0;
 
 	_logger = new Logger("Controller");
-	_odo    = new Odometer(LEFT_WHEEL_ENCODER_GPIO_A, LEFT_WHEEL_ENCODER_GPIO_B, RIGHT_WHEEL_ENCODER_GPIO_A, RIGHT_WHEEL_ENCODER_GPIO_B, CONTROLLER_WHEELRADIUS);
+	_plant  = plant;
+
+	// The pose is integrated as each encoder edge is decoded (by the odometry thread, or the plant)
+	_poseEstimator = new PoseEstimator(_profile.wheelRadius, _profile.wheelbase, _profile.ticksPerRevolution);
+
+	if (_plant)
+	{
+		_plant->setPoseEstimator(_poseEstimator);
+
+		_odo            = NULL;
+		_dotLogPosition = NULL;
+		_ledHealth      = NULL;
+		_ledProximity   = NULL;
+	}
+	else
+	{
+		_odo = new Odometer(_profile);
+		_odo->setPoseEstimator(_poseEstimator);
+
+		_dotLogPosition = new DotLog("position");
+
+		_ledHealth      = new Led(1);
+		_ledProximity   = new Led(3);
+	}
+
+	const char *rate = getenv(CONTROLLER_LOOP_RATE_ENV);
 
-	_dotLogPosition = new DotLog("position");
+	if (rate && *rate && setLoopRate(atoi(rate)) < 0)
+	{
+		_logger->notice("ctor: ignoring %s=%s, running the control loop at %u Hz", CONTROLLER_LOOP_RATE_ENV, rate, _loop.getRate());
+	}
+
+	const char *tracking = getenv(CONTROLLER_TRACKING_ENV);
+
+	if (tracking && strcmp(tracking, "pursuit") == 0)
+	{
+		_tracking = CONTROLLER_TRACKING_PURSUIT;
+	}
+
+	// Use tuned gains if there are any (see demo_gotogoal/tune), otherwise the hand-tuned defaults
+	if (_gains.load() < 0)
+	{
+		_logger->notice("ctor: no gains in %s, using the defaults", ControllerGains::getDefaultFile());
+	}
+
+	// Use this robot's measured motor curves if it has been calibrated, otherwise the fits below
+	_motorCal = new MotorCalibration();
+
+	if (_motorCal->load() < 0)
+	{
+		_logger->notice("ctor: no motor calibration in %s, using the default velocity to PWM fits", MotorCalibration::getDefaultFile());
+	}
 
 	reset();
-	_odo->run();
+
+	if ( ! _plant)
+	{
+		// Motor and LED writes from the control loop are coalesced and written by the actuator thread
+		actuator_start();
+
+		_odo->run();
+	}
 }
 
+/**
+ * dtor
+ */
 Controller::~Controller()
 {
 	_logger->notice("dtor: destroying");
+
+	if ( ! _plant)
+	{
+		delete _ledHealth;
+		delete _ledProximity;
+
+		// Stops the odometry thread, which steps the pose estimator
+		delete _odo;
+		delete _dotLogPosition;
+
+		actuator_stop();
+	}
+
+	delete _poseEstimator;
+	delete _motorCal;
+	delete _logger;
 }
 
 /**
@@ -62,6 +151,9 @@ void Controller::reset()
     _currentPose.heading = 0.0;
     _currentPose.timestamp = 0;
 
+    _poseEstimator->reset(_currentPose, _plant ? _plant->getTimeNs() : 0);
+    publishPose(_currentPose);
+
     resetDistance();
 }
 
@@ -81,7 +173,7 @@ void Controller::resetDistance()
 }
 
 /**
- * Controller::goToPosition
+ * Controller::goToPosition - drive to a waypoint and stop there
  *
  * @param double x					desired waypoint x co-ord
  * @param double y					desired waypoing y co-ord
@@ -91,25 +183,56 @@ void Controller::resetDistance()
  * @return void
  */
 void Controller::goToPosition(double x, double y, double fPosXStated, double fPosYStated)
+{
+	transit(x, y);
+	stop();
+}
+
+/**
+ * Controller::transit - drive to a waypoint, leaving the wheels turning at the end
+ *
+ * With no blend radius the robot slows down on the approach and the leg ends within CONTROLLER_ARRIVAL_RADIUS of the
+ * waypoint. With one the robot keeps its cruise velocity and the leg ends as soon as it is within the blend radius, so
+ * the next leg can carry on from there without stopping (see mission.h). Either way it is up to the caller to stop().
+ *
+ * With CONTROLLER_TRACKING_PURSUIT the robot follows the straight line from where it is now to the waypoint instead,
+ * see pursue(), and the next waypoint (if any) sets how fast it can be going at this one.
+ *
+ * @param double x					desired waypoint x co-ord
+ * @param double y					desired waypoint y co-ord
+ * @param double fBlendRadius		0 to arrive at the waypoint, otherwise hand over to the next leg within this (cm)
+ * @param Waypoint * next			the waypoint after this one, if known
+ *
+ * @return int	0 if the waypoint was reached, -ERANGE if the robot was getting further away, -ETIMEDOUT if it took more
+ * 				than CONTROLLER_LEG_TIMEOUT_NS
+ */
+int Controller::transit(double x, double y, double fBlendRadius, const Waypoint *next)
 {
 	double  		fTargetVectorMagnitude;             	// current distance between where we think we are and the waypoint
 	double  		fTargetVectorMagnitudeLast = 0;			// last distance between where we think we were and the waypoint
 	double  		fTargetVectorMagnitudeInitial = 0;		// initial distance between where we think we are and the waypoint
-	double			fTargetVectorMagnitudeAtStartOfDrift;	// if we begin to get further from the target (rather than closer, perhaps due to a turning circle) what was our distance to the target when this started?
+	double			fTargetVectorMagnitudeAtStartOfDrift = 0;	// if we begin to get further from the target (rather than closer, perhaps due to a turning circle) what was our distance to the target when this started?
 	unsigned int  	nConsecutiveIncreasingDistance = 0;		// number of times the distance has increased rather than decrease (used to stop out of controlness)
 	bool			bApproachingTarget = false;				// once we start approaching the target don't forget it
+	bool			bBlend = fBlendRadius > 0.0;			// hand over to the next leg rather than arrive
+	double			fArrivalRadius = bBlend ? fBlendRadius : CONTROLLER_ARRIVAL_RADIUS;
+	int				ret = 0;
 
 	double       	fVelocityLeft = 0, fVelocityRight = 0;	// current velocity of left and right wheels
 
-	Led    			ledHealth(1), ledProximity(3);
+	Waypoint		from = { _currentPose.x, _currentPose.y };	// the path followed by pure pursuit
+	Waypoint		to   = { x, y };
 
-	ledHealth.off();
-	ledProximity.off();
+	if (_ledHealth)
+	{
+		_ledHealth->off();
+		_ledProximity->off();
+	}
 
 	// Reset the distance counters that are used in the PID loop, they are relative to our last (this) waypoint
 	resetDistance();
 
-	_logger->notice("goToPosition: --- START ---\nGoing to position (%.2f, %.2f) from current position (%.2f, %.2f) and heading [%.2f] ...", x, y, _currentPose.x, _currentPose.y, _currentPose.heading);
+	_logger->notice("goToPosition: --- START ---\n%s position (%.2f, %.2f) from current position (%.2f, %.2f) and heading [%.2f] ...", bBlend ? "Passing" : "Going to", x, y, _currentPose.x, _currentPose.y, _currentPose.heading);
 
 	_fPosXRef = x;
 	_fPosYRef = y;
@@ -121,16 +244,26 @@ void Controller::goToPosition(double x, double y, double fPosXStated, double fPo
 	_logger->notice("goToPosition: new heading required is [%.2f]", _fHeadingRef);
 
 	// Start (and reset) the odometry thread
-	_odo->reset();
+	if (_plant)
+	{
+		_plant->resetDistance();
+	}
+	else
+	{
+		_odo->reset();
+	}
 
 	int          	iteration = 0;
 	bool          	bFirstIteration = true;
 
-   	struct timeval 	tvNow, tvLast;
-   	int           	nsec;
-   	unsigned long 	delayms, totaldelayms = 0;	// time since last iteration and total time in this waypoint
+   	unsigned long long dtNs = 0, totalNs = 0;	// time since last iteration and total time in this waypoint
 
-   	gettimeofday(&tvLast, NULL);
+   	// The first iteration runs now, each one after that on the loop's next deadline (if the last leg handed over to
+   	// this one, the loop is still on its deadlines and has just woken up)
+   	if ( ! _bMoving)
+   	{
+   		_loop.start();
+   	}
 
 	while (true)
     {
@@ -144,36 +277,20 @@ void Controller::goToPosition(double x, double y, double fPosXStated, double fPo
 			_logger->notice("new heading is %.2f", _fHeadingRef);
 		}
 
-		gettimeofday(&tvNow, NULL);
-
-	    if (tvNow.tv_usec < tvLast.tv_usec)
-	    {
-	        nsec = (tvLast.tv_usec - tvNow.tv_usec) / 1000000 + 1;
-	        tvLast.tv_usec -= 1000000 * nsec;
-	        tvLast.tv_sec  += nsec;
-	    }
-
-	    if (tvNow.tv_usec - tvLast.tv_usec > 1000000)
-	    {
-	        nsec = (tvLast.tv_usec - tvNow.tv_usec) / 1000000;
-	        tvLast.tv_usec += 1000000 * nsec;
-	        tvLast.tv_sec  -= nsec;
-	    }
-
-	    // How long did we sleep since the last iteration? Required for derivatives.
-	    delayms = ((tvNow.tv_sec - tvLast.tv_sec) * 1000) + ((tvNow.tv_usec - tvLast.tv_usec) / 1000);
-	    totaldelayms += delayms;	// total time in this waypoint segment
-	    _totalTime   += delayms;	// total time transiting altogether
-	    tvLast        = tvNow;
+	    totalNs      += dtNs;		// total time in this waypoint segment
+	    _totalTimeNs += dtNs;		// total time transiting altogether
 
-	    _currentPose.timestamp = _totalTime;
+	    _currentPose.timestamp = _totalTimeNs / 1000000;
 
-	    // How long have we slept? This is required for our integral and derivative PID values.
-    	double dt = delayms / 1000.0;
+	    // How long have we slept? This is required for our integral and derivative PID values (0 on the first iteration).
+    	double dt = dtNs / 1000000000.0;
 
-        ledHealth.strobe();
+        if (_ledHealth)
+        {
+        	_ledHealth->strobe();
+        }
 
-       	_logger->notice("goToPosition: %lu --- ITERATION %d --- \nreference: (%.2f, %.2f, distance: %.2f) at heading %.2f (total runtime: %lu) (dt: %.2f)", delayms, iteration, _fPosXRef, _fPosYRef, fTargetVectorMagnitudeInitial, _fHeadingRef, totaldelayms, dt);
+       	_logger->notice("goToPosition: %llu --- ITERATION %d --- \nreference: (%.2f, %.2f, distance: %.2f) at heading %.2f (total runtime: %llu) (dt: %.4f)", dtNs / 1000000, iteration, _fPosXRef, _fPosYRef, fTargetVectorMagnitudeInitial, _fHeadingRef, totalNs / 1000000, dt);
 
         // How far has each wheel travelled? This is total distance since odo reset (start of waypoint).
         if (_bSimulation)
@@ -182,29 +299,39 @@ void Controller::goToPosition(double x, double y, double fPosXStated, double fPo
             _fDistLeft  += dt * fVelocityLeft;
             _fDistRight += dt * fVelocityRight;
         }
+        else if (_plant)
+        {
+        	_plant->getDistance(&_fDistLeft, &_fDistRight);
+        }
         else
         {
-	        _odo->getDistance(&_fDistLeft, &_fDistRight);
+        	// The counts and the time of the last edge behind them come from the same instant
+        	OdometrySnapshot odometry = _odo->getSnapshot();
+
+	        _odo->getDistance(odometry, &_fDistLeft, &_fDistRight);
 	    }
 
         _fDistTotal = (_fDistLeft + _fDistRight) / 2.0;
 
     	_logger->notice("goToPosition: distL[%.2f] distR[%.2f] dist[%.2f] distPrev[%.2f]", _fDistLeft, _fDistRight, _fDistTotal, _fDistTotalPrev);
 
-        // How far have we travelled in this last iteration?
-        double fDistDelta      = _fDistTotal - _fDistTotalPrev;
-        double fDistLeftDelta  = _fDistLeft  - _fDistLeftPrev;
-        double fDistRightDelta = _fDistRight - _fDistRightPrev;
-
-    	// Position has changed based on the distance travelled at the previous heading
-        _currentPose.x += fDistDelta * cos(_currentPose.heading);
-    	_currentPose.y += fDistDelta * sin(_currentPose.heading);
+        if (_bSimulation)
+        {
+	        // How far has each wheel travelled in this last iteration? The pose moves along the arc that makes.
+	        pose_integrate(&_currentPose, _fDistLeft - _fDistLeftPrev, _fDistRight - _fDistRightPrev, _profile.wheelbase, POSE_INTEGRATION_ARC);
+	    }
+	    else
+	    {
+	    	// The odometry thread has integrated every transition since the last iteration
+	    	Pose estimate = _poseEstimator->getCurrentPose();
 
-    	// Update the heading as it has changed based on the distance travelled too
-    	_currentPose.heading += ((fDistRightDelta - fDistLeftDelta) / CONTROLLER_WHEELBASE);
+	    	_currentPose.x       = estimate.x;
+	    	_currentPose.y       = estimate.y;
+	    	_currentPose.heading = estimate.heading;
+	    }
 
-        // Ensure our heading remains sane
-    	_currentPose.heading = atan2(sin(_currentPose.heading), cos(_currentPose.heading));
+    	// Readers on other threads (ie. Sonar) see the whole pose from this iteration
+    	publishPose(_currentPose);
 
     	_fDistTotalPrev  = _fDistTotal;
     	_fDistLeftPrev   = _fDistLeft;
@@ -215,7 +342,7 @@ void Controller::goToPosition(double x, double y, double fPosXStated, double fPo
 		_fHeadingError = atan2(sin(fHeadingErrorRaw), cos(fHeadingErrorRaw));
 
 		// How fast should we proceed forward? (Anything below 5 results in non-movement due to inertia)
-		double fForwardVelocity = 9.0;              // 5.0 works as well but undershoots
+		double fForwardVelocity = _gains.cruiseVelocity;
 
        	// What is the magnitude of the vector between us and our target?
        	fTargetVectorMagnitude = sqrt(((_fPosXRef - _currentPose.x)*(_fPosXRef - _currentPose.x)) + ((_fPosYRef - _currentPose.y)*(_fPosYRef - _currentPose.y)));
@@ -247,6 +374,7 @@ void Controller::goToPosition(double x, double y, double fPosXStated, double fPo
 //    	        if (nConsecutiveIncreasingDistance > MAX_ITERATIONS_OF_INCREASING_TARGET_VECTOR_BEFORE_TERMINATION)
     	        {
 		    	    _logger->notice("goToPosition: Distance to target has increased!\ngoToPosition: --- END ABNORMAL ---\n");
+		    	    ret = -ERANGE;
     	            break;
     	        }
     	    }
@@ -256,26 +384,39 @@ void Controller::goToPosition(double x, double y, double fPosXStated, double fPo
     	    }
     	}
 
-    	if (fTargetVectorMagnitude < 10 || bApproachingTarget)
+    	if ( ! bBlend && (fTargetVectorMagnitude < CONTROLLER_APPROACH_RADIUS || bApproachingTarget))
     	{
     		bApproachingTarget = true;
 
-    		ledProximity.on();
+    		if (_ledProximity)
+    		{
+    			_ledProximity->on();
+    		}
     	    _logger->notice("goToPosition: Approaching target, slowing down.");
-    	    fForwardVelocity = 3.0;                 // 3.0 works as well, safer
+    	    fForwardVelocity = _gains.approachVelocity;
     	}
 
 //      _logger->notice("goToPosition: x(%.2f)\ty(%.2f)\ttheta(%.2f)", _fPosXCurrent, _fPosYCurrent, _fHeadingCurrent);
 
-    	if (fTargetVectorMagnitude <= 5)
+    	if (fTargetVectorMagnitude <= fArrivalRadius)
     	{
-    	    _logger->notice("goToPosition: You have arrived at your destination!\ngoToPosition: --- END ---\n");
-            _dotLogPosition->log((_totalTime / 1000.0), _currentPose.x, _currentPose.y, DotLog::DotLogPositionColour::RED, true);
+    	    _logger->notice("goToPosition: %s\ngoToPosition: --- END ---\n", bBlend ? "Within blend radius, handing over." : "You have arrived at your destination!");
+    	    if (_dotLogPosition)
+    	    {
+	            _dotLogPosition->log((_totalTimeNs / 1000000000.0), _currentPose.x, _currentPose.y, DotLog::DotLogPositionColour::RED, true);
+	        }
     	    break;
     	}
-    	else
+    	else if (_dotLogPosition)
+    	{
+            _dotLogPosition->log((_totalTimeNs / 1000000000.0), _currentPose.x, _currentPose.y, bApproachingTarget ? DotLog::DotLogPositionColour::RED : DotLog::DotLogPositionColour::BLACK);
+    	}
+
+    	if (totalNs > CONTROLLER_LEG_TIMEOUT_NS)
     	{
-            _dotLogPosition->log((_totalTime / 1000.0), _currentPose.x, _currentPose.y, bApproachingTarget ? DotLog::DotLogPositionColour::RED : DotLog::DotLogPositionColour::BLACK);
+    	    _logger->notice("goToPosition: Waypoint not reached in %llu s, giving up!\ngoToPosition: --- END ABNORMAL ---\n", CONTROLLER_LEG_TIMEOUT_NS / 1000000000ULL);
+    	    ret = -ETIMEDOUT;
+    	    break;
     	}
 
 		fTargetVectorMagnitudeLast = fTargetVectorMagnitude;
@@ -286,23 +427,37 @@ void Controller::goToPosition(double x, double y, double fPosXStated, double fPo
 //    		break;
 //    	}
 
-    	// Maintain the PID variables
-    	double fHeadingErrorDerivative = (_fHeadingError - _fHeadingErrorPrev) / dt;
-    	_fHeadingErrorIntegral        += (_fHeadingError * dt);
-    	_fHeadingErrorPrev             = _fHeadingError;
+    	double u;
+
+    	if (_tracking == CONTROLLER_TRACKING_PURSUIT)
+    	{
+    		// Steer for a point further along the path, as fast as the profile allows here
+    		u = pursue(from, to, next, fBlendRadius, fTargetVectorMagnitude, dt, &fForwardVelocity);
 
-    	double pidP = CONTROLLER_PID_PROPORTIONAL * _fHeadingError;
-    	double pidI = CONTROLLER_PID_INTEGRAL     * _fHeadingErrorIntegral;
-    	double pidD = CONTROLLER_PID_DERIVATIVE   * fHeadingErrorDerivative;
+    		_logger->notice("goToPosition: pursuit velocity[%.2f] u[%.6f]", fForwardVelocity, u);
+    	}
+    	else
+    	{
+	    	// Maintain the PID variables
+	    	double fHeadingErrorDerivative = dt > 0.0 ? (_fHeadingError - _fHeadingErrorPrev) / dt : 0.0;
+	    	_fHeadingErrorIntegral        += (_fHeadingError * dt);
+	    	_fHeadingErrorPrev             = _fHeadingError;
 
-    	// PID, this gives us the control signal, u, this is required angular velocity
-    	double u = pidP + pidI + pidD;
+	    	double pidP = _gains.proportional * _fHeadingError;
+	    	double pidI = _gains.integral     * _fHeadingErrorIntegral;
+	    	double pidD = _gains.derivative   * fHeadingErrorDerivative;
+
+	    	// PID, this gives us the control signal, u, this is required angular velocity
+	    	u = pidP + pidI + pidD;
+
+	    	_logger->notice("goToPosition: P[%.6f] I[%.6f] D[%.6f] u[%.6f]", pidP, pidI, pidD, u);
+	    }
 
     	// Angular velocity gives us new wheel velocities. We assume a constant forward velocity for simplicity.
-    	fVelocityRight = ((2.0*fForwardVelocity) + (u*CONTROLLER_WHEELBASE)) / (2.0*CONTROLLER_WHEELRADIUS);   // cm/s
-		fVelocityLeft  = ((2.0*fForwardVelocity) - (u*CONTROLLER_WHEELBASE)) / (2.0*CONTROLLER_WHEELRADIUS);   // cm/s
+    	fVelocityRight = ((2.0*fForwardVelocity) + (u*_profile.wheelbase)) / (2.0*_profile.wheelRadius);   // cm/s
+		fVelocityLeft  = ((2.0*fForwardVelocity) - (u*_profile.wheelbase)) / (2.0*_profile.wheelRadius);   // cm/s
 
-		_logger->notice("goToPosition: P[%.6f] I[%.6f] D[%.6f] u[%.6f] -> required velocities (left,right) are (%.2f,%.2f)", pidP, pidI, pidD, u, fVelocityLeft, fVelocityRight);
+		_logger->notice("goToPosition: required velocities (left,right) are (%.2f,%.2f)", fVelocityLeft, fVelocityRight);
 
 		// These velocities are relative, work out the required velocity per wheel.
 //		float vLeft  = (fVelocityLeft  / (fabs(fVelocityLeft) + fabs(fVelocityRight))) * 100.0;
@@ -317,7 +472,12 @@ void Controller::goToPosition(double x, double y, double fPosXStated, double fPo
 		int nRightPWM = convertVelocityToPWMPercentage(false, fVelocityRight);
 
 		// Apply the new velocities to the motors
-		if ( ! _bSimulation)
+		if (_plant)
+		{
+			_plant->drive(MOTOR_LEFT,  fVelocityLeft  >= 0.0, nLeftPWM);
+			_plant->drive(MOTOR_RIGHT, fVelocityRight >= 0.0, nRightPWM);
+		}
+		else if ( ! _bSimulation)
 		{
 			if (fVelocityLeft < 0.0)
 			{
@@ -338,9 +498,10 @@ void Controller::goToPosition(double x, double y, double fPosXStated, double fPo
 			}
 		}
 
-		usleep(50000);      // 50ms
-//		usleep(300000);     // 300 ms
-//		usleep(1000000);    // 1s
+		_bMoving = true;
+
+		// Sleep until the next deadline, however long this iteration took (a plant's time passes without sleeping)
+		dtNs = _plant ? _plant->advance(_loop.getPeriodNs()) : _loop.wait();
 
     	/**
     	 * time passes ... wheels respond to new control signal and begin moving at new velocities
@@ -353,16 +514,139 @@ void Controller::goToPosition(double x, double y, double fPosXStated, double fPo
     	iteration++;
     }
 
+    return ret;
+}
+
+/**
+ * Controller::stop - stop the wheels at the end of a leg (or mission)
+ *
+ * @return void
+ */
+void Controller::stop()
+{
+    _bMoving   = false;
+    _fVelocity = 0.0;
+
+    if (_plant)
+    {
+    	_plant->stop();
+    	return;
+    }
+
     bot_stop();
 
-    ledHealth.off();
+    _ledHealth->off();
+
+    ActuatorStats stats;
+    actuator_get_stats(&stats);
+
+    _logger->notice("stop: actuator writes submitted[%lu] written[%lu] elided[%lu] superseded[%lu] failed[%lu]", stats.submitted, stats.written, stats.elided, stats.superseded, stats.failed);
+
+    // Wakeup latencies so far (see rtprofile.h)
+    _loop.log(_logger, "stop: control loop");
+    _odo->getWakeupLatency().log(_logger, "stop: odometry wakeup latency");
+    actuator_get_wakeup_latency().log(_logger, "stop: actuator wakeup latency");
+}
+
+/**
+ * Controller::pursue - pure pursuit steering and a trapezoidal speed profile, for one iteration
+ *
+ * The robot steers along the arc through the point CONTROLLER_LOOKAHEAD further along the leg than it is (carrying on
+ * along the next leg if that is past the waypoint). Its forward velocity ramps up by CONTROLLER_MAX_ACCELERATION per
+ * second to CONTROLLER_MAX_VELOCITY, and is held down to what the arc's curvature allows and to what it can still
+ * brake from in time: to a stop at the last waypoint, or to the speed the turn onto the next leg allows.
+ *
+ * @param Waypoint & from				where the leg started
+ * @param Waypoint & to					the waypoint
+ * @param Waypoint * next				the waypoint after it, NULL if the robot stops at this one
+ * @param double	 fBlendRadius		the leg ends this close to the waypoint when there is a next one
+ * @param double	 fDistance			from the robot to the waypoint
+ * @param double	 dt					since the last iteration
+ * @param double *	 fForwardVelocity	set to the forward velocity to drive at
+ *
+ * @return double	u, the required angular velocity
+ */
+double Controller::pursue(const Waypoint &from, const Waypoint &to, const Waypoint *next, double fBlendRadius, double fDistance, double dt, double *fForwardVelocity)
+{
+	double fLength = hypot(to.x - from.x, to.y - from.y);
+	double tx      = fLength > 0.0 ? (to.x - from.x) / fLength : cos(_currentPose.heading);
+	double ty      = fLength > 0.0 ? (to.y - from.y) / fLength : sin(_currentPose.heading);
+
+	// Where along the leg are we, and where is the point we steer for?
+	double fAlong     = (_currentPose.x - from.x) * tx + (_currentPose.y - from.y) * ty;
+	double fLookahead = (fAlong > 0.0 ? fAlong : 0.0) + CONTROLLER_LOOKAHEAD;
+	double fNextLength = next ? hypot(next->x - to.x, next->y - to.y) : 0.0;
+	double lx = to.x, ly = to.y;
+
+	if (fLookahead < fLength)
+	{
+		lx = from.x + tx * fLookahead;
+		ly = from.y + ty * fLookahead;
+	}
+	else if (fNextLength > 0.0)
+	{
+		double fBeyond = fLookahead - fLength < fNextLength ? fLookahead - fLength : fNextLength;
+
+		lx = to.x + (next->x - to.x) * fBeyond / fNextLength;
+		ly = to.y + (next->y - to.y) * fBeyond / fNextLength;
+	}
+
+	// The arc through that point: its offset to the side of the robot over the square of its distance away
+	double ex         = lx - _currentPose.x;
+	double ey         = ly - _currentPose.y;
+	double fChord2    = ex*ex + ey*ey;
+	double fLateral   = -sin(_currentPose.heading) * ex + cos(_currentPose.heading) * ey;
+	double fCurvature = fChord2 > 1e-6 ? (2.0 * fLateral) / fChord2 : 0.0;
+
+	// How fast can we be going at the end of the leg? The turn onto the next leg is taken on an arc that starts and
+	// ends fBlendRadius from the waypoint, so the tighter the turn the tighter the arc.
+	double fExitVelocity = 0.0;
+	double fBrakeDistance = fDistance - CONTROLLER_ARRIVAL_RADIUS;
+
+	if (fNextLength > 0.0)
+	{
+		double fTurn = fabs(atan2(tx * (next->y - to.y) - ty * (next->x - to.x), tx * (next->x - to.x) + ty * (next->y - to.y)));
+
+		fExitVelocity  = fTurn < 1e-3 ? CONTROLLER_MAX_VELOCITY : sqrt(CONTROLLER_MAX_LATERAL * fBlendRadius / tan(fTurn / 2.0));
+		fBrakeDistance = fDistance - fBlendRadius;
+	}
+
+	fBrakeDistance = fBrakeDistance > 0.0 ? fBrakeDistance : 0.0;
+
+	double fVelocity = CONTROLLER_MAX_VELOCITY;
+	double fLimit;
+
+	// Accelerate no faster than the wheels can keep up with
+	fLimit    = _fVelocity + (CONTROLLER_MAX_ACCELERATION * dt);
+	fVelocity = fLimit < fVelocity ? fLimit : fVelocity;
+
+	// Slow enough to brake in time
+	fLimit    = sqrt((fExitVelocity * fExitVelocity) + (2.0 * CONTROLLER_MAX_ACCELERATION * fBrakeDistance));
+	fVelocity = fLimit < fVelocity ? fLimit : fVelocity;
+
+	// Slow enough for the arc, and for the outer wheel to stay under CONTROLLER_MAX_VELOCITY on it
+	if (fabs(fCurvature) > 1e-6)
+	{
+		fLimit    = sqrt(CONTROLLER_MAX_LATERAL / fabs(fCurvature));
+		fVelocity = fLimit < fVelocity ? fLimit : fVelocity;
+	}
+
+	fLimit    = (2.0 * _profile.wheelRadius * CONTROLLER_MAX_VELOCITY) / (2.0 + fabs(fCurvature) * _profile.wheelbase);
+	fVelocity = fLimit < fVelocity ? fLimit : fVelocity;
+
+	// Any slower and the wheels don't turn at all
+	fVelocity = fVelocity > _gains.approachVelocity ? fVelocity : _gains.approachVelocity;
+
+	_fVelocity        = fVelocity;
+	*fForwardVelocity = fVelocity;
+
+	return fVelocity * fCurvature;
 }
 
 /**
  * Controller::convertVelocityToPWMPercentage
  *
- * Based on on-the-floor testing which using the odometer, resulted in a curve that plots PWM duty cycle
- * against velocity, determine the DC required to turn the specified motor at the desired velocity.
+ * @see controller_duty()
  *
  * @param bool  	leftMotor
  * @param double 	fVelocity
@@ -371,40 +655,113 @@ void Controller::goToPosition(double x, double y, double fPosXStated, double fPo
  */
 int Controller::convertVelocityToPWMPercentage(bool leftMotor, double fVelocity)
 {
-	float fPercentage, fWorkingVelocity;
-	int   nPercentage;
+	if (fabs(fVelocity) > CONTROLLER_MAX_VELOCITY)
+	{
+		_logger->notice("convertVelocityToPWMPercentage: requested velocity (%.2f) is above maximum (%.2f), capping at max", fVelocity, CONTROLLER_MAX_VELOCITY);
+	}
+
+	float fPercentage = controller_duty(_motorCal, leftMotor, fVelocity);
+	int   nPercentage = static_cast<int>(round(fPercentage));
+
+	LOGGER_DEBUG(_logger, "convertVelocityToPWMPercentage: velocity %.2f converts to PWM DC %d (%.2f)", fVelocity, nPercentage, fPercentage);
+
+	return nPercentage;
+}
+
+/**
+ * Controller::getHeading
+ *
+ * @see controller_heading()
+ *
+ * @param double toX				destination global x co-ordinate
+ * @param double toY				destination global y co-ordinate
+ * @param double fromX				current global x co-ordinate
+ * @param double fromY				current global y co-ordinate
+ * @param double fCurrentHeading	current heading
+ *
+ * @return double
+ */
+double Controller::getHeading(double toX, double toY, double fromX, double fromY, double fCurrentHeading)
+{
+	_logger->notice("getHeading: to global   (%.2f,%.2f) from global: (%.2f,%.2f) currentHeading: %.2f rad", toX, toY, fromX, fromY, fCurrentHeading);
+	_logger->notice("getHeading: to relative (%.2f,%.2f)", toX - fromX, toY - fromY);
+
+	return controller_heading(toX, toY, fromX, fromY, fCurrentHeading);
+}
+
+/**
+ * Get the current pose of the robot, safe to call from any thread.
+ *
+ * Unless simulating, this is the pose as of the last batch of encoder edges, straight from the odometry thread
+ * (timestamp: ms since the controller was created). When simulating it is the pose published by the last iteration.
+ *
+ * @return Pose
+ */
+Pose Controller::getCurrentPose()
+{
+	if ( ! _bSimulation)
+	{
+		return _poseEstimator->getCurrentPose();
+	}
+
+	return PoseProvider::getCurrentPose();
+}
+
+/**
+ * Controller::setLoopRate - rate of the fixed-rate control loop, takes effect from the next iteration
+ *
+ * @param unsigned int rateHz	1 - LOOPTIMER_RATE_MAX
+ *
+ * @return int	0 on success, -EINVAL if the rate is out of range
+ */
+int Controller::setLoopRate(unsigned int rateHz)
+{
+	return _loop.setRate(rateHz);
+}
+
+/**
+ * Based on on-the-floor testing which using the odometer, resulted in a curve that plots PWM duty cycle
+ * against velocity, determine the DC required to turn the specified motor at the desired velocity.
+ *
+ * If the robot has been calibrated (see demo_gotogoal/calibrate) its measured curves are used instead.
+ *
+ * @param MotorCalibration * motorCal
+ * @param bool  			 leftMotor
+ * @param double 			 fVelocity	capped at CONTROLLER_MAX_VELOCITY either way
+ *
+ * @return float	the duty cycle in percent, before rounding
+ */
+float controller_duty(const MotorCalibration *motorCal, bool leftMotor, double fVelocity)
+{
+	float fWorkingVelocity;
 
 	/**
 	 * The requested velocity could be negative, which means we turn the motor backwards. This is fine, but our curves
-	 * are for forward velocities only. We return an absolute PWM speed, the caller turns it into a positive or neg.
+	 * are for forward velocities only (a calibration has one for each direction). We return an absolute PWM speed, the
+	 * caller turns it into a positive or neg.
 	 */
 	fWorkingVelocity = fabs(fVelocity);
 
 	if (fWorkingVelocity > CONTROLLER_MAX_VELOCITY)
 	{
-		_logger->notice("convertVelocityToPWMPercentage: requested velocity (%.2f) is above maximum (%.2f), capping at max", fVelocity, CONTROLLER_MAX_VELOCITY);
 		fWorkingVelocity = CONTROLLER_MAX_VELOCITY;
 	}
 
-	if (leftMotor)
+	if (motorCal->isLoaded())
 	{
-		fPercentage = 10.0 * (fWorkingVelocity + 0.2833) / 1.103;
+		return motorCal->getDuty(leftMotor ? MOTOR_LEFT : MOTOR_RIGHT, fVelocity >= 0, fWorkingVelocity);
+	}
+	else if (leftMotor)
+	{
+		return 10.0 * (fWorkingVelocity + 0.2833) / 1.103;
 	}
 	else
 	{
-		fPercentage = 10.0 * (fWorkingVelocity + 0.2395) / 1.0263;
+		return 10.0 * (fWorkingVelocity + 0.2395) / 1.0263;
 	}
-
-	nPercentage = static_cast<int>(round(fPercentage));
-
-//	_logger->debug("convertVelocityToPWMPercentage: velocity %.2f converts to PWM DC %d (%.2f)", fVelocity, nPercentage, fPercentage);
-
-	return nPercentage;
 }
 
 /**
- * Controller::getHeading
- *
  * Translates current pose to (0,0, 0 rad) and works out the heading required to get to global co-ordinate (x,y)
  * from a given current global co-ordinate.
  *
@@ -412,20 +769,17 @@ int Controller::convertVelocityToPWMPercentage(bool leftMotor, double fVelocity)
  * @param double toY				destination global y co-ordinate
  * @param double fromX				current global x co-ordinate
  * @param double fromY				current global y co-ordinate
- * @param double fCurrentHeading	current heading
+ * @param double fCurrentHeading	current heading, kept if the destination is where we are
  *
  * @return double
  */
-double Controller::getHeading(double toX, double toY, double fromX, double fromY, double fCurrentHeading)
+double controller_heading(double toX, double toY, double fromX, double fromY, double fCurrentHeading)
 {
 	double fRad = fCurrentHeading;
 
 	double x = toX - fromX;
 	double y = toY - fromY;
 
-	_logger->notice("getHeading: to global   (%.2f,%.2f) from global: (%.2f,%.2f) currentHeading: %.2f rad", toX, toY, fromX, fromY, fCurrentHeading);
-	_logger->notice("getHeading: to relative (%.2f,%.2f)", x, y);
-
 	if (x <= 0.01 && x >= -0.01)
 	{
 		if (y < 0.0)
@@ -436,10 +790,6 @@ double Controller::getHeading(double toX, double toY, double fromX, double fromY
 		{
 			fRad = M_PI/2.0;
 		}
-		else
-		{
-			_logger->notice("getHeading: leaving at current heading");
-		}
 	}
 	else
 	{
@@ -462,15 +812,3 @@ double Controller::getHeading(double toX, double toY, double fromX, double fromY
 
 	return fRad;
 }
-
-/**
- * Get the current pose of the robot.
- *
- * @todo: critical section around these
- *
- * @return Pose
- */
-Pose Controller::getCurrentPose()
-{
-	return _currentPose;
-}
@@ -6,38 +6,65 @@
  * PID controller implementation.
  *
  * Some other stuff is currently embedded into this as well (SONAR sounding etc) which should be separated out.
+ *
+ * The robot's wheels, encoders and default gains come from its profile (see robotprofile.h).
  */
 
 #ifndef _CONTROLLER_H_INCLUDED
 #define _CONTROLLER_H_INCLUDED
 
-#include "../libs/poseprovider.h"
+#include <stddef.h>
 
-#define CONTROLLER_PID_PROPORTIONAL 0.90        // contributes to stability and medium-rate responsiveness
-#define CONTROLLER_PID_INTEGRAL 0.0005          // tracking and disturbance rejection (slow-rate responsiveness, may cause oscillations)
-#define CONTROLLER_PID_DERIVATIVE 0.00          // fast-rate responsiveness, can cause overshoot: note 0.1 is safer
+#include "../libs/poseprovider.h"
+#include "../libs/looptimer.h"
+#include "../libs/robotprofile.h"
+#include "gains.h"
 
 #define CONTROLLER_MAX_VELOCITY 10.0
 
-#define CONTROLLER_WHEELBASE   9				// in centimeters
-#define CONTROLLER_WHEELRADIUS 2                // in centimeters, ensure this matches
+#define CONTROLLER_MAX_ACCELERATION 10.0				// pure pursuit: forward velocity gained per second
+#define CONTROLLER_MAX_LATERAL      12.0				// pure pursuit: highest velocity^2 * curvature on an arc
+#define CONTROLLER_LOOKAHEAD        8.0					// pure pursuit: cm along the path to steer for
+
+#define CONTROLLER_LOOP_RATE        20					// Hz, the control loop's default fixed rate
+#define CONTROLLER_LOOP_RATE_ENV    "OROBOTO_CONTROL_HZ"	// overrides CONTROLLER_LOOP_RATE if set
+
+#define CONTROLLER_TRACKING_ENV     "OROBOTO_TRACKING"		// "pursuit" for CONTROLLER_TRACKING_PURSUIT
+
+#define CONTROLLER_LEG_TIMEOUT_NS   (120 * 1000000000ULL)	// give up on a waypoint after this long
 
-#define LEFT_WHEEL_ENCODER_GPIO_A	30
-#define LEFT_WHEEL_ENCODER_GPIO_B	31
-#define RIGHT_WHEEL_ENCODER_GPIO_A	66
-#define RIGHT_WHEEL_ENCODER_GPIO_B	67
+#define CONTROLLER_APPROACH_RADIUS  10.0			// cm, slow to the approach velocity inside this when stopping at a waypoint
+#define CONTROLLER_ARRIVAL_RADIUS   5.0				// cm, a waypoint being stopped at is reached inside this
 
 #define MAX_ITERATIONS_OF_INCREASING_TARGET_VECTOR_BEFORE_TERMINATION 8
 
 class Odometer;
+class Plant;
+class Led;
+class PoseEstimator;
+class MotorCalibration;
 class Logger;
 class DotLog;
 
 struct Pose;
 
+struct Waypoint
+{
+	double	x;
+	double	y;
+};
+
+enum ControllerTracking
+{
+	CONTROLLER_TRACKING_HEADING,				// PID on the heading to the waypoint at the cruise velocity (the default)
+	CONTROLLER_TRACKING_PURSUIT					// pure pursuit along the path with a trapezoidal speed profile
+};
+
 class Controller : public PoseProvider
 {
 	private:
+		RobotProfile _profile;					// geometry, encoders and default gains of the robot being driven
+
 		Pose	_currentPose;					// (believed) current x, y and heading
 
 		double  _fHeadingRef;					// reference heading required to go from (believed) current pose to desired waypoint
@@ -52,31 +79,62 @@ class Controller : public PoseProvider
 		double  _fDistTotal;					// total distance travelled in this waypoint segment
 		double  _fDistTotalPrev;				// previous total distance travelled in this waypoint segment
 
+		ControllerGains _gains;					// PID gains and forward velocities, see gains.h
+
+		ControllerTracking _tracking;			// how the robot is steered along each leg
+		double  _fVelocity;						// forward velocity of the last iteration (pure pursuit)
+
 		double  _fPosXRef;						// x position of next desired waypoint
 		double  _fPosYRef;						// y position of next desired waypoint
 
-		unsigned long _totalTime;				// total time elapsed while transiting between waypoints (runtime)
+		unsigned long long _totalTimeNs;		// total time elapsed while transiting between waypoints (runtime)
 
 		bool	_bSimulation;					// should we simulate movement (for testing model) or actually turn the wheels?
+		bool	_bMoving;						// the wheels were left turning at the end of the last leg (see transit())
+
+		LoopTimer _loop;						// paces the control loop at a fixed rate, keeps its period and jitter
 
 		void     reset();
 		void     resetDistance();
 
 		Odometer * _odo;
+		Plant    * _plant;						// if set, drive this (ie. a simulation) instead of the motors and encoders
+		PoseEstimator * _poseEstimator;			// integrated by the odometry thread on every encoder transition
+		MotorCalibration * _motorCal;			// per-robot velocity to PWM table, see motorcal.h
 		Logger   * _logger;
 
 		DotLog   * _dotLogPosition;
 
+		Led      * _ledHealth;
+		Led      * _ledProximity;
+
 		int      convertVelocityToPWMPercentage(bool leftMotor, double fVelocity);
+		double   pursue(const Waypoint &from, const Waypoint &to, const Waypoint *next, double fBlendRadius, double fDistance, double dt, double *fForwardVelocity);
 
 	public:
-		Controller();
+		Controller(Plant *plant = NULL, const RobotProfile &profile = ROBOT_PROFILE_OROBOTO);
 		~Controller();
 
 		void        	goToPosition(double x, double y, double fPosXStated, double fPosYStated);
+		int				transit(double x, double y, double fBlendRadius = 0.0, const Waypoint *next = NULL);
+		void			stop();
 		double      	getHeading(double toX, double toY, double fromX, double fromY, double fCurrentHeading);
 
 		Pose			getCurrentPose();
+
+		int				setLoopRate(unsigned int rateHz);
+
+		unsigned long long getTransitTimeNs() const				{ return _totalTimeNs; }
+
+		void			setTracking(ControllerTracking tracking)	{ _tracking = tracking; }
+		ControllerTracking getTracking() const					{ return _tracking; }
+
+		void			setGains(const ControllerGains &gains)	{ _gains = gains; }
+		const ControllerGains & getGains() const				{ return _gains; }
 };
 
+// The controller's math, also used by BatchSimulator (see batchsim.h) so that the two fly the same robots the same way
+double	controller_heading(double toX, double toY, double fromX, double fromY, double fCurrentHeading);
+float	controller_duty(const MotorCalibration *motorCal, bool leftMotor, double fVelocity);
+
 #endif // _CONTROLLER_H_INCLUDED
@@ -0,0 +1,153 @@
+/**
+ * gains.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "gains.h"
+#include "controller.h"
+#include "../libs/logger.h"
+
+/**
+ * ctor, the hand-tuned defaults
+ *
+ * @param RobotProfile & profile
+ */
+ControllerGains::ControllerGains(const RobotProfile &profile)
+{
+	proportional     = profile.proportional;
+	integral         = profile.integral;
+	derivative       = profile.derivative;
+
+	cruiseVelocity   = profile.cruiseVelocity;
+	approachVelocity = profile.approachVelocity;
+}
+
+/**
+ * ControllerGains::getDefaultFile
+ *
+ * @return const char *	$OROBOTO_GAINS if it is set, otherwise GAINS_DEFAULT_FILE
+ */
+const char * ControllerGains::getDefaultFile()
+{
+	const char *filename = getenv(GAINS_FILE_ENV);
+
+	return (filename && *filename) ? filename : GAINS_DEFAULT_FILE;
+}
+
+/**
+ * ControllerGains::save
+ *
+ * @param char * filename	NULL for getDefaultFile()
+ *
+ * @return int	0 or -errno
+ */
+int ControllerGains::save(const char *filename) const
+{
+	FILE *fp;
+
+	if (filename == NULL)
+	{
+		filename = getDefaultFile();
+	}
+
+	if ((fp = fopen(filename, "w")) == NULL)
+	{
+		Logger::getInstance()->error("ControllerGains::save: could not open %s: %s", filename, strerror(errno));
+		return -errno;
+	}
+
+	fprintf(fp, "# oroboto controller gains: <name> <value>\n");
+	fprintf(fp, "proportional %.6f\n", proportional);
+	fprintf(fp, "integral %.6f\n", integral);
+	fprintf(fp, "derivative %.6f\n", derivative);
+	fprintf(fp, "cruise %.3f\n", cruiseVelocity);
+	fprintf(fp, "approach %.3f\n", approachVelocity);
+
+	if (fclose(fp) != 0)
+	{
+		return -errno;
+	}
+
+	return 0;
+}
+
+/**
+ * ControllerGains::load - nothing is changed unless the whole file can be read
+ *
+ * @param char * filename	NULL for getDefaultFile()
+ *
+ * @return int	0 or -errno (-EINVAL if the file has a line that isn't a known gain)
+ */
+int ControllerGains::load(const char *filename)
+{
+	ControllerGains gains = *this;
+	char            line[128], name[32];
+	double          value;
+	int             ret = 0;
+	FILE *          fp;
+
+	if (filename == NULL)
+	{
+		filename = getDefaultFile();
+	}
+
+	if ((fp = fopen(filename, "r")) == NULL)
+	{
+		return -errno;
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		if (line[0] == '#' || line[0] == '\n')
+		{
+			continue;
+		}
+
+		if (sscanf(line, "%31s %lf", name, &value) != 2)
+		{
+			ret = -EINVAL;
+			break;
+		}
+
+		if (strcmp(name, "proportional") == 0)
+		{
+			gains.proportional = value;
+		}
+		else if (strcmp(name, "integral") == 0)
+		{
+			gains.integral = value;
+		}
+		else if (strcmp(name, "derivative") == 0)
+		{
+			gains.derivative = value;
+		}
+		else if (strcmp(name, "cruise") == 0)
+		{
+			gains.cruiseVelocity = value;
+		}
+		else if (strcmp(name, "approach") == 0)
+		{
+			gains.approachVelocity = value;
+		}
+		else
+		{
+			ret = -EINVAL;
+			break;
+		}
+	}
+
+	fclose(fp);
+
+	if (ret == 0)
+	{
+		*this = gains;
+	}
+
+	return ret;
+}
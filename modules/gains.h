@@ -0,0 +1,38 @@
+/**
+ * gains.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * The controller's tunable gains: the heading PID gains and the forward velocities it drives at.
+ *
+ * They default to the hand-tuned values in the robot's profile (see robotprofile.h). save() and load() keep them in a small text file
+ * (one "<name> <value>" line per gain, any not in the file keep their default), which demo_gotogoal/tune writes from
+ * simulated missions.
+ */
+
+#ifndef _GAINS_H_INCLUDED
+#define _GAINS_H_INCLUDED
+
+#include "../libs/robotprofile.h"
+
+#define GAINS_FILE_ENV      "OROBOTO_GAINS"     // environment variable naming the gains file
+#define GAINS_DEFAULT_FILE  "gains.txt"         // used when it isn't set
+
+struct ControllerGains
+{
+	double	proportional;
+	double	integral;
+	double	derivative;
+
+	double	cruiseVelocity;			// forward velocity between waypoints
+	double	approachVelocity;		// forward velocity once close to the waypoint
+
+	ControllerGains(const RobotProfile &profile = ROBOT_PROFILE_OROBOTO);
+
+	int		load(const char *filename = NULL);
+	int		save(const char *filename = NULL) const;
+
+	static const char * getDefaultFile();
+};
+
+#endif // _GAINS_H_INCLUDED
@@ -0,0 +1,352 @@
+/**
+ * mission.cpp
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include "mission.h"
+#include "controller.h"
+#include "../libs/logger.h"
+
+/**
+ * ctor
+ *
+ * @param Controller * controller
+ */
+Mission::Mission(Controller *controller)
+{
+	_controller   = controller;
+	_logger       = new Logger("Mission");
+	_fBlendRadius = MISSION_BLEND_RADIUS;
+	_transitNs    = 0;
+
+	const char *radius = getenv(MISSION_BLEND_RADIUS_ENV);
+
+	if (radius && *radius && setBlendRadius(atof(radius)) < 0)
+	{
+		_logger->notice("ctor: ignoring %s=%s, blending within %.1f cm", MISSION_BLEND_RADIUS_ENV, radius, _fBlendRadius);
+	}
+}
+
+/**
+ * dtor
+ */
+Mission::~Mission()
+{
+	delete _logger;
+}
+
+/**
+ * Mission::setBlendRadius
+ *
+ * @param double fBlendRadius	cm, 0 to slow down for (but still not stop at) every waypoint
+ *
+ * @return int	0 or -EINVAL if negative
+ */
+int Mission::setBlendRadius(double fBlendRadius)
+{
+	if (fBlendRadius < 0.0)
+	{
+		return -EINVAL;
+	}
+
+	_fBlendRadius = fBlendRadius;
+
+	return 0;
+}
+
+/**
+ * Mission::run - drive through an array of waypoints
+ *
+ * @param Waypoint *   waypoints
+ * @param unsigned int nWaypoints
+ *
+ * @return int	the number of waypoints reached
+ */
+int Mission::run(const Waypoint *waypoints, unsigned int nWaypoints)
+{
+	begin();
+
+	for (unsigned int i = 0; i < nWaypoints; i++)
+	{
+		leg(waypoints[i], i < nWaypoints - 1 ? &waypoints[i + 1] : NULL);
+	}
+
+	return end();
+}
+
+/**
+ * Mission::run - drive through the waypoints in a file, or stdin
+ *
+ * @param char * filename	"-" for stdin
+ *
+ * @return int	the number of waypoints reached or -errno if the file couldn't be opened or had a bad line in it
+ */
+int Mission::run(const char *filename)
+{
+	FILE *fp;
+	int   ret;
+
+	if (strcmp(filename, "-") == 0)
+	{
+		return run(stdin);
+	}
+
+	if ((fp = fopen(filename, "r")) == NULL)
+	{
+		_logger->error("run: could not open %s: %s", filename, strerror(errno));
+		return -errno;
+	}
+
+	ret = run(fp);
+
+	fclose(fp);
+
+	return ret;
+}
+
+/**
+ * Mission::run - drive through the waypoints read from a stream, as they arrive
+ *
+ * @param FILE * fp
+ *
+ * @return int	the number of waypoints reached, -EINVAL if the stream had a bad line in it or -errno if it couldn't be
+ *				read (the robot is stopped there)
+ */
+int Mission::run(FILE *fp)
+{
+	MissionStream stream;
+	Waypoint      current, next;
+	int           ret;
+
+	stream.fd   = fileno(fp);
+	stream.used = 0;
+	stream.bEnd = false;
+
+	begin();
+
+	// Standing still, so wait for the first
+	if ((ret = readWaypoint(&stream, &current, true)) <= 0)
+	{
+		end();
+		return ret;
+	}
+
+	while (true)
+	{
+		// Is there another waypoint after this one yet? The robot may be moving, so don't wait for one
+		if ((ret = readWaypoint(&stream, &next, false)) < 0 && ret != -EAGAIN)
+		{
+			_logger->error("run: bad waypoint after (%.2f, %.2f), stopping", current.x, current.y);
+			end();
+			return ret;
+		}
+
+		leg(current, ret == 1 ? &next : NULL);
+
+		if (ret == 1)
+		{
+			current = next;
+			continue;
+		}
+
+		// That was the last leg for now, stop there before waiting for more
+		_controller->stop();
+
+		if (ret == 0)
+		{
+			break;
+		}
+
+		_logger->notice("run: stopped at (%.2f, %.2f), waiting for the next waypoint", current.x, current.y);
+
+		if ((ret = readWaypoint(&stream, &current, true)) < 0)
+		{
+			_logger->error("run: bad waypoint after (%.2f, %.2f), stopping", current.x, current.y);
+			end();
+			return ret;
+		}
+
+		if (ret == 0)
+		{
+			break;
+		}
+	}
+
+	return end();
+}
+
+/**
+ * Mission::readWaypoint - the next "<x> <y>" line on a stream, skipping comments and blank lines
+ *
+ * @param MissionStream * stream
+ * @param Waypoint *	  waypoint
+ * @param bool			  bWait		wait for a line to arrive, otherwise only use what has arrived already
+ *
+ * @return int	1 if one was read, 0 at the end of the stream, -EAGAIN if there isn't one yet (and not waiting), -EINVAL
+ *				for a line that isn't a waypoint or -errno if the stream couldn't be read
+ */
+int Mission::readWaypoint(MissionStream *stream, Waypoint *waypoint, bool bWait)
+{
+	char    line[MISSION_LINE_BYTES + 1];
+	char *  newline;
+	ssize_t nRead;
+	int     ret;
+
+	while (true)
+	{
+		// A whole line (or whatever is left at the end of the stream)
+		if ((newline = static_cast<char *>(memchr(stream->buffer, '\n', stream->used))) != NULL || (stream->bEnd && stream->used > 0))
+		{
+			size_t length = newline ? newline - stream->buffer : stream->used;
+			size_t taken  = newline ? length + 1 : length;
+
+			memcpy(line, stream->buffer, length);
+			line[length] = '\0';
+
+			memmove(stream->buffer, stream->buffer + taken, stream->used - taken);
+			stream->used -= taken;
+
+			if ((ret = parseWaypoint(line, waypoint)) != 0)
+			{
+				return ret;
+			}
+
+			continue;
+		}
+
+		if (stream->bEnd)
+		{
+			return 0;
+		}
+
+		if (stream->used == sizeof(stream->buffer))
+		{
+			return -EINVAL;
+		}
+
+		struct pollfd fd = { stream->fd, POLLIN, 0 };
+
+		if ((ret = poll(&fd, 1, bWait ? -1 : 0)) < 0 && errno != EINTR)
+		{
+			return -errno;
+		}
+
+		if (ret <= 0)
+		{
+			if ( ! bWait)
+			{
+				return -EAGAIN;
+			}
+
+			continue;
+		}
+
+		if ((nRead = read(stream->fd, stream->buffer + stream->used, sizeof(stream->buffer) - stream->used)) < 0)
+		{
+			if (errno == EINTR || errno == EAGAIN)
+			{
+				if ( ! bWait)
+				{
+					return -EAGAIN;
+				}
+
+				continue;
+			}
+
+			return -errno;
+		}
+
+		stream->used += nRead;
+		stream->bEnd  = (nRead == 0);
+	}
+}
+
+/**
+ * Mission::parseWaypoint
+ *
+ * @param char *	 line
+ * @param Waypoint * waypoint
+ *
+ * @return int	1 if it is a waypoint, 0 for a comment or blank line, -EINVAL for anything else
+ */
+int Mission::parseWaypoint(const char *line, Waypoint *waypoint)
+{
+	const char *p = line + strspn(line, " \t\r");
+
+	if (*p == '#' || *p == '\0')
+	{
+		return 0;
+	}
+
+	if (sscanf(p, "%lf %lf", &waypoint->x, &waypoint->y) != 2)
+	{
+		return -EINVAL;
+	}
+
+	return 1;
+}
+
+/**
+ * Mission::begin
+ *
+ * @return void
+ */
+void Mission::begin()
+{
+	_legs.clear();
+	_transitNs = 0;
+
+	_logger->notice("begin: blending within %.1f cm of each waypoint", _fBlendRadius);
+}
+
+/**
+ * Mission::leg - drive to one waypoint, stopping only if it is the last
+ *
+ * @param Waypoint & waypoint
+ * @param Waypoint * next		the waypoint after this one, NULL if this is the last
+ *
+ * @return void
+ */
+void Mission::leg(const Waypoint &waypoint, const Waypoint *next)
+{
+	MissionLeg         leg;
+	unsigned long long tStart = _controller->getTransitTimeNs();
+
+	leg.waypoint  = waypoint;
+	leg.result    = _controller->transit(waypoint.x, waypoint.y, next ? _fBlendRadius : 0.0, next);
+	leg.transitNs = _controller->getTransitTimeNs() - tStart;
+
+	_transitNs += leg.transitNs;
+	_legs.push_back(leg);
+
+	_logger->notice("leg: %zu to (%.2f, %.2f) %s in %.3f s", _legs.size(), waypoint.x, waypoint.y, leg.result == 0 ? "reached" : "abandoned", leg.transitNs / 1000000000.0);
+}
+
+/**
+ * Mission::end - stop and report
+ *
+ * @return int	the number of waypoints reached
+ */
+int Mission::end()
+{
+	int nReached = 0;
+
+	_controller->stop();
+
+	for (size_t i = 0; i < _legs.size(); i++)
+	{
+		nReached += (_legs[i].result == 0);
+	}
+
+	_logger->notice("end: %d of %zu waypoints reached, total transit %.3f s", nReached, _legs.size(), _transitNs / 1000000000.0);
+
+	return nReached;
+}
@@ -0,0 +1,85 @@
+/**
+ * mission.h
+ *
+ * @author <oroboto@oroboto.net>, www.oroboto.net, 2015
+ *
+ * Drives the controller through a list of waypoints without stopping between them.
+ *
+ * Every leg but the last hands over to the next one as soon as the robot is within the blend radius of its waypoint,
+ * without slowing down (see Controller::transit()). Only the last waypoint is approached slowly and stopped at. The time
+ * spent on each leg (on the controller's clock, so virtual time against a simulated plant) is kept and logged.
+ *
+ * Waypoints can be given as an array or read from a file (or stdin), one "<x> <y>" line per waypoint, '#' for comments.
+ * A file is streamed: as the leg to each waypoint starts, whatever has arrived by then is read, without waiting, to
+ * see whether there is one after it. If there isn't, that leg is the last for now: the robot stops at its waypoint
+ * and only then waits for more. So the robot never drives while waiting on a pipe, and a pipe feeding waypoints in
+ * keeps it moving as long as it stays one ahead. The stream is read through its descriptor, not stdio.
+ */
+
+#ifndef _MISSION_H_INCLUDED
+#define _MISSION_H_INCLUDED
+
+#include <stdio.h>
+#include <vector>
+
+#define MISSION_BLEND_RADIUS        15.0					// cm, default distance from a waypoint to hand over to the next
+#define MISSION_BLEND_RADIUS_ENV    "OROBOTO_BLEND_RADIUS"	// overrides MISSION_BLEND_RADIUS if set
+#define MISSION_LINE_BYTES          128						// longest waypoint line
+
+#include "controller.h"
+
+class Logger;
+
+struct MissionLeg
+{
+	Waypoint			waypoint;
+	int					result;			// as Controller::transit(), 0 if the waypoint was reached
+	unsigned long long	transitNs;		// time spent on this leg
+};
+
+/**
+ * Waypoints arriving on a stream, read a line at a time (see Mission::readWaypoint())
+ */
+struct MissionStream
+{
+	int					fd;
+	char				buffer[MISSION_LINE_BYTES];
+	unsigned int		used;			// bytes in the buffer
+	bool				bEnd;			// nothing more will arrive
+};
+
+class Mission
+{
+	private:
+		Controller *			_controller;
+		Logger *				_logger;
+
+		double					_fBlendRadius;
+
+		std::vector<MissionLeg>	_legs;
+		unsigned long long		_transitNs;
+
+		void				begin();
+		void				leg(const Waypoint &waypoint, const Waypoint *next);
+		int					end();
+
+		static int			readWaypoint(MissionStream *stream, Waypoint *waypoint, bool bWait);
+		static int			parseWaypoint(const char *line, Waypoint *waypoint);
+
+	public:
+		Mission(Controller *controller);
+		~Mission();
+
+		int					setBlendRadius(double fBlendRadius);
+		double				getBlendRadius() const		{ return _fBlendRadius; }
+
+		int					run(const Waypoint *waypoints, unsigned int nWaypoints);
+		int					run(FILE *fp);
+		int					run(const char *filename);
+
+		unsigned int		getLegCount() const						{ return _legs.size(); }
+		const MissionLeg &	getLeg(unsigned int i) const			{ return _legs[i]; }
+		unsigned long long	getTransitNs() const					{ return _transitNs; }
+};
+
+#endif // _MISSION_H_INCLUDED